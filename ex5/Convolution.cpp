@@ -0,0 +1,877 @@
+/**
+ * @file Convolution.cpp
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief The convolution engines implementation.
+ */
+
+#include <algorithm>
+#include <vector>
+#include "Convolution.h"
+#include "SimdKernels.h"
+#include "ThreadPool.h"
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * The scratch memory of separableConvolution, kept per thread between the calls.
+ */
+static thread_local std::vector<float> gScratch;
+
+/**
+ * The scratch memory of sobelGradients, the ring of _paddedRows and the gradient rows, kept per
+ * thread between the calls.
+ */
+static thread_local std::vector<float> gGradientRing;
+static thread_local std::vector<float> gGradientRows;
+
+/**
+ * The ring of _paddedRows of fixedPointConvolution, kept per thread between the calls.
+ */
+static thread_local std::vector<uint8_t> gFixedPointRing;
+
+/**
+ * The window of a tile of convolve on the tile layout and its passes, kept per thread between
+ * the calls.
+ */
+static thread_local std::vector<float> gTileWindow;
+
+bool isExactInput(Span<const float> values, float maxAbs)
+{
+    return isIntegral(values.data(), maxAbs, values.size());
+}
+
+bool isExactRows(const Matrix& image, int firstRow, int endRow, float maxAbs)
+{
+    firstRow = std::max(0, firstRow);
+    endRow = std::min(image.getRows(), endRow);
+    if(endRow <= firstRow)
+    {
+        return true;
+    }
+    return isExactInput(image.getData().subspan((long) firstRow * image.getCols(),
+                                                (long) (endRow - firstRow) * image.getCols()),
+                        maxAbs);
+}
+
+/**
+ * result[c] = sum of weights[j] * src[c + j], the horizontal pass of a padded row. the first
+ * weight sets the result, the next ones that are 0 are skipped.
+ */
+static void _horizontalPass(const float* src, const float* weights, int numWeights,
+                            float* result, long size)
+{
+    multiplyScalar(src, weights[0], result, size);
+    for(int j = 1; j < numWeights; ++j)
+    {
+        if(weights[j] != 0)
+        {
+            multiplyAdd(src + j, weights[j], result, size);
+        }
+    }
+}
+
+/**
+ * The two passes of separableConvolution, the rows of the result are multiplied by scale and
+ * rounded if isRounded, and multiplied by scale if it is not 1 otherwise.
+ */
+static void _separablePasses(Span<float> result, const Matrix& image, const float* colWeights,
+                             int numColWeights, const float* rowWeights, int numRowWeights,
+                             float scale, bool isRounded, int firstRow, int numRows)
+{
+    int rows = image.getRows();
+    int cols = image.getCols();
+    if(numRows <= 0 || cols == 0)
+    {
+        return;
+    }
+    int colHalo = numColWeights / 2;
+    int rowHalo = numRowWeights / 2;
+
+    //the zero padded input row, a zero row for the rows outside the image and a ring of the
+    //horizontal passes of the numColWeights rows the vertical pass reads.
+    long paddedCols = cols + 2L * rowHalo;
+    long scratchSize = paddedCols + (numColWeights + 1L) * cols;
+    if((long) gScratch.size() < scratchSize)
+    {
+        gScratch.resize(scratchSize);
+    }
+    float* padded = gScratch.data();
+    float* zeroRow = padded + paddedCols;
+    float* ring = zeroRow + cols;
+    std::fill(padded, padded + rowHalo, 0.f);
+    std::fill(padded + rowHalo + cols, padded + paddedCols, 0.f);
+    std::fill(zeroRow, zeroRow + cols, 0.f);
+
+
+    int nextPassRow = std::max(0, firstRow - colHalo);
+    for(int row = firstRow; row < firstRow + numRows; ++row)
+    {
+        for(; nextPassRow <= std::min(row + colHalo, rows - 1); ++nextPassRow)
+        {
+            std::copy(image.rowPtr(nextPassRow), image.rowPtr(nextPassRow) + cols,
+                      padded + rowHalo);
+            _horizontalPass(padded, rowWeights, numRowWeights,
+                            ring + (long) (nextPassRow % numColWeights) * cols, cols);
+        }
+
+        //the vertical pass, the first weight sets the row like in the horizontal one.
+        float* resultRow = result.data() + (long) (row - firstRow) * cols;
+        for(int i = 0; i < numColWeights; ++i)
+        {
+            int passRow = row - colHalo + i;
+            const float* passData = (passRow < 0 || passRow >= rows) ?
+                                    zeroRow : ring + (long) (passRow % numColWeights) * cols;
+            if(i == 0)
+            {
+                multiplyScalar(passData, colWeights[i], resultRow, cols);
+            }
+            else if(colWeights[i] != 0)
+            {
+                multiplyAdd(passData, colWeights[i], resultRow, cols);
+            }
+        }
+        if(isRounded)
+        {
+            multiplyRound(resultRow, scale, resultRow, cols);
+        }
+        else if(scale != 1)
+        {
+            multiplyScalar(resultRow, scale, resultRow, cols);
+        }
+    }
+}
+
+void separableConvolution(Span<float> result, const Matrix& image, const float* colWeights,
+                          int numColWeights, const float* rowWeights, int numRowWeights,
+                          float scale, int firstRow, int numRows)
+{
+    _separablePasses(result, image, colWeights, numColWeights, rowWeights, numRowWeights, scale,
+                     true, firstRow, numRows);
+}
+
+/**
+ * calls rowFunction(row, top, mid, bottom) for the rows [firstRow, firstRow + numRows) of image
+ * in order, with the row and the rows around it zero padded: the pointers are to their column 0,
+ * and their columns -1 and cols are 0, like the rows outside the image. every image row is copied
+ * once to a ring of three padded rows in ring, that grows to fit them and is kept.
+ */
+template <typename T, typename RowFunction>
+static void _paddedRows(const BasicMatrix<T>& image, int firstRow, int numRows,
+                        std::vector<T>& ring, RowFunction rowFunction)
+{
+    int rows = image.getRows();
+    int cols = image.getCols();
+    if(numRows <= 0 || cols == 0)
+    {
+        return;
+    }
+
+    //the three ring rows and a zero row.
+    long paddedCols = cols + 2L;
+    if((long) ring.size() < 4 * paddedCols)
+    {
+        ring.resize(4 * paddedCols);
+    }
+    T* ringRows = ring.data();
+    T* zeroRow = ringRows + 3 * paddedCols;
+    std::fill(zeroRow, zeroRow + paddedCols, T(0));
+    for(int i = 0; i < 3; ++i)
+    {
+        ringRows[i * paddedCols] = T(0);
+        ringRows[i * paddedCols + cols + 1] = T(0);
+    }
+    auto paddedRow = [=](int row) -> const T*
+    {
+        return (row < 0 || row >= rows) ? zeroRow + 1 : ringRows + (row % 3) * paddedCols + 1;
+    };
+
+    int nextCopyRow = std::max(0, firstRow - 1);
+    for(int row = firstRow; row < firstRow + numRows; ++row)
+    {
+        for(; nextCopyRow <= std::min(row + 1, rows - 1); ++nextCopyRow)
+        {
+            std::copy(image.rowPtr(nextCopyRow), image.rowPtr(nextCopyRow) + cols,
+                      ringRows + (nextCopyRow % 3) * paddedCols + 1);
+        }
+        rowFunction(row, paddedRow(row - 1), paddedRow(row), paddedRow(row + 1));
+    }
+}
+
+void sobelGradients(const Matrix& image, int firstRow, int numRows,
+                    const std::function<void(int row, float* gradX, float* gradY)>& rowGradients)
+{
+    int cols = image.getCols();
+    if((long) gGradientRows.size() < 2L * cols)
+    {
+        gGradientRows.resize(2L * cols);
+    }
+    float* gradX = gGradientRows.data();
+    float* gradY = gradX + cols;
+    _paddedRows(image, firstRow, numRows, gGradientRing,
+                [&rowGradients, gradX, gradY, cols](int row, const float* top, const float* mid,
+                                                    const float* bottom)
+                {
+                    sobelRow(top, mid, bottom, gradX, gradY, cols);
+                    rowGradients(row, gradX, gradY);
+                });
+}
+
+void fixedPointConvolution(Span<uint8_t> result, const BasicMatrix<uint8_t>& image,
+                           FixedPointFilter filter, int firstRow, int numRows)
+{
+    int cols = image.getCols();
+    _paddedRows(image, firstRow, numRows, gFixedPointRing,
+                [result, filter, firstRow, cols](int row, const uint8_t* top, const uint8_t* mid,
+                                                 const uint8_t* bottom)
+                {
+                    uint8_t* resultRow = result.data() + (long) (row - firstRow) * cols;
+                    if(filter == FIXED_POINT_BLUR)
+                    {
+                        blurRow(top, mid, bottom, resultRow, cols);
+                    }
+                    else
+                    {
+                        sobelRow(top, mid, bottom, resultRow, cols);
+                    }
+                });
+}
+
+// ------------------------------ generic engine ------------------------------
+
+/**
+ * The costs of the cost model, in nanoseconds on an avx512 machine: a product added by
+ * multiplyAdd, a butterfly of a tile that fits in the l2 cache and of a bigger one, and a
+ * coordinate of a tile copied and multiplied. the separable passes also copy and scale every
+ * coordinate, SEPARABLE_EXTRA_TAPS products more.
+ */
+static const double TAP_COST = 0.07;
+static const double SEPARABLE_EXTRA_TAPS = 2;
+static const double BUTTERFLY_COST = 1.7;
+static const double UNCACHED_BUTTERFLY_COST = 3.2;
+static const double FFT_POINT_COST = 1.5;
+
+/**
+ * The biggest fft tile size that fits in the l2 cache.
+ */
+static const int CACHED_FFT_SIZE = 256;
+
+/**
+ * The smallest fft tile size the cost model tries.
+ */
+static const int MIN_FFT_SIZE = 16;
+
+/**
+ * @struct FftPlan
+ * @brief The bit reversal permutation and the twiddles of a radix 2 fft of a given size.
+ */
+struct FftPlan
+{
+    int size;
+    std::vector<int> reversed;
+
+    /**
+     * cos and -sin of 2 pi k / size for k < size / 2, the twiddles of the forward transform.
+     */
+    std::vector<double> twiddleReal;
+    std::vector<double> twiddleImag;
+};
+
+/**
+ * @struct FftTile
+ * @brief A size x size tile of complex values, its real and imaginary parts in two row major
+ *        planes, so the butterflies run over contiguous doubles.
+ */
+struct FftTile
+{
+    std::vector<double> real;
+    std::vector<double> imag;
+};
+
+/**
+ * @return the plan of the fft of the given power of two size.
+ */
+static FftPlan _createFftPlan(int size)
+{
+    FftPlan plan;
+    plan.size = size;
+    plan.reversed.resize(size);
+    int bits = 0;
+    while((1 << bits) < size)
+    {
+        ++bits;
+    }
+    for(int i = 0; i < size; ++i)
+    {
+        int reversed = 0;
+        for(int bit = 0; bit < bits; ++bit)
+        {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        plan.reversed[i] = reversed;
+    }
+    plan.twiddleReal.resize(size / 2);
+    plan.twiddleImag.resize(size / 2);
+    for(int k = 0; k < size / 2; ++k)
+    {
+        double angle = 2 * M_PI * k / size;
+        plan.twiddleReal[k] = std::cos(angle);
+        plan.twiddleImag[k] = -std::sin(angle);
+    }
+    return plan;
+}
+
+/**
+ * The in place fft of every column of a plane pair, not normalized: the rows are permuted, then
+ * every butterfly combines two whole rows. the inverse one uses the conjugate twiddles.
+ */
+static void _fftColumns(const FftPlan& plan, double* real, double* imag, bool isInverse)
+{
+    long size = plan.size;
+    for(long row = 0; row < size; ++row)
+    {
+        long reversed = plan.reversed[row];
+        if(row < reversed)
+        {
+            std::swap_ranges(real + row * size, real + (row + 1) * size, real + reversed * size);
+            std::swap_ranges(imag + row * size, imag + (row + 1) * size, imag + reversed * size);
+        }
+    }
+    double sign = isInverse ? -1 : 1;
+    for(long length = 2; length <= size; length *= 2)
+    {
+        long half = length / 2;
+        long step = size / length;
+        for(long start = 0; start < size; start += length)
+        {
+            for(long k = 0; k < half; ++k)
+            {
+                long lhsRow = (start + k) * size;
+                long rhsRow = (start + k + half) * size;
+                butterflies(real + lhsRow, imag + lhsRow, real + rhsRow, imag + rhsRow,
+                            plan.twiddleReal[k * step], sign * plan.twiddleImag[k * step], size);
+            }
+        }
+    }
+}
+
+/**
+ * The in place transpose of a size x size plane, a block at a time.
+ */
+static void _transpose(double* plane, long size)
+{
+    const long BLOCK = 16;
+    for(long blockRow = 0; blockRow < size; blockRow += BLOCK)
+    {
+        for(long blockCol = blockRow; blockCol < size; blockCol += BLOCK)
+        {
+            for(long row = blockRow; row < std::min(blockRow + BLOCK, size); ++row)
+            {
+                long firstCol = blockCol == blockRow ? row + 1 : blockCol;
+                for(long col = firstCol; col < std::min(blockCol + BLOCK, size); ++col)
+                {
+                    std::swap(plane[row * size + col], plane[col * size + row]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * The in place 2D fft of a tile, not normalized: the fft of the columns, a transpose and the fft
+ * of the columns again. the result is transposed, so the forward and the inverse transforms
+ * together give back the original layout, and a product of two transforms is the same in any
+ * layout.
+ */
+static void _fft2D(const FftPlan& plan, FftTile& tile, bool isInverse)
+{
+    _fftColumns(plan, tile.real.data(), tile.imag.data(), isInverse);
+    _transpose(tile.real.data(), plan.size);
+    _transpose(tile.imag.data(), plan.size);
+    _fftColumns(plan, tile.real.data(), tile.imag.data(), isInverse);
+}
+
+/**
+ * @return the cost model time of the fft tiles of the given size, 0 if the kernel does not fit.
+ */
+static double _fftCost(int rows, int cols, int kernelRows, int kernelCols, int size)
+{
+    long blockRows = size - kernelRows + 1;
+    long blockCols = size - kernelCols + 1;
+    if(blockRows <= 0 || blockCols <= 0)
+    {
+        return 0;
+    }
+    long numBlocks = ((rows + blockRows - 1) / blockRows) * ((cols + blockCols - 1) / blockCols);
+    int log2Size = 0;
+    while((1 << log2Size) < size)
+    {
+        ++log2Size;
+    }
+    //the tiles run in pairs, a forward and an inverse 2D fft per pair.
+    double butterflyCost = size <= CACHED_FFT_SIZE ? BUTTERFLY_COST : UNCACHED_BUTTERFLY_COST;
+    double pairCost = 2.0 * size * size * log2Size * butterflyCost +
+                      (double) size * size * FFT_POINT_COST;
+    return (numBlocks + 1) / 2 * pairCost;
+}
+
+/**
+ * @return the fft tile size of the lowest cost model time (its cost in bestCost), 0 if there
+ *         is none.
+ */
+static int _bestFftSize(int rows, int cols, int kernelRows, int kernelCols, double& bestCost)
+{
+    int bestSize = 0;
+    int maxSize = std::max(rows + kernelRows - 1, cols + kernelCols - 1);
+    for(int size = MIN_FFT_SIZE; size <= MAX_FFT_SIZE; size *= 2)
+    {
+        double cost = _fftCost(rows, cols, kernelRows, kernelCols, size);
+        if(cost > 0 && (bestSize == 0 || cost < bestCost))
+        {
+            bestSize = size;
+            bestCost = cost;
+        }
+        if(size >= maxSize)
+        {
+            break; //a single tile covers the image.
+        }
+    }
+    return bestSize;
+}
+
+bool findSeparable(const Matrix& kernel, std::vector<float>& colWeights,
+                   std::vector<float>& rowWeights)
+{
+    int kernelRows = kernel.getRows();
+    int kernelCols = kernel.getCols();
+    //the biggest coordinate is the pivot, the column through it and its row over it.
+    long pivot = 0;
+    Span<const float> weights = kernel.getData();
+    for(long i = 1; i < weights.size(); ++i)
+    {
+        if(std::fabs(weights[i]) > std::fabs(weights[pivot]))
+        {
+            pivot = i;
+        }
+    }
+    float maxAbs = weights.size() == 0 ? 0 : std::fabs(weights[pivot]);
+    if(!(maxAbs > 0) || std::isinf(maxAbs))
+    {
+        return false;
+    }
+    int pivotRow = (int) (pivot / kernelCols);
+    int pivotCol = (int) (pivot % kernelCols);
+    colWeights.resize(kernelRows);
+    rowWeights.resize(kernelCols);
+    for(int i = 0; i < kernelRows; ++i)
+    {
+        colWeights[i] = kernel.rowPtr(i)[pivotCol];
+    }
+    for(int j = 0; j < kernelCols; ++j)
+    {
+        rowWeights[j] = kernel.rowPtr(pivotRow)[j] / weights[pivot];
+    }
+    for(int i = 0; i < kernelRows; ++i)
+    {
+        for(int j = 0; j < kernelCols; ++j)
+        {
+            if(!(std::fabs(kernel.rowPtr(i)[j] - colWeights[i] * rowWeights[j]) <=
+                 SEPARABLE_TOLERANCE * maxAbs))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+ConvolutionMethod chooseConvolutionMethod(int rows, int cols, const Matrix& kernel)
+{
+    double numCoordinates = (double) rows * cols;
+    std::vector<float> colWeights;
+    std::vector<float> rowWeights;
+    ConvolutionMethod bestMethod = CONVOLUTION_DIRECT;
+    double bestCost = numCoordinates * kernel.getRows() * kernel.getCols() * TAP_COST;
+    if(findSeparable(kernel, colWeights, rowWeights))
+    {
+        double separableCost = numCoordinates * TAP_COST *
+                               (kernel.getRows() + kernel.getCols() + SEPARABLE_EXTRA_TAPS);
+        if(separableCost < bestCost)
+        {
+            bestMethod = CONVOLUTION_SEPARABLE;
+            bestCost = separableCost;
+        }
+    }
+    double fftCost = 0;
+    if(_bestFftSize(rows, cols, kernel.getRows(), kernel.getCols(), fftCost) != 0 &&
+       fftCost < bestCost)
+    {
+        bestMethod = CONVOLUTION_FFT;
+    }
+    return bestMethod;
+}
+
+/**
+ * The direct method, a multiplyAdd of a shifted image row per coordinate of the kernel, limited
+ * to the columns it reads inside the image. the coordinates that are 0 are skipped.
+ */
+static void _directConvolve(Matrix& result, const Matrix& image, const Matrix& kernel)
+{
+    int rows = image.getRows();
+    int cols = image.getCols();
+    int rowHalo = kernel.getRows() / 2;
+    int colHalo = kernel.getCols() / 2;
+    for(int row = 0; row < rows; ++row)
+    {
+        float* resultRow = result.rowPtr(row);
+        for(int i = 0; i < kernel.getRows(); ++i)
+        {
+            int imageRow = row + i - rowHalo;
+            if(imageRow < 0 || imageRow >= rows)
+            {
+                continue;
+            }
+            const float* imageData = image.rowPtr(imageRow);
+            for(int j = 0; j < kernel.getCols(); ++j)
+            {
+                float weight = kernel.rowPtr(i)[j];
+                int shift = j - colHalo;
+                int begin = std::max(0, -shift);
+                int end = std::min(cols, cols - shift);
+                if(weight != 0 && begin < end)
+                {
+                    multiplyAdd(imageData + begin + shift, weight, resultRow + begin, end - begin);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * The fft method by overlap save: every size x size tile of the image gives the (size - R + 1) x
+ * (size - C + 1) coordinates its circular correlation with the kernel has without wrapping. the
+ * image is real, so two tiles run as the real and the imaginary part of one transform.
+ */
+static void _fftConvolve(Matrix& result, const Matrix& image, const Matrix& kernel, int size)
+{
+    int rows = image.getRows();
+    int cols = image.getCols();
+    int rowHalo = kernel.getRows() / 2;
+    int colHalo = kernel.getCols() / 2;
+    int blockRows = size - kernel.getRows() + 1;
+    int blockCols = size - kernel.getCols() + 1;
+    long tileSize = (long) size * size;
+    FftPlan plan = _createFftPlan(size);
+
+    //the correlation with the kernel is the product with the conjugate of its transform, the
+    //normalization of the inverse transform is folded in.
+    FftTile kernelTransform = {std::vector<double>(tileSize), std::vector<double>(tileSize)};
+    for(int i = 0; i < kernel.getRows(); ++i)
+    {
+        std::copy(kernel.rowPtr(i), kernel.rowPtr(i) + kernel.getCols(),
+                  kernelTransform.real.begin() + (long) i * size);
+    }
+    _fft2D(plan, kernelTransform, false);
+    for(long i = 0; i < tileSize; ++i)
+    {
+        kernelTransform.real[i] /= (double) tileSize;
+        kernelTransform.imag[i] /= -(double) tileSize;
+    }
+
+    std::vector<std::pair<int, int>> blocks;
+    for(int firstRow = 0; firstRow < rows; firstRow += blockRows)
+    {
+        for(int firstCol = 0; firstCol < cols; firstCol += blockCols)
+        {
+            blocks.emplace_back(firstRow, firstCol);
+        }
+    }
+    FftTile tile = {std::vector<double>(tileSize), std::vector<double>(tileSize)};
+    for(size_t block = 0; block < blocks.size(); block += 2)
+    {
+        int numTiles = std::min<size_t>(2, blocks.size() - block);
+        for(int part = 0; part < 2; ++part)
+        {
+            double* plane = part == 0 ? tile.real.data() : tile.imag.data();
+            std::fill(plane, plane + tileSize, 0.);
+            if(part == numTiles)
+            {
+                continue;
+            }
+            int firstRow = blocks[block + part].first - rowHalo;
+            int firstCol = blocks[block + part].second - colHalo;
+            int beginCol = std::max(0, -firstCol);
+            int endCol = std::min(size, cols - firstCol);
+            for(int row = std::max(0, -firstRow); row < size && firstRow + row < rows; ++row)
+            {
+                std::copy(image.rowPtr(firstRow + row) + firstCol + beginCol,
+                          image.rowPtr(firstRow + row) + firstCol + endCol,
+                          plane + (long) row * size + beginCol);
+            }
+        }
+        _fft2D(plan, tile, false);
+        for(long i = 0; i < tileSize; ++i)
+        {
+            double lhsReal = tile.real[i];
+            double lhsImag = tile.imag[i];
+            tile.real[i] = lhsReal * kernelTransform.real[i] - lhsImag * kernelTransform.imag[i];
+            tile.imag[i] = lhsReal * kernelTransform.imag[i] + lhsImag * kernelTransform.real[i];
+        }
+        _fft2D(plan, tile, true);
+        for(int part = 0; part < numTiles; ++part)
+        {
+            const double* plane = part == 0 ? tile.real.data() : tile.imag.data();
+            int firstRow = blocks[block + part].first;
+            int firstCol = blocks[block + part].second;
+            int numRows = std::min(blockRows, rows - firstRow);
+            int numCols = std::min(blockCols, cols - firstCol);
+            for(int row = 0; row < numRows; ++row)
+            {
+                std::copy(plane + (long) row * size, plane + (long) row * size + numCols,
+                          result.rowPtr(firstRow + row) + firstCol);
+            }
+        }
+    }
+}
+
+Matrix convolve(const Matrix& image, const Matrix& kernel, ConvolutionMethod method)
+{
+    if(kernel.getRows() % 2 == 0 || kernel.getCols() % 2 == 0)
+    {
+        exitWithError(INVALID_DIMENSIONS_ERROR);
+    }
+    Matrix result(image.getRows(), image.getCols());
+    if(image.getRows() == 0 || image.getCols() == 0)
+    {
+        return result;
+    }
+    if(method == CONVOLUTION_AUTO)
+    {
+        method = chooseConvolutionMethod(image.getRows(), image.getCols(), kernel);
+    }
+    std::vector<float> colWeights;
+    std::vector<float> rowWeights;
+    double fftCost = 0;
+    switch(method)
+    {
+        case CONVOLUTION_SEPARABLE:
+            if(!findSeparable(kernel, colWeights, rowWeights))
+            {
+                exitWithError(NOT_SEPARABLE_ERROR);
+            }
+            _separablePasses(result.getData(), image, colWeights.data(), kernel.getRows(),
+                             rowWeights.data(), kernel.getCols(), 1, false, 0, image.getRows());
+            break;
+        case CONVOLUTION_FFT:
+        {
+            int size = _bestFftSize(image.getRows(), image.getCols(), kernel.getRows(),
+                                    kernel.getCols(), fftCost);
+            if(size != 0)
+            {
+                _fftConvolve(result, image, kernel, size);
+                break;
+            }
+            //a kernel bigger than MAX_FFT_SIZE runs directly.
+            _directConvolve(result, image, kernel);
+            break;
+        }
+        default:
+            _directConvolve(result, image, kernel);
+            break;
+    }
+    return result;
+}
+
+/**
+ * copies the coordinates [firstRow, firstRow + numRows) x [firstCol, firstCol + numCols) of the
+ * image to window, row after row, with the coordinates outside the image as 0.
+ */
+static void _copyWindow(const TiledMatrix& image, int firstRow, int firstCol, int numRows,
+                        int numCols, float* window)
+{
+    int beginCol = std::max(0, firstCol);
+    int endCol = std::max(beginCol, std::min(image.getCols(), firstCol + numCols));
+    for(int i = 0; i < numRows; ++i)
+    {
+        float* dst = window + (long) i * numCols;
+        int row = firstRow + i;
+        if(row < 0 || row >= image.getRows())
+        {
+            std::fill(dst, dst + numCols, 0.f);
+            continue;
+        }
+        std::fill(dst, dst + (beginCol - firstCol), 0.f);
+        for(int col = beginCol; col < endCol;)
+        {
+            int tileEnd = std::min(endCol, (col / TILE_SIZE + 1) * TILE_SIZE);
+            const float* src = image.tilePtr(row / TILE_SIZE, col / TILE_SIZE) +
+                               (row % TILE_SIZE) * TILE_SIZE + col % TILE_SIZE;
+            std::copy(src, src + (tileEnd - col), dst + (col - firstCol));
+            col = tileEnd;
+        }
+        std::fill(dst + (endCol - firstCol), dst + numCols, 0.f);
+    }
+}
+
+/**
+ * The tile of convolve on the tile layout: the direct method like _directConvolve, or the
+ * separable one like _separablePasses if colWeights is not nullptr. the rows of the window, of
+ * its passes and of the result are windowCols apart, so a coordinate of the kernel is a single
+ * multiplyAdd over all the rows, the columns past numCols of the rows are not used. every
+ * coordinate sums the same products in the same order as on the row major layout, the direct
+ * method adds the products of the coordinates outside the image that it skips, they are 0.
+ */
+static void _convolveTile(TiledMatrix& result, const TiledMatrix& image, const Matrix& kernel,
+                          const float* colWeights, const float* rowWeights, int tileRow,
+                          int tileCol)
+{
+    int rows = image.getRows();
+    int rowHalo = kernel.getRows() / 2;
+    int colHalo = kernel.getCols() / 2;
+    int firstRow = tileRow * TILE_SIZE;
+    int numRows = std::min(TILE_SIZE, rows - firstRow);
+    int numCols = std::min(TILE_SIZE, image.getCols() - tileCol * TILE_SIZE);
+    int windowRows = numRows + 2 * rowHalo;
+    long windowCols = numCols + 2L * colHalo;
+
+    //the window and the columns its last row reads past it, the passes and the result.
+    long windowSize = windowRows * windowCols + 2 * colHalo;
+    long scratchSize = windowSize + windowRows * windowCols + numRows * windowCols;
+    if((long) gTileWindow.size() < scratchSize)
+    {
+        gTileWindow.resize(scratchSize);
+    }
+    float* window = gTileWindow.data();
+    float* passes = window + windowSize;
+    float* resultRows = passes + windowRows * windowCols;
+    _copyWindow(image, firstRow - rowHalo, tileCol * TILE_SIZE - colHalo, windowRows,
+                (int) windowCols, window);
+    std::fill(window + windowRows * windowCols, window + windowSize, 0.f);
+    std::fill(resultRows, resultRows + numRows * windowCols, 0.f);
+
+    //the rows the window has inside the image.
+    int beginRow = std::max(0, rowHalo - firstRow);
+    int endRow = std::min(windowRows, rows - firstRow + rowHalo);
+    if(colWeights != nullptr)
+    {
+        //the passes of the rows outside the image are 0 like the zero row of _separablePasses.
+        std::fill(passes, passes + windowRows * windowCols, 0.f);
+        _horizontalPass(window + beginRow * windowCols, rowWeights, kernel.getCols(),
+                        passes + beginRow * windowCols, (endRow - beginRow) * windowCols);
+        for(int i = 0; i < kernel.getRows(); ++i)
+        {
+            const float* passData = passes + i * windowCols;
+            if(i == 0)
+            {
+                multiplyScalar(passData, colWeights[i], resultRows, numRows * windowCols);
+            }
+            else if(colWeights[i] != 0)
+            {
+                multiplyAdd(passData, colWeights[i], resultRows, numRows * windowCols);
+            }
+        }
+    }
+    else
+    {
+        for(int i = 0; i < kernel.getRows(); ++i)
+        {
+            //the result rows whose row i of the kernel is inside the image.
+            int firstResultRow = std::max(0, beginRow - i);
+            int endResultRow = std::min(numRows, endRow - i);
+            if(firstResultRow >= endResultRow)
+            {
+                continue;
+            }
+            for(int j = 0; j < kernel.getCols(); ++j)
+            {
+                float weight = kernel.rowPtr(i)[j];
+                if(weight != 0)
+                {
+                    multiplyAdd(window + (firstResultRow + i) * windowCols + j, weight,
+                                resultRows + firstResultRow * windowCols,
+                                (endResultRow - firstResultRow) * windowCols);
+                }
+            }
+        }
+    }
+
+    float* tile = result.tilePtr(tileRow, tileCol);
+    for(int row = 0; row < numRows; ++row)
+    {
+        std::copy(resultRows + row * windowCols, resultRows + row * windowCols + numCols,
+                  tile + row * TILE_SIZE);
+    }
+}
+
+TiledMatrix convolve(const TiledMatrix& image, const Matrix& kernel, ConvolutionMethod method)
+{
+    if(kernel.getRows() % 2 == 0 || kernel.getCols() % 2 == 0)
+    {
+        exitWithError(INVALID_DIMENSIONS_ERROR);
+    }
+    TiledMatrix result(image.getRows(), image.getCols());
+    if(image.getRows() == 0 || image.getCols() == 0)
+    {
+        return result;
+    }
+    if(method == CONVOLUTION_AUTO)
+    {
+        method = chooseConvolutionMethod(image.getRows(), image.getCols(), kernel);
+    }
+    if(method == CONVOLUTION_FFT)
+    {
+        return TiledMatrix(convolve(image.toMatrix(), kernel, method));
+    }
+    std::vector<float> colWeights;
+    std::vector<float> rowWeights;
+    bool isSeparable = method == CONVOLUTION_SEPARABLE;
+    if(isSeparable && !findSeparable(kernel, colWeights, rowWeights))
+    {
+        exitWithError(NOT_SEPARABLE_ERROR);
+    }
+    int tileCols = image.getTileCols();
+    ThreadPool::getInstance().parallelFor(image.getTileRows() * tileCols, [&](int tile)
+    {
+        _convolveTile(result, image, kernel, isSeparable ? colWeights.data() : nullptr,
+                      rowWeights.data(), tile / tileCols, tile % tileCols);
+    });
+    return result;
+}
+
+Matrix gaussianKernel(int radius, float sigma)
+{
+    if(radius < 0 || !(sigma > 0))
+    {
+        exitWithError(INVALID_DIMENSIONS_ERROR);
+    }
+    std::vector<double> weights(2 * radius + 1);
+    double sum = 0;
+    for(int i = -radius; i <= radius; ++i)
+    {
+        weights[i + radius] = std::exp(-(double) i * i / (2.0 * sigma * sigma));
+        sum += weights[i + radius];
+    }
+    Matrix result(2 * radius + 1, 2 * radius + 1);
+    for(int i = 0; i <= 2 * radius; ++i)
+    {
+        for(int j = 0; j <= 2 * radius; ++j)
+        {
+            result(i, j) = (float) (weights[i] * weights[j] / (sum * sum));
+        }
+    }
+    return result;
+}
+
+Matrix boxKernel(int radius)
+{
+    if(radius < 0)
+    {
+        exitWithError(INVALID_DIMENSIONS_ERROR);
+    }
+    int size = 2 * radius + 1;
+    Matrix result(size, size);
+    result += 1.f / ((float) size * size);
+    return result;
+}
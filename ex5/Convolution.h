@@ -0,0 +1,380 @@
+#ifndef SUMMER_EX4_CONVOLUTION_H
+#define SUMMER_EX4_CONVOLUTION_H
+
+/**
+ * @file Convolution.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief header file of Convolution.cpp, the convolution engines of the filters.
+ *        the exact engine: a kernel that is a power of two times the product of an integer column
+ *        and an integer row (like the blur and the sobel kernels) runs on an image of small
+ *        integers as two 1D passes over zero padded rows. every sum of such values is exact in
+ *        float, so the result is bit identical to the one of the direct 2D loop in any order.
+ *        the gradient engine: both sobel gradients of a row from a single read of its neighborhood.
+ *        the fixed point engine: the blur and the sobel of an 8 bit image in 16 bit integers,
+ *        twice the pixels per register of the float path and bit identical to it.
+ *        the generic engine: convolve takes a kernel of any odd dimensions and runs it directly,
+ *        as two 1D passes if it is separable, or as products of 2D fft tiles, whichever a cost
+ *        model expects to be the fastest, so a big kernel costs O(log) per coordinate. it runs on
+ *        the tile layout of TiledMatrix too, a tile per task.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "Matrix.h"
+#include "FixedMatrix.h"
+#include "TiledMatrix.h"
+
+// -------------------------- const definitions -------------------------
+
+#define NOT_SEPARABLE_ERROR "The convolution kernel is not separable."
+
+/**
+ * The bound of the sums of the exact path, every float sum of integers below it is exact. kept
+ * below 2^23 so the rounding of the sse2 kernels needs no special case.
+ */
+constexpr float EXACT_SUM_LIMIT = 4194304.f;
+
+/**
+ * The biggest power of two the weights of a separable kernel are scaled by.
+ */
+const int MAX_KERNEL_SCALE_EXPONENT = 24;
+
+/**
+ * The relative error, of the biggest absolute coordinate, a kernel may differ from the product
+ * of its column and row by and still run as a separable one.
+ */
+const float SEPARABLE_TOLERANCE = 1e-6f;
+
+/**
+ * The biggest size of the square fft tiles.
+ */
+const int MAX_FFT_SIZE = 1024;
+
+/**
+ * @enum ConvolutionMethod
+ * @brief the ways convolve may run a kernel.
+ */
+enum ConvolutionMethod
+{
+    /**
+     * The cheapest of the others by the cost model.
+     */
+    CONVOLUTION_AUTO,
+
+    /**
+     * Every coordinate of the kernel over the image, R * C products per coordinate.
+     */
+    CONVOLUTION_DIRECT,
+
+    /**
+     * A vertical and a horizontal 1D pass, R + C products per coordinate, exit the program if
+     * the kernel is not separable.
+     */
+    CONVOLUTION_SEPARABLE,
+
+    /**
+     * Products of the 2D fft of overlapping image tiles and of the kernel, O(log of the tile
+     * size) per coordinate. a nan or inf spreads over its whole tile.
+     */
+    CONVOLUTION_FFT
+};
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @enum FixedPointFilter
+ * @brief the filters fixedPointConvolution runs.
+ */
+enum FixedPointFilter
+{
+    /**
+     * rint of the convolution with (1, 2, 1) x (1, 2, 1) / 16, see blurRow.
+     */
+    FIXED_POINT_BLUR,
+
+    /**
+     * rint of the convolutions with (1, 2, 1) x (1, 0, -1) / 8 and its transpose added and
+     * saturated to [0, 255], see sobelRow.
+     */
+    FIXED_POINT_SOBEL
+};
+
+/**
+ * @struct SeparableKernel
+ * @brief A R x C kernel written as scale * (colWeights x rowWeights), the weights are integers
+ *        and scale is a power of two, so the products by scale are exact.
+ */
+template <int R, int C>
+struct SeparableKernel
+{
+    /**
+     * True if the kernel is separable that way and its first coordinate is positive. the exact
+     * path needs the positive first coordinate: the direct loop adds its first product first,
+     * so its sum is never -0, and neither is the sum of the two passes.
+     */
+    bool isExact;
+
+    /**
+     * The weights of the vertical pass, colWeights[0] > 0.
+     */
+    float colWeights[R];
+
+    /**
+     * The weights of the horizontal pass, rowWeights[0] > 0.
+     */
+    float rowWeights[C];
+
+    float scale;
+
+    /**
+     * The sum of the absolute values of the coordinates divided by scale, the sums of an image
+     * of values up to maxAbs are up to maxAbs * weightSum.
+     */
+    float weightSum;
+};
+
+/**
+ * @return the greatest common divisor of two non negative integers.
+ */
+constexpr long long _gcd(long long lhs, long long rhs)
+{
+    while(rhs != 0)
+    {
+        long long remainder = lhs % rhs;
+        lhs = rhs;
+        rhs = remainder;
+    }
+    return lhs;
+}
+
+/**
+ * @fn findSeparable(const FixedMatrix<R, C>& kernel);
+ * @return the separable form of the kernel, its isExact is false if it has none. constexpr, so
+ *         the form of a constant kernel is found at compile time.
+ */
+template <int R, int C>
+constexpr SeparableKernel<R, C> findSeparable(const FixedMatrix<R, C>& kernel)
+{
+    SeparableKernel<R, C> result{};
+    if(!(kernel(0, 0) > 0))
+    {
+        return result;
+    }
+
+    //the smallest power of two that makes all the coordinates integers.
+    long long weights[R * C] = {};
+    double scale = 1;
+    int exponent = 0;
+    for(; exponent <= MAX_KERNEL_SCALE_EXPONENT; ++exponent, scale *= 2)
+    {
+        bool isIntegral = true;
+        for(int i = 0; i < R * C && isIntegral; ++i)
+        {
+            double scaled = (double) kernel[i] * scale;
+            isIntegral = -EXACT_SUM_LIMIT < scaled && scaled < EXACT_SUM_LIMIT &&
+                         scaled == (double) (long long) scaled;
+        }
+        if(isIntegral)
+        {
+            break;
+        }
+    }
+    if(exponent > MAX_KERNEL_SCALE_EXPONENT)
+    {
+        return result;
+    }
+    for(int i = 0; i < R * C; ++i)
+    {
+        weights[i] = (long long) ((double) kernel[i] * scale);
+    }
+
+    //the row is the first row over the gcd of its coordinates, the column is what the first
+    //coordinate of every row is of it.
+    long long rowGcd = 0;
+    for(int j = 0; j < C; ++j)
+    {
+        rowGcd = _gcd(rowGcd, weights[j] < 0 ? -weights[j] : weights[j]);
+    }
+    long long row[C] = {};
+    long long col[R] = {};
+    for(int j = 0; j < C; ++j)
+    {
+        row[j] = weights[j] / rowGcd;
+    }
+    long long weightSum = 0;
+    for(int i = 0; i < R; ++i)
+    {
+        if(weights[i * C] % row[0] != 0)
+        {
+            return result;
+        }
+        col[i] = weights[i * C] / row[0];
+        for(int j = 0; j < C; ++j)
+        {
+            if(weights[i * C + j] != col[i] * row[j])
+            {
+                return result;
+            }
+            weightSum += weights[i * C + j] < 0 ? -weights[i * C + j] : weights[i * C + j];
+        }
+    }
+
+    result.isExact = true;
+    for(int i = 0; i < R; ++i)
+    {
+        result.colWeights[i] = (float) col[i];
+    }
+    for(int j = 0; j < C; ++j)
+    {
+        result.rowWeights[j] = (float) row[j];
+    }
+    result.scale = (float) (1 / scale);
+    result.weightSum = (float) weightSum;
+    return result;
+}
+
+/**
+ * @brief checks that the exact path can run on the given values.
+ * @param values the values to check.
+ * @param maxAbs the bound of the absolute values.
+ * @return true if every value is an integer of absolute value at most maxAbs and none is -0.
+ */
+bool isExactInput(Span<const float> values, float maxAbs);
+
+/**
+ * @brief isExactInput of the rows [firstRow, endRow) of image, the rows outside the image are
+ *        skipped.
+ */
+bool isExactRows(const Matrix& image, int firstRow, int endRow, float maxAbs);
+
+/**
+ * @brief the convolution of the rows [firstRow, firstRow + numRows) of image with a separable
+ *        kernel, the rows and columns outside the image count as 0. uses a scratch memory per
+ *        thread that grows to the biggest image width and is kept, so it allocates nothing
+ *        after the first call.
+ * @param result the numRows rows of rint(convolution * scale).
+ * @param image the image, its values must pass isExactInput with EXACT_SUM_LIMIT / weightSum
+ *        around the rows.
+ * @param colWeights the weights of the vertical pass, an odd number of them.
+ * @param numColWeights the number of colWeights.
+ * @param rowWeights the weights of the horizontal pass, an odd number of them.
+ * @param numRowWeights the number of rowWeights.
+ * @param scale the scale of the kernel.
+ * @param firstRow the first image row to calculate.
+ * @param numRows the number of rows to calculate.
+ */
+void separableConvolution(Span<float> result, const Matrix& image, const float* colWeights,
+                          int numColWeights, const float* rowWeights, int numRowWeights,
+                          float scale, int firstRow, int numRows);
+
+/**
+ * @fn exactConvolution(result, image, kernel, firstRow, numRows);
+ * @brief the rows [firstRow, firstRow + numRows) of rint of the convolution of image with the
+ *        kernel centered on every coordinate, with the rows and columns outside the image as 0,
+ *        if the kernel and the image allow the exact path.
+ * @return false, without touching result, if they do not (a kernel that is not isExact, or a
+ *         value that is not a small integer in the rows the result reads).
+ */
+template <int R, int C>
+bool exactConvolution(Span<float> result, const Matrix& image, const SeparableKernel<R, C>& kernel,
+                      int firstRow, int numRows)
+{
+    static_assert(R % 2 == 1 && C % 2 == 1, "the kernel is centered on the coordinate");
+    if(!kernel.isExact)
+    {
+        return false;
+    }
+    if(!isExactRows(image, firstRow - R / 2, firstRow + numRows + R / 2,
+                    std::floor(EXACT_SUM_LIMIT / kernel.weightSum)))
+    {
+        return false;
+    }
+    separableConvolution(result, image, kernel.colWeights, R, kernel.rowWeights, C, kernel.scale,
+                         firstRow, numRows);
+    return true;
+}
+
+/**
+ * @brief the sobel gradients of the rows [firstRow, firstRow + numRows) of image in one pass:
+ *        every image row is copied once to a zero padded ring of three rows, and sobelRow
+ *        computes both gradients of a row from the ring, so no gradient image is kept. the rows
+ *        and columns outside the image count as 0. uses a scratch memory per thread like
+ *        separableConvolution, rowGradients must not call sobelGradients.
+ * @param rowGradients called in the order of the rows with the row and its gradients, 8 times
+ *        the convolutions of the row with the axis X and the axis Y sobel kernels (the integer
+ *        weights of sobelRow), cols values each. it may change them.
+ */
+void sobelGradients(const Matrix& image, int firstRow, int numRows,
+                    const std::function<void(int row, float* gradX, float* gradY)>& rowGradients);
+
+/**
+ * @brief the filter of the rows [firstRow, firstRow + numRows) of an 8 bit image, with the rows
+ *        and columns outside the image as 0, in 16 bit integers: every sum of the filters fits
+ *        in 16 bits and is rounded to nearest even by integer adds and shifts, so the result is
+ *        the one of the exact float path on the same values. every image row is copied once to a
+ *        zero padded ring per thread, like sobelGradients.
+ * @param result the numRows rows of the result.
+ */
+void fixedPointConvolution(Span<uint8_t> result, const BasicMatrix<uint8_t>& image,
+                           FixedPointFilter filter, int firstRow, int numRows);
+
+/**
+ * @brief finds the column and row a kernel is the product of.
+ * @param kernel the kernel.
+ * @param colWeights set to the R weights of the vertical pass.
+ * @param rowWeights set to the C weights of the horizontal pass.
+ * @return true if kernel(i, j) is colWeights[i] * rowWeights[j] up to SEPARABLE_TOLERANCE,
+ *         false (and the weights undefined) if it is not.
+ */
+bool findSeparable(const Matrix& kernel, std::vector<float>& colWeights,
+                   std::vector<float>& rowWeights);
+
+/**
+ * @brief the method CONVOLUTION_AUTO picks for the kernel on a rows x cols image.
+ */
+ConvolutionMethod chooseConvolutionMethod(int rows, int cols, const Matrix& kernel);
+
+/**
+ * @brief the convolution of the image with the kernel centered on every coordinate:
+ *        result(row, col) is the sum of kernel(i, j) * image(row + i - R / 2, col + j - C / 2),
+ *        with the coordinates outside the image as 0. the methods give the same result up to the
+ *        float rounding of their different sum orders. exit the program if the kernel has an
+ *        even number of rows or columns.
+ * @param image the image.
+ * @param kernel the R x C kernel, R and C odd.
+ * @param method the way to run it.
+ * @return the not rounded convolution, of the dimensions of the image.
+ */
+Matrix convolve(const Matrix& image, const Matrix& kernel,
+                ConvolutionMethod method = CONVOLUTION_AUTO);
+
+/**
+ * @brief convolve on the tile layout: every result tile is a task on the threads of the pool
+ *        that copies the window of the image it reads from the tiles around it to a scratch of
+ *        its own, so the vertical neighbors of a coordinate are on the few pages of the window.
+ *        the direct and the separable methods give the result of convolve with the same method
+ *        bit for bit. the fft method, and the auto method when it picks it, run on the row major
+ *        layout. exit the program if the kernel has an even number of rows or columns.
+ */
+TiledMatrix convolve(const TiledMatrix& image, const Matrix& kernel,
+                     ConvolutionMethod method = CONVOLUTION_AUTO);
+
+/**
+ * @return the (2 * radius + 1) x (2 * radius + 1) gaussian kernel of the given standard
+ *         deviation, normalized to sum 1, a product of a column and a row.
+ */
+Matrix gaussianKernel(int radius, float sigma);
+
+/**
+ * @return the (2 * radius + 1) x (2 * radius + 1) kernel of the average of the coordinates.
+ */
+Matrix boxKernel(int radius);
+
+#endif //SUMMER_EX4_CONVOLUTION_H
@@ -0,0 +1,136 @@
+#ifndef SUMMER_EX4_ELEMENTTRAITS_H
+#define SUMMER_EX4_ELEMENTTRAITS_H
+
+/**
+ * @file ElementTraits.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief the element-wise arithmetic of each Matrix element type. float and double use the
+ *        plain operators, the integer types round to nearest even and saturate (the image data
+ *        semantics), Half computes in float.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include "Half.h"
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @struct ElementTraits
+ * @brief The arithmetic of the floating point element types, float and double.
+ *        Scalar is the type of the scalars the matrix is multiplied, divided and added with,
+ *        and the type the elements are read and printed as. Accumulator is the type the
+ *        matrix multiplication sums the products in.
+ */
+template <typename T>
+struct ElementTraits
+{
+    typedef T Scalar;
+    typedef T Accumulator;
+
+    static T add(T lhs, T rhs) { return lhs + rhs; }
+
+    static T addScalar(T val, Scalar scalar) { return val + scalar; }
+
+    static T multiply(T val, Scalar scalar) { return val * scalar; }
+
+    static T divide(T val, Scalar scalar) { return val / scalar; }
+
+    static T fromScalar(Scalar scalar) { return scalar; }
+
+    static Scalar toScalar(T val) { return val; }
+
+    static T fromAccumulator(Accumulator sum) { return sum; }
+};
+
+/**
+ * @struct IntegerElementTraits
+ * @brief The arithmetic of the integer element types, the results are rounded to nearest even
+ *        and saturated to the range of T, nan saturates to the minimum.
+ */
+template <typename T>
+struct IntegerElementTraits
+{
+    typedef float Scalar;
+    typedef long long Accumulator;
+
+    static T add(T lhs, T rhs) { return fromAccumulator((Accumulator) lhs + rhs); }
+
+    static T addScalar(T val, Scalar scalar) { return fromScalar(val + scalar); }
+
+    static T multiply(T val, Scalar scalar) { return fromScalar(val * scalar); }
+
+    static T divide(T val, Scalar scalar) { return fromScalar(val / scalar); }
+
+    static T fromScalar(Scalar scalar)
+    {
+        if(!(scalar >= std::numeric_limits<T>::min()))
+        {
+            return std::numeric_limits<T>::min();
+        }
+        if(scalar > std::numeric_limits<T>::max())
+        {
+            return std::numeric_limits<T>::max();
+        }
+        return (T) std::rint(scalar);
+    }
+
+    static Scalar toScalar(T val) { return val; }
+
+    static T fromAccumulator(Accumulator sum)
+    {
+        if(sum < std::numeric_limits<T>::min())
+        {
+            return std::numeric_limits<T>::min();
+        }
+        if(sum > std::numeric_limits<T>::max())
+        {
+            return std::numeric_limits<T>::max();
+        }
+        return (T) sum;
+    }
+};
+
+template <>
+struct ElementTraits<uint8_t> : IntegerElementTraits<uint8_t>
+{
+};
+
+template <>
+struct ElementTraits<int16_t> : IntegerElementTraits<int16_t>
+{
+};
+
+/**
+ * @struct ElementTraits<Half>
+ * @brief Half is a storage type, every operation computes in float and rounds back once.
+ */
+template <>
+struct ElementTraits<Half>
+{
+    typedef float Scalar;
+    typedef float Accumulator;
+
+    static Half add(Half lhs, Half rhs) { return Half((float) lhs + (float) rhs); }
+
+    static Half addScalar(Half val, Scalar scalar) { return Half((float) val + scalar); }
+
+    static Half multiply(Half val, Scalar scalar) { return Half((float) val * scalar); }
+
+    static Half divide(Half val, Scalar scalar) { return Half((float) val / scalar); }
+
+    static Half fromScalar(Scalar scalar) { return Half(scalar); }
+
+    static Scalar toScalar(Half val) { return val; }
+
+    static Half fromAccumulator(Accumulator sum) { return Half(sum); }
+};
+
+#endif //SUMMER_EX4_ELEMENTTRAITS_H
@@ -14,7 +14,16 @@
 // ------------------------------ includes ------------------------------
 
 #include "Matrix.h"
+#include "FixedMatrix.h"
+#include "Convolution.h"
+#include "SimdKernels.h"
+#include "SummedAreaTable.h"
+#include "ThreadPool.h"
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <mutex>
+#include <vector>
 
 // -------------------------- const definitions -------------------------
 
@@ -33,6 +42,8 @@ const float MIN_COLOR_VAL = 0.f;
  */
 const float MAX_COLOR_VAL = 255.f;
 
+#define INVALID_LEVELS_ERROR "Invalid number of quantization levels."
+
 /**
  * Number of rows in convolution matrix.
  */
@@ -44,29 +55,269 @@ const int CONVOLUTION_MAT_ROWS = 3;
 const int CONVOLUTION_MAT_COLS = 3;
 
 /**
- * The convolution matrix of blur function as float array, will be used to construct the
- * convolution matrix in blur function.
+ * The type of the convolution matrices, fixed size so they need no allocation.
+ */
+typedef FixedMatrix<CONVOLUTION_MAT_ROWS, CONVOLUTION_MAT_COLS> ConvolutionMat;
+
+/**
+ * The convolution matrix of blur function.
+ */
+constexpr ConvolutionMat BLUR_CONVOLUTION_MAT(1.0 / 16, 2.0 / 16, 1.0 / 16,
+                                              2.0 / 16, 4.0 / 16, 2.0 / 16,
+                                              1.0 / 16, 2.0 / 16, 1.0 / 16);
+/**
+ * The convolution matrix of sobel function of axis X.
+ */
+constexpr ConvolutionMat SOBEL_X_CONVOLUTION_MAT(1.0 / 8, 0.0, -1.0 / 8,
+                                                 2.0 / 8, 0.0, -2.0 / 8,
+                                                 1.0 / 8, 0.0, -1.0 / 8);
+/**
+ * The convolution matrix of sobel function of axis Y, the transpose of the axis X one.
+ */
+constexpr ConvolutionMat SOBEL_Y_CONVOLUTION_MAT = SOBEL_X_CONVOLUTION_MAT.transpose();
+
+static_assert(SOBEL_Y_CONVOLUTION_MAT(0, 1) == 2.0 / 8 && SOBEL_Y_CONVOLUTION_MAT(2, 0) == -1.0 / 8,
+              "the axis Y sobel matrix is the transpose of the axis X one");
+
+static_assert(findSeparable(BLUR_CONVOLUTION_MAT).isExact &&
+              findSeparable(SOBEL_X_CONVOLUTION_MAT).isExact &&
+              findSeparable(SOBEL_Y_CONVOLUTION_MAT).isExact,
+              "the blur and sobel matrices run on the exact separable path");
+
+/**
+ * The separable form of the axis X sobel matrix, the one of the axis Y matrix is its transpose.
+ */
+constexpr SeparableKernel<CONVOLUTION_MAT_ROWS, CONVOLUTION_MAT_COLS> SOBEL_SEPARABLE_KERNEL =
+        findSeparable(SOBEL_X_CONVOLUTION_MAT);
+
+static_assert(SOBEL_SEPARABLE_KERNEL.colWeights[0] == 1 &&
+              SOBEL_SEPARABLE_KERNEL.colWeights[1] == 2 &&
+              SOBEL_SEPARABLE_KERNEL.colWeights[2] == 1 &&
+              SOBEL_SEPARABLE_KERNEL.rowWeights[0] == 1 &&
+              SOBEL_SEPARABLE_KERNEL.rowWeights[1] == 0 &&
+              SOBEL_SEPARABLE_KERNEL.rowWeights[2] == -1,
+              "sobelRow has the weights of the sobel matrices");
+
+static_assert(findSeparable(BLUR_CONVOLUTION_MAT).colWeights[0] == 1 &&
+              findSeparable(BLUR_CONVOLUTION_MAT).colWeights[1] == 2 &&
+              findSeparable(BLUR_CONVOLUTION_MAT).colWeights[2] == 1 &&
+              findSeparable(BLUR_CONVOLUTION_MAT).rowWeights[0] == 1 &&
+              findSeparable(BLUR_CONVOLUTION_MAT).rowWeights[1] == 2 &&
+              findSeparable(BLUR_CONVOLUTION_MAT).rowWeights[2] == 1 &&
+              findSeparable(BLUR_CONVOLUTION_MAT).scale == 1.f / 16 &&
+              SOBEL_SEPARABLE_KERNEL.scale == 1.f / 8,
+              "the fixed point engine has the weights and scales of the blur and sobel matrices");
+
+/**
+ * The number of rows above and below a row that its convolution reads.
+ */
+const int CONVOLUTION_HALO_ROWS = CONVOLUTION_MAT_ROWS / 2;
+
+/**
+ * The default number of rows the streaming filters process at once.
+ */
+const int DEFAULT_BAND_ROWS = 256;
+
+/**
+ * The numThreads of the filters that runs them on all the threads of the pool.
+ */
+const int ALL_THREADS = 0;
+
+/**
+ * The size of the part of the image a parallel task of the filters works on, about the l2 cache
+ * of a core, so the rows a task reads and writes stay in its cache.
+ */
+const long PARALLEL_TILE_BYTES = 256 * 1024;
+
+/**
+ * The input of the streaming filters: reader(firstRow, rows) fills rows with the image rows from
+ * firstRow, rows.size() / cols of them. it is called on consecutive row ranges, every row of the
+ * image exactly once and in order, so it may read a file or a stream sequentially.
+ */
+typedef std::function<void(int firstRow, Span<float> rows)> RowBandReader;
+
+/**
+ * The output of the streaming filters: writer(firstRow, rows) gets the result rows from firstRow,
+ * rows.size() / cols of them, in order. the rows are valid only during the call.
  */
-const float BLUR_CONVOLUTION_MAT[CONVOLUTION_MAT_ROWS][CONVOLUTION_MAT_COLS] =
-                                                                {{1.0 / 16, 2.0 / 16, 1.0 / 16},
-                                                                {2.0 / 16, 4.0 / 16, 2.0 / 16},
-                                                                {1.0 / 16, 2.0 / 16, 1.0 / 16}};
+typedef std::function<void(int firstRow, Span<const float> rows)> RowBandWriter;
+
 /**
- * The convolution matrix of sobel function of axis X as float array, will be used to construct the
- * convolution matrix of axis X in sobel function.
+ * The number of row chunks a parallel task of FilterPipeline and of the in place filters runs,
+ * the rows of halo a task reads or calculates twice are amortized over them.
  */
-const float SOBEL_X_CONVOLUTION_MAT[CONVOLUTION_MAT_ROWS][CONVOLUTION_MAT_COLS] =
-                                                                {{1.0 / 8, 0.0, -1.0 / 8},
-                                                                 {2.0 / 8, 0.0, -2.0 / 8},
-                                                                 {1.0 / 8, 0.0, -1.0 / 8}};
+const int PIPELINE_TASK_CHUNKS = 16;
+
 /**
- * The convolution matrix of sobel function of axis Y as float array, will be used to construct the
- * convolution matrix of axis Y in sobel function.
+ * The most lloyd-max iterations of KMEANS_QUANTIZATION, each costs O(NUMBER_OF_COLORS + levels).
  */
-const float SOBEL_Y_CONVOLUTION_MAT[CONVOLUTION_MAT_ROWS][CONVOLUTION_MAT_COLS] =
-                                                                {{1.0 / 8, 2.0 / 8, 1.0 / 8},
-                                                                 {0.0, 0.0, 0.0},
-                                                                 {-1.0 / 8, -2.0 / 8, -1.0 / 8}};
+const int MAX_KMEANS_ITERATIONS = 64;
+
+/**
+ * @enum QuantizationMethod
+ * @brief the ways adaptiveQuantization picks the levels.
+ */
+enum QuantizationMethod
+{
+    /**
+     * The levels of quantization, NUMBER_OF_COLORS / levels colors each.
+     */
+    UNIFORM_QUANTIZATION,
+
+    /**
+     * The color range of the biggest squared error is split at its median pixel until there are
+     * levels ranges, a range is quantized to the mean of its pixels.
+     */
+    MEDIAN_CUT_QUANTIZATION,
+
+    /**
+     * The means of the median cut refined by lloyd-max (1D k-means) iterations: every color
+     * takes its nearest mean, and every mean is moved to the mean of the pixels of its colors,
+     * until they do not move.
+     */
+    KMEANS_QUANTIZATION
+};
+
+/**
+ * @enum GradientNorm
+ * @brief the norms sobelGradient may measure the gradient by.
+ */
+enum GradientNorm
+{
+    /**
+     * |gradX| + |gradY|, no square root.
+     */
+    L1_NORM,
+
+    /**
+     * sqrt(gradX^2 + gradY^2), the euclidean length of the gradient.
+     */
+    L2_NORM
+};
+
+/**
+ * @enum GradientOrientation
+ * @brief the directions of the gradient sobelGradient quantizes to, the nearest of the angle of
+ *        the gradient from the axis of the columns toward the axis of the rows (downwards),
+ *        modulo 180 degrees, in the order of the values of quantizeOrientations.
+ */
+enum GradientOrientation
+{
+    ORIENTATION_0,
+    ORIENTATION_45,
+    ORIENTATION_90,
+    ORIENTATION_135
+};
+
+/**
+ * @enum FilterType
+ * @brief the filters a FilterPipeline stage may run.
+ */
+enum FilterType
+{
+    BLUR_FILTER,
+    SOBEL_FILTER,
+    QUANTIZATION_FILTER
+};
+
+/**
+ * @struct FilterStage
+ * @brief A stage of a FilterPipeline.
+ */
+struct FilterStage
+{
+    FilterType type;
+
+    /**
+     * The quantization table of a QUANTIZATION_FILTER stage, nullptr for the others.
+     */
+    const float* table;
+};
+
+/**
+ * @class FilterPipeline
+ * @brief A chain of filters that runs fused: the stages run on a few rows at a time, each
+ *        keeping its last rows in a window of about PARALLEL_TILE_BYTES / number of stages, so
+ *        the intermediate images are never in memory and the rows between the stages stay in
+ *        the cache. the result is the one of calling the filters one after the other, for
+ *        example FilterPipeline().addBlur().addSobel().addQuantization(4).apply(image) is
+ *        quantization(sobel(blur(image)), 4).
+ */
+class FilterPipeline
+{
+public:
+    /**
+     * @fn FilterPipeline::addBlur();
+     * @brief adds a blur stage.
+     * @return this pipeline.
+     */
+    FilterPipeline& addBlur();
+
+    /**
+     * @fn FilterPipeline::addSobel();
+     * @brief adds a sobel stage.
+     * @return this pipeline.
+     */
+    FilterPipeline& addSobel();
+
+    /**
+     * @fn FilterPipeline::addQuantization(int levels);
+     * @brief adds a quantization stage.
+     * @param levels the levels of the quantization, exit the program if they are not between 1
+     *        and NUMBER_OF_COLORS.
+     * @return this pipeline.
+     */
+    FilterPipeline& addQuantization(int levels);
+
+    /**
+     *@fn FilterPipeline::getNumStages()const
+     *@return the number of stages.
+     */
+    int getNumStages() const { return (int) _stages.size(); }
+
+    /**
+     * @fn FilterPipeline::apply(const Matrix& image, int numThreads)const;
+     * @brief runs the stages on the image, a copy of it if there are none.
+     * @param image the image to run the stages on.
+     * @param numThreads the number of threads of the pool to use, see quantization.
+     * @return new Matrix with the value of image after all the stages.
+     */
+    Matrix apply(const Matrix& image, int numThreads = ALL_THREADS) const;
+
+    /**
+     * @fn FilterPipeline::applyBatch(Span<const Matrix> images, int numThreads,
+     *                                MatrixAllocator& allocator)const;
+     * @brief runs the stages on every image of a batch, for many small images: the results are
+     *        allocated at once from the allocator (a FrameArena makes them one arena), and the
+     *        images spread over the threads, an image per task. a batch of fewer images than
+     *        threads runs an image at a time, each on all the threads.
+     * @param images the images, of any dimensions.
+     * @param numThreads the number of threads of the pool to use, see quantization.
+     * @param allocator the allocator of the results, must outlive them.
+     * @return the results, in the order of the images.
+     */
+    std::vector<Matrix> applyBatch(Span<const Matrix> images, int numThreads = ALL_THREADS,
+                                   MatrixAllocator& allocator = Matrix::getDefaultAllocator())
+                                   const;
+
+private:
+    std::vector<FilterStage> _stages;
+
+    /**
+     * @fn FilterPipeline::_applyInto(const Matrix& image, Span<float> result, int numThreads)const;
+     * @brief runs the stages on the image into result, in strips of PIPELINE_TASK_CHUNKS chunks
+     *        on the threads.
+     */
+    void _applyInto(const Matrix& image, Span<float> result, int numThreads) const;
+
+    /**
+     * @fn FilterPipeline::_applyStrip(const Matrix& image, Span<float> result, int firstRow,
+     *                                 int numRows)const;
+     * @brief runs the stages on the rows [firstRow, firstRow + numRows) of the image.
+     * @param result the rows of the image of the result.
+     */
+    void _applyStrip(const Matrix& image, Span<float> result, int firstRow, int numRows) const;
+};
 
 
 
@@ -93,43 +344,377 @@ void _updateLowerLevelBoundInd(float num, int* arrayOfLevels, int arraySize, int
 float _getVal(const Matrix& image, int imageRow, int imageCol);
 
 /**
- * validate that all the values in the given Matrix are between MIN_COLOR_VAL - MAX_COLOR_VAL,
+ * validate that all the given values are between MIN_COLOR_VAL - MAX_COLOR_VAL,
  * if the value in some coordinate lower than MIN_COLOR_VAL it change it to MIN_COLOR_VAL,
  * if the value in some coordinate greater than MAX_COLOR_VAL it change it to MAX_COLOR_VAL.
- * @param mat the matrix to validate
+ * @param values the values to validate
  */
-void _validateResult(Matrix& mat);
+void _validateResult(Span<float> values);
 
 /**
- * Calculate the convolution with the given 'image' Matrix and 'convolutionMat' Matrix and updating
- * according to the convolution result the given Matrix reference 'result',
- * @param result the Matrix to update with the convolution calculations.
+ * Calculate the convolution with the given 'image' Matrix and 'convolutionMat' Matrix of the
+ * rows [firstRow, firstRow + numRows) of the image and updating according to the convolution
+ * result the given 'result' values, the rows outside the image count as 0. an image of small
+ * integers (any 8 bit image) runs on the exact separable engine of Convolution.h, other images
+ * on _directConvolution, the results are the same.
+ * @param result the numRows rows to update with the convolution calculations.
  * @param image the image to calculate in the convolution.
  * @param convolutionMat the convolution Matrix to calculate in the convolution.
+ * @param firstRow the first image row to calculate.
+ * @param numRows the number of rows to calculate.
  */
-void _convolution(Matrix& result, const Matrix& image, const Matrix& convolutionMat);
+void _convolution(Span<float> result, const Matrix& image, const ConvolutionMat& convolutionMat,
+                  int firstRow, int numRows);
+
+/**
+ * The direct convolution of _convolution, the 9 products of every coordinate summed in the
+ * order of the rows of the convolution matrix. only the coordinates on the image border read
+ * their neighbors through _getVal.
+ */
+void _directConvolution(Span<float> result, const Matrix& image,
+                        const ConvolutionMat& convolutionMat, int firstRow, int numRows);
+
+/**
+ * The sobel of the rows [firstRow, firstRow + numRows) of the image, the sum of the axis X
+ * convolution and the axis Y one validated. runs on _exactSobel if it can.
+ * @param result the numRows rows of the sobel.
+ * @param resultY numRows rows for the axis Y convolution.
+ */
+void _sobelBand(Span<float> result, Span<float> resultY, const Matrix& image, int firstRow,
+                int numRows);
+
+/**
+ * The sobel of _sobelBand on the single pass of sobelGradients, if the image rows it reads are
+ * exact (see exactConvolution), bit identical to the sum of the two convolutions.
+ * @return false, without touching result, if they are not.
+ */
+bool _exactSobel(Span<float> result, const Matrix& image, int firstRow, int numRows);
+
+/**
+ * _sobelBand with the axis Y rows in a scratch memory of the calling thread, that grows to the
+ * biggest band and is kept.
+ */
+void _sobelRows(Span<float> result, const Matrix& image, int firstRow, int numRows);
+
+/**
+ * Runs a filter of 3 x 3 convolutions on the image in place, in strips of PIPELINE_TASK_CHUNKS
+ * chunks on the threads. every chunk is copied, with a row around it, to a window of the thread
+ * before its result is written over it, and the rows around every strip are saved before any
+ * strip runs, so every chunk reads the original rows.
+ * @param filterRows filterRows(result, input, firstRow, numRows) calculates the numRows result
+ *        rows of the input rows from firstRow.
+ */
+void _convolutionInPlace(Matrix& image, int numThreads,
+                         const std::function<void(Span<float> result, const Matrix& input,
+                                                  int firstRow, int numRows)>& filterRows);
+
+/**
+ * Counts the colors of the image, the values are taken as their lookupTable index (the integral
+ * part clamped to the colors, nan as 0), band after band on the threads.
+ * @param counts set to the NUMBER_OF_COLORS counts.
+ */
+void _colorHistogram(const Matrix& image, long* counts, int numThreads);
+
+/**
+ * Builds the table of the given levels of the given method for the given colors histogram, in
+ * O(NUMBER_OF_COLORS * levels). the level values are integers.
+ * @param table set to the NUMBER_OF_COLORS level values.
+ */
+void _adaptiveQuantizationTable(const long* counts, int levels, QuantizationMethod method,
+                                float* table);
+
+/**
+ * The quantization of the given 'image' by the given table into 'result', band after band on
+ * the threads.
+ */
+void _quantizeImage(const Matrix& image, const float* table, Matrix& result, int numThreads);
+
+/**
+ * Runs the given stage on the rows [firstRow, firstRow + numRows) of the image.
+ * @param result the numRows rows of the result.
+ */
+void _applyStage(const FilterStage& stage, Span<float> result, const Matrix& image, int firstRow,
+                 int numRows);
+
+/**
+ * Creates the arrays of the quantization to the given levels, freed by the caller with delete[].
+ * @param levels the number of levels.
+ * @param arrayOfLimits set to the levels + 1 limits of the levels.
+ * @param arrayOfAverages set to the levels values of the levels.
+ */
+void _createLevelArrays(int levels, int*& arrayOfLimits, int*& arrayOfAverages);
+
+/**
+ * Returns the quantization table of the given levels, the level value of each of the
+ * NUMBER_OF_COLORS colors. the table of every number of levels is built once, on its first use,
+ * and kept. exit the program if levels is not between 1 and NUMBER_OF_COLORS.
+ * @param levels the number of levels.
+ * @return the NUMBER_OF_COLORS values of the table.
+ */
+const float* _quantizationTable(int levels);
+
+/**
+ * Perform the quantization of the given 'values' into 'result' (may be the same values) by the
+ * given table. a fraction takes the level of its integral part, a value below 0 (or nan) the
+ * first level and a value above 255 the last one.
+ */
+void _quantizeValues(Span<const float> values, Span<float> result, const float* table);
+
+/**
+ * Runs band(firstRow, numRows) on the bands of a rows x cols image, each of about
+ * PARALLEL_TILE_BYTES, as tasks of the thread pool. exit the program if numThreads is negative.
+ * @param numThreads the number of threads to use, ALL_THREADS for all the threads of the pool.
+ */
+void _parallelRows(int rows, int cols, int numThreads,
+                   const std::function<void(int firstRow, int numRows)>& band);
+
+/**
+ * Runs band(firstRow, numRows) on the bands of bandRows rows of rows rows as tasks of the thread
+ * pool, see _parallelRows.
+ */
+void _parallelBands(int rows, int bandRows, int numThreads,
+                    const std::function<void(int firstRow, int numRows)>& band);
+
+/**
+ * Runs filterBand on the image band after band, with CONVOLUTION_HALO_ROWS rows of halo.
+ * filterBand(input, result, numRows) calculates the numRows result rows of the input rows from
+ * CONVOLUTION_HALO_ROWS, the input has the halo rows around them (0 outside the image).
+ */
+void _streamConvolutionBands(int rows, int cols, const RowBandReader& reader,
+                             const RowBandWriter& writer, int bandRows,
+                             const std::function<void(const Matrix& input, Span<float> result,
+                                                      int numRows)>& filterBand);
 
 /**
  * Perform the quantization operation on the given 'image' according to the given 'levels'.
+ * a fraction takes the level of its integral part, a value below 0 (or nan) the first level and
+ * a value above 255 the last one. runs as a lookup in a table built once per number of levels.
  * @param image the image to perform the quantization on.
- * @param levels the levels to to perform the quantization according to.
+ * @param levels the levels to to perform the quantization according to, exit the program if they
+ *        are not between 1 and NUMBER_OF_COLORS.
+ * @param numThreads the number of threads of the pool to use, ALL_THREADS for all of them, exit
+ *        the program if it is negative. the result is the same for any number.
  * @return new Matrix with the value of image after the quantization.
  */
-Matrix quantization(const Matrix& image, int levels);
+Matrix quantization(const Matrix& image, int levels, int numThreads = ALL_THREADS);
 
 /**
  * Perform the blur operation on the given 'image'.
  * @param image the image to perform the blur on.
+ * @param numThreads the number of threads of the pool to use, see quantization.
  * @return new Matrix with the value of image after the blur.
  */
-Matrix blur(const Matrix& image);
+Matrix blur(const Matrix& image, int numThreads = ALL_THREADS);
 
 /**
  * Perform the sobel operation on the given 'image'.
  * @param image the image to perform the sobel on.
+ * @param numThreads the number of threads of the pool to use, see quantization.
  * @return new Matrix with the value of image after the sobel.
  */
-Matrix sobel(const Matrix& image);
+Matrix sobel(const Matrix& image, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the quantization operation on the given 'image' into the given 'result', that may be
+ * the image itself. allocates nothing after the first call of the levels.
+ * @param result the matrix to write the result to, exit the program if its dimensions are not
+ *        the ones of the image.
+ */
+void quantization(const Matrix& image, int levels, Matrix& result, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the blur operation on the given 'image' into the given 'result', that may be the image
+ * itself (see blurInPlace). a video loop may reuse the same two frames for ever.
+ * @param result the matrix to write the result to, exit the program if its dimensions are not
+ *        the ones of the image.
+ */
+void blur(const Matrix& image, Matrix& result, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the sobel operation on the given 'image' into the given 'result', see blur.
+ */
+void sobel(const Matrix& image, Matrix& result, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the sobel operation on the given 'image' as a gradient, both axes of every coordinate
+ * from a single read of its neighborhood (sobelGradients), written straight to the buffers of
+ * the caller, the gradients are the convolutions with the two sobel matrices. no full size
+ * gradient is kept, every thread keeps a few rows. exit the program if the dimensions of a
+ * result are not the ones of the image.
+ * @param image the image to perform the sobel on, it must not be one of the results.
+ * @param magnitude if not nullptr, set to the norm of the gradient of every coordinate rounded
+ *        and validated like sobel.
+ * @param orientation if not nullptr, set to the GradientOrientation of every coordinate, a zero
+ *        gradient is ORIENTATION_0.
+ * @param norm the norm of magnitude.
+ * @param numThreads the number of threads of the pool to use, see quantization.
+ */
+void sobelGradient(const Matrix& image, Matrix* magnitude, BasicMatrix<uint8_t>* orientation,
+                   GradientNorm norm = L2_NORM, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the blur operation on the given 8 bit 'image' on the fixed point engine, 16 bit
+ * integers instead of floats, so a vector register holds twice the pixels. the result is the one
+ * of blur on a Matrix of the same values.
+ * @param image the image to perform the blur on.
+ * @param numThreads the number of threads of the pool to use, see quantization.
+ * @return new 8 bit matrix with the value of image after the blur.
+ */
+BasicMatrix<uint8_t> blur(const BasicMatrix<uint8_t>& image, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the blur operation on the given 8 bit 'image' into the given 'result', that may be
+ * the image itself (at the cost of a copy of the image).
+ * @param result the matrix to write the result to, exit the program if its dimensions are not
+ *        the ones of the image.
+ */
+void blur(const BasicMatrix<uint8_t>& image, BasicMatrix<uint8_t>& result,
+          int numThreads = ALL_THREADS);
+
+/**
+ * Perform the sobel operation on the given 8 bit 'image' on the fixed point engine, see the 8
+ * bit blur. the result is the one of sobel on a Matrix of the same values.
+ */
+BasicMatrix<uint8_t> sobel(const BasicMatrix<uint8_t>& image, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the sobel operation on the given 8 bit 'image' into the given 'result', see the 8 bit
+ * blur.
+ */
+void sobel(const BasicMatrix<uint8_t>& image, BasicMatrix<uint8_t>& result,
+           int numThreads = ALL_THREADS);
+
+/**
+ * Perform the quantization operation on the given 'image' in place.
+ */
+void quantizationInPlace(Matrix& image, int levels, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the blur operation on the given 'image' in place. needs a window of about
+ * PARALLEL_TILE_BYTES per thread and two rows per strip of rows, kept for the next calls, so
+ * it allocates nothing once they fit the image.
+ */
+void blurInPlace(Matrix& image, int numThreads = ALL_THREADS);
+
+/**
+ * Perform the sobel operation on the given 'image' in place, see blurInPlace.
+ */
+void sobelInPlace(Matrix& image, int numThreads = ALL_THREADS);
+
+/**
+ * Perform a quantization of the given 'image' to levels adapted to its colors, so no level is
+ * spent on a range of colors the image does not have. the histogram of the colors is counted in
+ * one pass on the threads, the levels are picked from it in O(NUMBER_OF_COLORS * levels), and a
+ * second pass looks the colors up like in quantization. a fraction takes the level of its
+ * integral part, a value below 0 (or nan) the one of 0 and a value above 255 the one of 255.
+ * @param image the image to perform the quantization on.
+ * @param levels the number of levels, exit the program if it is not between 1 and
+ *        NUMBER_OF_COLORS.
+ * @param method the way to pick the levels.
+ * @param numThreads the number of threads of the pool to use, see quantization.
+ * @return new Matrix with the value of image after the quantization.
+ */
+Matrix adaptiveQuantization(const Matrix& image, int levels,
+                            QuantizationMethod method = KMEANS_QUANTIZATION,
+                            int numThreads = ALL_THREADS);
+
+/**
+ * Perform adaptiveQuantization of the given 'image' into the given 'result', that may be the
+ * image itself.
+ * @param result the matrix to write the result to, exit the program if its dimensions are not
+ *        the ones of the image.
+ */
+void adaptiveQuantization(const Matrix& image, int levels, Matrix& result,
+                          QuantizationMethod method = KMEANS_QUANTIZATION,
+                          int numThreads = ALL_THREADS);
+
+/**
+ * Perform the quantization operation on every image of a batch, see FilterPipeline::applyBatch.
+ * the table of the levels is built once for the whole batch.
+ * @return the results, in the order of the images.
+ */
+std::vector<Matrix> quantizationBatch(Span<const Matrix> images, int levels,
+                                      int numThreads = ALL_THREADS,
+                                      MatrixAllocator& allocator = Matrix::getDefaultAllocator());
+
+/**
+ * Perform the blur operation on every image of a batch, see FilterPipeline::applyBatch.
+ * @return the results, in the order of the images.
+ */
+std::vector<Matrix> blurBatch(Span<const Matrix> images, int numThreads = ALL_THREADS,
+                              MatrixAllocator& allocator = Matrix::getDefaultAllocator());
+
+/**
+ * Perform the sobel operation on every image of a batch, see FilterPipeline::applyBatch.
+ * @return the results, in the order of the images.
+ */
+std::vector<Matrix> sobelBatch(Span<const Matrix> images, int numThreads = ALL_THREADS,
+                               MatrixAllocator& allocator = Matrix::getDefaultAllocator());
+
+/**
+ * Perform the convolution of the given 'image' with a kernel of any odd dimensions, rounded and
+ * validated like blur. the convolution runs directly, separably or by fft, by the cost model of
+ * convolve.
+ * @param image the image to perform the convolution on.
+ * @param kernel the convolution kernel, exit the program if a dimension of it is even.
+ * @return new Matrix with the value of image after the convolution.
+ */
+Matrix convolutionFilter(const Matrix& image, const Matrix& kernel);
+
+/**
+ * Perform a gaussian blur of the given radius, with standard deviation radius / 3, on the given
+ * 'image'.
+ * @param image the image to perform the blur on.
+ * @param radius the radius of the kernel, exit the program if it is negative.
+ * @return new Matrix with the value of image after the blur.
+ */
+Matrix gaussianBlur(const Matrix& image, int radius);
+
+/**
+ * Perform a box blur of the given radius on the given 'image', the mean of the
+ * (2 * radius + 1) x (2 * radius + 1) window around every coordinate (the coordinates outside
+ * the image count as 0) rounded and validated like blur. runs on a SummedAreaTable, so it costs
+ * the same for any radius.
+ * @param image the image to perform the blur on.
+ * @param radius the radius of the window, exit the program if it is negative.
+ * @return new Matrix with the value of image after the blur.
+ */
+Matrix boxBlur(const Matrix& image, int radius);
+
+/**
+ * Perform the quantization operation on a rows x cols image band after band, the result is the
+ * one of quantization and is written as it is calculated, at most bandRows rows are in memory.
+ * exit the program if the dimensions are negative or bandRows is not positive.
+ * @param rows the number of rows of the image.
+ * @param cols the number of columns of the image.
+ * @param reader the input of the image rows.
+ * @param writer the output of the result rows.
+ * @param levels the levels to to perform the quantization according to.
+ * @param bandRows the number of rows processed at once.
+ */
+void quantizationStream(int rows, int cols, const RowBandReader& reader,
+                        const RowBandWriter& writer, int levels, int bandRows = DEFAULT_BAND_ROWS);
+
+/**
+ * Perform the blur operation on a rows x cols image band after band, for images bigger than
+ * the memory (for example a MappedMatrix input and a BinaryFileWriter output). the result is
+ * the one of blur, only bandRows + 2 input rows and bandRows result rows are in memory.
+ * exit the program if the dimensions are negative or bandRows is not positive.
+ * @param rows the number of rows of the image.
+ * @param cols the number of columns of the image.
+ * @param reader the input of the image rows.
+ * @param writer the output of the result rows.
+ * @param bandRows the number of rows processed at once.
+ */
+void blurStream(int rows, int cols, const RowBandReader& reader, const RowBandWriter& writer,
+                int bandRows = DEFAULT_BAND_ROWS);
+
+/**
+ * Perform the sobel operation on a rows x cols image band after band, see blurStream. the
+ * result is the one of sobel, it needs one more band of bandRows rows.
+ */
+void sobelStream(int rows, int cols, const RowBandReader& reader, const RowBandWriter& writer,
+                 int bandRows = DEFAULT_BAND_ROWS);
 
 //------------------------- implementations -------------------------
 
@@ -151,50 +736,137 @@ float _getVal(const Matrix& image, int imageRow, int imageCol)
     {
         return 0;
     }
-    return image(imageRow, imageCol);
+    return image.uncheckedAt(imageRow, imageCol);
+}
+
+void _validateResult(Span<float> values)
+{
+    clampArray(values.data(), MIN_COLOR_VAL, MAX_COLOR_VAL, values.data(), values.size());
 }
 
-void _validateResult(Matrix& mat)
+void _convolution(Span<float> result, const Matrix& image, const ConvolutionMat& convolutionMat,
+                  int firstRow, int numRows)
 {
-    int matSize = mat.getRows() * mat.getCols();
-    for(int i = 0; i < matSize; ++i)
+    if(!exactConvolution(result, image, findSeparable(convolutionMat), firstRow, numRows))
     {
-        if(mat[i] < MIN_COLOR_VAL)
-        {
-            mat[i] = MIN_COLOR_VAL;
-        }
-        else if(mat[i] > MAX_COLOR_VAL)
-        {
-            mat[i] = MAX_COLOR_VAL;
-        }
+        _directConvolution(result, image, convolutionMat, firstRow, numRows);
     }
 }
 
-void _convolution(Matrix& result, const Matrix& image, const Matrix& convolutionMat)
+bool _exactSobel(Span<float> result, const Matrix& image, int firstRow, int numRows)
 {
-    for(int row = 0; row < image.getRows(); ++row)
+    if(!isExactRows(image, firstRow - CONVOLUTION_HALO_ROWS,
+                    firstRow + numRows + CONVOLUTION_HALO_ROWS,
+                    std::floor(EXACT_SUM_LIMIT / SOBEL_SEPARABLE_KERNEL.weightSum)))
     {
-        for(int col = 0; col < image.getCols(); ++col)
-        {
+        return false;
+    }
+    int cols = image.getCols();
+    sobelGradients(image, firstRow, numRows,
+                   [result, firstRow, cols](int row, float* gradX, float* gradY)
+                   {
+                       float* resultRow = result.data() + (long) (row - firstRow) * cols;
+                       multiplyRound(gradX, SOBEL_SEPARABLE_KERNEL.scale, resultRow, cols);
+                       multiplyRound(gradY, SOBEL_SEPARABLE_KERNEL.scale, gradY, cols);
+                       addArrays(resultRow, gradY, resultRow, cols);
+                       _validateResult(Span<float>(resultRow, cols));
+                   });
+    return true;
+}
 
-            result(row, col) =  rintf(
-                    _getVal(image, row - 1, col - 1) * convolutionMat(0, 0) +
-                    _getVal(image, row - 1, col)     * convolutionMat(0, 1) +
-                    _getVal(image, row - 1, col + 1) * convolutionMat(0, 2) +
-                    _getVal(image, row, col - 1)     * convolutionMat(1, 0) +
-                    _getVal(image, row, col)         * convolutionMat(1, 1) +
-                    _getVal(image, row, col + 1)     * convolutionMat(1, 2) +
-                    _getVal(image, row + 1, col - 1) * convolutionMat(2, 0) +
-                    _getVal(image, row + 1, col)     * convolutionMat(2, 1) +
-                    _getVal(image, row + 1, col + 1) * convolutionMat(2, 2));
+void _sobelBand(Span<float> result, Span<float> resultY, const Matrix& image, int firstRow,
+                int numRows)
+{
+    if(_exactSobel(result, image, firstRow, numRows))
+    {
+        return;
+    }
+    _convolution(result, image, SOBEL_X_CONVOLUTION_MAT, firstRow, numRows);
+    _convolution(resultY, image, SOBEL_Y_CONVOLUTION_MAT, firstRow, numRows);
+    addArrays(result.data(), resultY.data(), result.data(), result.size());
+    _validateResult(result);
+}
+
+void _sobelRows(Span<float> result, const Matrix& image, int firstRow, int numRows)
+{
+    static thread_local std::vector<float> resultY;
+    if((long) resultY.size() < result.size())
+    {
+        resultY.resize(result.size());
+    }
+    _sobelBand(result, Span<float>(resultY.data(), result.size()), image, firstRow, numRows);
+}
+
+void _applyStage(const FilterStage& stage, Span<float> result, const Matrix& image, int firstRow,
+                 int numRows)
+{
+    switch(stage.type)
+    {
+        case BLUR_FILTER:
+            _convolution(result, image, BLUR_CONVOLUTION_MAT, firstRow, numRows);
+            _validateResult(result);
+            break;
+        case SOBEL_FILTER:
+            _sobelRows(result, image, firstRow, numRows);
+            break;
+        default:
+            _quantizeValues(image.getData().subspan((long) firstRow * image.getCols(),
+                                                    result.size()), result, stage.table);
+            break;
+    }
+}
+
+void _directConvolution(Span<float> result, const Matrix& image,
+                        const ConvolutionMat& convolutionMat, int firstRow, int numRows)
+{
+    const float* kernelTop = convolutionMat.data();
+    const float* kernelMid = kernelTop + CONVOLUTION_MAT_COLS;
+    const float* kernelBottom = kernelMid + CONVOLUTION_MAT_COLS;
+    int cols = image.getCols();
+    for(int row = firstRow; row < firstRow + numRows; ++row)
+    {
+        float* resultRow = result.data() + (long) (row - firstRow) * cols;
+        bool isInnerRow = 0 < row && row < image.getRows() - 1;
+        for(int col = 0; col < cols; ++col)
+        {
+            if(isInnerRow && 0 < col && col < cols - 1)
+            {
+                //the inner coordinates up to the last one, the same sum without the checks.
+                const float* top = image.rowPtr(row - 1);
+                const float* mid = image.rowPtr(row);
+                const float* bottom = image.rowPtr(row + 1);
+                for(; col < cols - 1; ++col)
+                {
+                    resultRow[col] = rintf(
+                            top[col - 1]    * kernelTop[0] +
+                            top[col]        * kernelTop[1] +
+                            top[col + 1]    * kernelTop[2] +
+                            mid[col - 1]    * kernelMid[0] +
+                            mid[col]        * kernelMid[1] +
+                            mid[col + 1]    * kernelMid[2] +
+                            bottom[col - 1] * kernelBottom[0] +
+                            bottom[col]     * kernelBottom[1] +
+                            bottom[col + 1] * kernelBottom[2]);
+                }
+            }
+            resultRow[col] =  rintf(
+                    _getVal(image, row - 1, col - 1) * kernelTop[0] +
+                    _getVal(image, row - 1, col)     * kernelTop[1] +
+                    _getVal(image, row - 1, col + 1) * kernelTop[2] +
+                    _getVal(image, row, col - 1)     * kernelMid[0] +
+                    _getVal(image, row, col)         * kernelMid[1] +
+                    _getVal(image, row, col + 1)     * kernelMid[2] +
+                    _getVal(image, row + 1, col - 1) * kernelBottom[0] +
+                    _getVal(image, row + 1, col)     * kernelBottom[1] +
+                    _getVal(image, row + 1, col + 1) * kernelBottom[2]);
         }
     }
 }
 
-Matrix quantization(const Matrix& image, int levels)
+void _createLevelArrays(int levels, int*& arrayOfLimits, int*& arrayOfAverages)
 {
     //create the array of levels
-    int* arrayOfLimits = new int[levels + 1];
+    arrayOfLimits = new int[levels + 1];
     int numOfColorsInLevel = NUMBER_OF_COLORS / levels;
     for(int i = 0; i < levels; ++i)
     {
@@ -203,73 +875,800 @@ Matrix quantization(const Matrix& image, int levels)
     arrayOfLimits[levels] = NUMBER_OF_COLORS; //for average calculations.
 
     //create array of the averages
-    int* arrayOfAverages = new int[levels];
+    arrayOfAverages = new int[levels];
     for(int i = 0; i < levels; ++i)
     {
         arrayOfAverages[i] = (arrayOfLimits[i] + arrayOfLimits[i + 1] - 1) / 2;
     }
     arrayOfLimits[levels] = NUMBER_OF_COLORS;
+}
+
+const float* _quantizationTable(int levels)
+{
+    if(levels < 1 || levels > NUMBER_OF_COLORS)
+    {
+        cerr << INVALID_LEVELS_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+    static std::mutex tablesMutex;
+    static std::vector<float> tables[NUMBER_OF_COLORS + 1];
+    std::lock_guard<std::mutex> lock(tablesMutex);
+    std::vector<float>& table = tables[levels];
+    if(table.empty())
+    {
+        //the level of every color by the scan of the levels limits.
+        int* arrayOfLimits;
+        int* arrayOfAverages;
+        _createLevelArrays(levels, arrayOfLimits, arrayOfAverages);
+        table.resize(NUMBER_OF_COLORS);
+        int lowerLevelBound = 0; //the lower bound index in arrayOfLimits -> the needed index in
+                                 // arrayOfAverages
+        for(int color = 0; color < NUMBER_OF_COLORS; ++color)
+        {
+            _updateLowerLevelBoundInd(color, arrayOfLimits, levels + 1, lowerLevelBound);
+            table[color] = arrayOfAverages[lowerLevelBound];
+        }
+        delete[] arrayOfLimits;
+        delete[] arrayOfAverages;
+    }
+    return table.data();
+}
 
+void _quantizeValues(Span<const float> values, Span<float> result, const float* table)
+{
+    lookupTable(values.data(), table, result.data(), values.size());
+}
+
+void _parallelRows(int rows, int cols, int numThreads,
+                   const std::function<void(int firstRow, int numRows)>& band)
+{
+    long rowBytes = std::max(1L, (long) cols * (long) sizeof(float));
+    _parallelBands(rows, (int) std::max(1L, PARALLEL_TILE_BYTES / rowBytes), numThreads, band);
+}
+
+/**
+ * exit the program if the number of threads of a filter is negative.
+ */
+static void _validateNumThreads(int numThreads)
+{
+    if(numThreads < 0)
+    {
+        std::cerr << INVALID_NUM_THREADS_ERROR << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void _parallelBands(int rows, int bandRows, int numThreads,
+                    const std::function<void(int firstRow, int numRows)>& band)
+{
+    _validateNumThreads(numThreads);
+    if(rows <= 0)
+    {
+        return;
+    }
+    ThreadPool& pool = ThreadPool::getInstance();
+    int numBands = (rows + bandRows - 1) / bandRows;
+    pool.parallelFor(numBands,
+                     [&band, bandRows, rows](int bandIndex)
+                     {
+                         int firstRow = bandIndex * bandRows;
+                         band(firstRow, std::min(bandRows, rows - firstRow));
+                     },
+                     numThreads == ALL_THREADS ? pool.getNumThreads() : numThreads);
+}
+
+/**
+ * exit the program if the result does not have the dimensions of the image.
+ */
+template <typename T, typename U>
+static void _validateResultDimensions(const BasicMatrix<T>& image, const BasicMatrix<U>& result)
+{
+    if(image.getRows() != result.getRows() || image.getCols() != result.getCols())
+    {
+        std::cerr << INVALID_DIMENSIONS_ERROR << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void _convolutionInPlace(Matrix& image, int numThreads,
+                         const std::function<void(Span<float> result, const Matrix& input,
+                                                  int firstRow, int numRows)>& filterRows)
+{
+    _validateNumThreads(numThreads);
+    int rows = image.getRows();
+    int cols = image.getCols();
+    if(rows <= 0 || cols <= 0)
+    {
+        return;
+    }
+    Span<float> data = image.getData();
+    int chunkRows = (int) std::max(1L, PARALLEL_TILE_BYTES / ((long) cols * (long) sizeof(float)));
+    int stripRows = (int) std::min((long) rows, (long) chunkRows * PIPELINE_TASK_CHUNKS);
+    int numStrips = (rows + stripRows - 1) / stripRows;
+
+    //the row above and the row below every strip, 0 outside the image.
+    static thread_local std::vector<float> edges;
+    edges.assign(2L * numStrips * cols, 0.f);
+    for(int strip = 0; strip < numStrips; ++strip)
+    {
+        int above = strip * stripRows - 1;
+        int below = std::min(rows, (strip + 1) * stripRows);
+        if(above >= 0)
+        {
+            std::copy(data.begin() + (long) above * cols, data.begin() + (long) (above + 1) * cols,
+                      edges.begin() + 2L * strip * cols);
+        }
+        if(below < rows)
+        {
+            std::copy(data.begin() + (long) below * cols, data.begin() + (long) (below + 1) * cols,
+                      edges.begin() + (2L * strip + 1) * cols);
+        }
+    }
+
+    const float* savedEdges = edges.data();
+    _parallelBands(rows, stripRows, numThreads,
+                   [&filterRows, data, savedEdges, rows, cols, chunkRows, stripRows]
+                   (int firstRow, int numRows)
+    {
+        //the window row j is the original image row chunkFirst - 1 + j.
+        static thread_local Matrix window(0, 0, HeapAllocator::getInstance());
+        if(window.getRows() != chunkRows + 2 || window.getCols() != cols)
+        {
+            Matrix newWindow(chunkRows + 2, cols, HeapAllocator::getInstance());
+            window.swap(newWindow);
+        }
+        Span<float> windowData = window.getData();
+        const float* stripEdges = savedEdges + 2L * (firstRow / stripRows) * cols;
+        int stripEnd = firstRow + numRows;
+        for(int chunkFirst = firstRow; chunkFirst < stripEnd; chunkFirst += chunkRows)
+        {
+            int chunkEnd = std::min(stripEnd, chunkFirst + chunkRows);
+            if(chunkFirst == firstRow)
+            {
+                std::copy(stripEdges, stripEdges + cols, windowData.begin());
+            }
+            else
+            {
+                //the last row of the previous chunk, before it was written over.
+                std::copy(windowData.begin() + (long) chunkRows * cols,
+                          windowData.begin() + (long) (chunkRows + 1) * cols, windowData.begin());
+            }
+            std::copy(data.begin() + (long) chunkFirst * cols,
+                      data.begin() + (long) chunkEnd * cols, windowData.begin() + cols);
+            const float* below = chunkEnd < stripEnd ? data.begin() + (long) chunkEnd * cols
+                                                     : stripEdges + cols;
+            std::copy(below, below + cols,
+                      windowData.begin() + (long) (chunkEnd - chunkFirst + 1) * cols);
+            int numChunkRows = chunkEnd - chunkFirst;
+            filterRows(data.subspan((long) chunkFirst * cols, (long) numChunkRows * cols), window,
+                       1, numChunkRows);
+        }
+    });
+}
+
+Matrix quantization(const Matrix& image, int levels, int numThreads)
+{
     Matrix matToReturn(image.getRows(), image.getCols());
+    quantization(image, levels, matToReturn, numThreads);
+    return matToReturn;
+}
+
+void quantization(const Matrix& image, int levels, Matrix& matToReturn, int numThreads)
+{
+    _validateResultDimensions(image, matToReturn);
+    _quantizeImage(image, _quantizationTable(levels), matToReturn, numThreads);
+}
+
+void _quantizeImage(const Matrix& image, const float* table, Matrix& matToReturn, int numThreads)
+{
+    Span<const float> values = image.getData();
+    Span<float> result = matToReturn.getData();
+    int cols = image.getCols();
+    _parallelRows(image.getRows(), cols, numThreads,
+                  [values, result, table, cols](int firstRow, int numRows)
+                  {
+                      long first = (long) firstRow * cols;
+                      long size = (long) numRows * cols;
+                      _quantizeValues(values.subspan(first, size), result.subspan(first, size),
+                                      table);
+                  });
+}
+
+
+Matrix blur(const Matrix& image, int numThreads)
+{
+    Matrix convolutionResult = Matrix(image.getRows(), image.getCols());
+    blur(image, convolutionResult, numThreads);
+    return convolutionResult;
+}
+
+void blur(const Matrix& image, Matrix& convolutionResult, int numThreads)
+{
+    _validateResultDimensions(image, convolutionResult);
+    if(&image == &convolutionResult)
+    {
+        blurInPlace(convolutionResult, numThreads);
+        return;
+    }
+    Span<float> result = convolutionResult.getData();
+    int cols = image.getCols();
+    _parallelRows(image.getRows(), cols, numThreads,
+                  [&image, result, cols](int firstRow, int numRows)
+                  {
+                      Span<float> band = result.subspan((long) firstRow * cols,
+                                                        (long) numRows * cols);
+                      _convolution(band, image, BLUR_CONVOLUTION_MAT, firstRow, numRows);
+                      _validateResult(band);
+                  });
+}
+
+Matrix sobel(const Matrix& image, int numThreads)
+{
+    Matrix res(image.getRows(), image.getCols());
+    sobel(image, res, numThreads);
+    return res;
+}
+
+void sobel(const Matrix& image, Matrix& res, int numThreads)
+{
+    _validateResultDimensions(image, res);
+    if(&image == &res)
+    {
+        sobelInPlace(res, numThreads);
+        return;
+    }
+    //a band at a time, so the axis Y convolution needs a band per thread and not a second image.
+    Span<float> result = res.getData();
+    int cols = image.getCols();
+    _parallelRows(image.getRows(), cols, numThreads,
+                  [&image, result, cols](int firstRow, int numRows)
+                  {
+                      _sobelRows(result.subspan((long) firstRow * cols, (long) numRows * cols),
+                                 image, firstRow, numRows);
+                  });
+}
+
+void sobelGradient(const Matrix& image, Matrix* magnitude, BasicMatrix<uint8_t>* orientation,
+                   GradientNorm norm, int numThreads)
+{
+    if(magnitude != nullptr)
+    {
+        _validateResultDimensions(image, *magnitude);
+    }
+    if(orientation != nullptr)
+    {
+        _validateResultDimensions(image, *orientation);
+    }
+    int cols = image.getCols();
+    auto rowGradients = [magnitude, orientation, norm, cols](int row, float* gradX, float* gradY)
+    {
+        if(magnitude != nullptr)
+        {
+            float* magnitudeRow = magnitude->rowPtr(row);
+            for(int col = 0; col < cols; ++col)
+            {
+                magnitudeRow[col] = norm == L1_NORM ?
+                                    std::fabs(gradX[col]) + std::fabs(gradY[col]) :
+                                    std::sqrt(gradX[col] * gradX[col] + gradY[col] * gradY[col]);
+            }
+            multiplyRound(magnitudeRow, SOBEL_SEPARABLE_KERNEL.scale, magnitudeRow, cols);
+            _validateResult(Span<float>(magnitudeRow, cols));
+        }
+        if(orientation != nullptr)
+        {
+            quantizeOrientations(gradX, gradY, orientation->rowPtr(row), cols);
+        }
+    };
+    _parallelRows(image.getRows(), cols, numThreads,
+                  [&image, &rowGradients](int firstRow, int numRows)
+                  {
+                      sobelGradients(image, firstRow, numRows, rowGradients);
+                  });
+}
+
+/**
+ * runs the filter of the fixed point engine on the 8 bit image into result, a band of about
+ * PARALLEL_TILE_BYTES of the image per task.
+ */
+static void _fixedPointFilter(const BasicMatrix<uint8_t>& image, BasicMatrix<uint8_t>& result,
+                              FixedPointFilter filter, int numThreads)
+{
+    _validateResultDimensions(image, result);
+    if(&image == &result)
+    {
+        BasicMatrix<uint8_t> input(image);
+        _fixedPointFilter(input, result, filter, numThreads);
+        return;
+    }
+    Span<uint8_t> values = result.getData();
+    int cols = image.getCols();
+    _parallelBands(image.getRows(), (int) std::max(1L, PARALLEL_TILE_BYTES / std::max(1, cols)),
+                   numThreads,
+                   [&image, values, filter, cols](int firstRow, int numRows)
+                   {
+                       fixedPointConvolution(values.subspan((long) firstRow * cols,
+                                                            (long) numRows * cols),
+                                             image, filter, firstRow, numRows);
+                   });
+}
+
+BasicMatrix<uint8_t> blur(const BasicMatrix<uint8_t>& image, int numThreads)
+{
+    BasicMatrix<uint8_t> result(image.getRows(), image.getCols());
+    blur(image, result, numThreads);
+    return result;
+}
+
+void blur(const BasicMatrix<uint8_t>& image, BasicMatrix<uint8_t>& result, int numThreads)
+{
+    _fixedPointFilter(image, result, FIXED_POINT_BLUR, numThreads);
+}
+
+BasicMatrix<uint8_t> sobel(const BasicMatrix<uint8_t>& image, int numThreads)
+{
+    BasicMatrix<uint8_t> result(image.getRows(), image.getCols());
+    sobel(image, result, numThreads);
+    return result;
+}
+
+void sobel(const BasicMatrix<uint8_t>& image, BasicMatrix<uint8_t>& result, int numThreads)
+{
+    _fixedPointFilter(image, result, FIXED_POINT_SOBEL, numThreads);
+}
+
+void quantizationInPlace(Matrix& image, int levels, int numThreads)
+{
+    quantization(image, levels, image, numThreads);
+}
+
+void _colorHistogram(const Matrix& image, long* counts, int numThreads)
+{
+    std::fill(counts, counts + NUMBER_OF_COLORS, 0L);
+    std::mutex countsMutex;
+    Span<const float> values = image.getData();
+    int cols = image.getCols();
+    _parallelRows(image.getRows(), cols, numThreads,
+                  [values, counts, cols, &countsMutex](int firstRow, int numRows)
+                  {
+                      long bandCounts[NUMBER_OF_COLORS] = {};
+                      histogram(values.data() + (long) firstRow * cols, bandCounts,
+                                (long) numRows * cols);
+                      std::lock_guard<std::mutex> lock(countsMutex);
+                      for(int color = 0; color < NUMBER_OF_COLORS; ++color)
+                      {
+                          counts[color] += bandCounts[color];
+                      }
+                  });
+}
+
+void _adaptiveQuantizationTable(const long* counts, int levels, QuantizationMethod method,
+                                float* table)
+{
+    if(method == UNIFORM_QUANTIZATION)
+    {
+        const float* uniformTable = _quantizationTable(levels);
+        std::copy(uniformTable, uniformTable + NUMBER_OF_COLORS, table);
+        return;
+    }
+    if(levels < 1 || levels > NUMBER_OF_COLORS)
+    {
+        std::cerr << INVALID_LEVELS_ERROR << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-    //do the quantization
-    int imageMatSize = image.getRows() * image.getCols();
-    int lowerLevelBound; //the lower bound index in arrayOfLimits -> the needed index in
-                         // arrayOfAverages
-    for(int i = 0; i < imageMatSize; ++i)
+    //the pixels, the sum and the sum of squares of the colors below every color, so the mean
+    //and the squared error of a range of colors cost O(1).
+    double prefixCount[NUMBER_OF_COLORS + 1] = {};
+    double prefixSum[NUMBER_OF_COLORS + 1] = {};
+    double prefixSquares[NUMBER_OF_COLORS + 1] = {};
+    for(int color = 0; color < NUMBER_OF_COLORS; ++color)
     {
-        _updateLowerLevelBoundInd(image[i], arrayOfLimits, levels + 1, lowerLevelBound);
-        matToReturn[i] = arrayOfAverages[lowerLevelBound];
+        prefixCount[color + 1] = prefixCount[color] + (double) counts[color];
+        prefixSum[color + 1] = prefixSum[color] + (double) counts[color] * color;
+        prefixSquares[color + 1] = prefixSquares[color] + (double) counts[color] * color * color;
     }
-    delete[] arrayOfLimits;
-    delete[] arrayOfAverages;
+    auto rangeCount = [&](int first, int end) { return prefixCount[end] - prefixCount[first]; };
+    auto rangeMean = [&](int first, int end)
+    {
+        double count = rangeCount(first, end);
+        return count > 0 ? (prefixSum[end] - prefixSum[first]) / count : (first + end - 1) / 2.;
+    };
+    auto rangeError = [&](int first, int end)
+    {
+        double sum = prefixSum[end] - prefixSum[first];
+        double count = rangeCount(first, end);
+        return count > 0 ? prefixSquares[end] - prefixSquares[first] - sum * sum / count : 0.;
+    };
+
+    //median cut, the ranges are kept by their first colors, in order.
+    std::vector<int> rangeFirsts(1, 0);
+    while((int) rangeFirsts.size() < levels)
+    {
+        int worst = -1;
+        double worstError = 0;
+        for(int i = 0; i < (int) rangeFirsts.size(); ++i)
+        {
+            int end = i + 1 < (int) rangeFirsts.size() ? rangeFirsts[i + 1] : NUMBER_OF_COLORS;
+            double error = rangeError(rangeFirsts[i], end);
+            if(error > worstError)
+            {
+                worst = i;
+                worstError = error;
+            }
+        }
+        if(worst < 0)
+        {
+            break;
+        }
+        //a range of error has two colors with pixels, the median leaves pixels on both sides.
+        int first = rangeFirsts[worst];
+        int end = worst + 1 < (int) rangeFirsts.size() ? rangeFirsts[worst + 1] : NUMBER_OF_COLORS;
+        double half = rangeCount(first, end) / 2;
+        int split = first + 1;
+        while(split < end - 1 && rangeCount(first, split) < half)
+        {
+            ++split;
+        }
+        while(rangeCount(split, end) == 0)
+        {
+            --split;
+        }
+        rangeFirsts.insert(rangeFirsts.begin() + worst + 1, split);
+    }
+    int numLevels = (int) rangeFirsts.size();
+    rangeFirsts.push_back(NUMBER_OF_COLORS);
+    std::vector<double> means(numLevels);
+    for(int i = 0; i < numLevels; ++i)
+    {
+        means[i] = rangeMean(rangeFirsts[i], rangeFirsts[i + 1]);
+    }
+
+    //lloyd-max, the colors of a mean are the ones between the midpoints to its neighbors.
+    for(int iteration = 0; method == KMEANS_QUANTIZATION && iteration < MAX_KMEANS_ITERATIONS;
+        ++iteration)
+    {
+        bool isMoved = false;
+        for(int i = 1; i < numLevels; ++i)
+        {
+            int midpoint = (int) std::floor((means[i - 1] + means[i]) / 2);
+            rangeFirsts[i] = std::min(NUMBER_OF_COLORS, std::max(rangeFirsts[i - 1], midpoint + 1));
+        }
+        for(int i = 0; i < numLevels; ++i)
+        {
+            if(rangeCount(rangeFirsts[i], rangeFirsts[i + 1]) > 0)
+            {
+                double mean = rangeMean(rangeFirsts[i], rangeFirsts[i + 1]);
+                isMoved = isMoved || mean != means[i];
+                means[i] = mean;
+            }
+        }
+        if(!isMoved)
+        {
+            break;
+        }
+    }
+
+    for(int i = 0; i < numLevels; ++i)
+    {
+        std::fill(table + rangeFirsts[i], table + rangeFirsts[i + 1],
+                  (float) std::rint(means[i]));
+    }
+}
 
+Matrix adaptiveQuantization(const Matrix& image, int levels, QuantizationMethod method,
+                            int numThreads)
+{
+    Matrix matToReturn(image.getRows(), image.getCols());
+    adaptiveQuantization(image, levels, matToReturn, method, numThreads);
     return matToReturn;
 }
 
+void adaptiveQuantization(const Matrix& image, int levels, Matrix& result,
+                          QuantizationMethod method, int numThreads)
+{
+    _validateResultDimensions(image, result);
+    long counts[NUMBER_OF_COLORS];
+    _colorHistogram(image, counts, numThreads);
+    float table[NUMBER_OF_COLORS];
+    _adaptiveQuantizationTable(counts, levels, method, table);
+    _quantizeImage(image, table, result, numThreads);
+}
+
+void blurInPlace(Matrix& image, int numThreads)
+{
+    _convolutionInPlace(image, numThreads, [](Span<float> result, const Matrix& input,
+                                              int firstRow, int numRows)
+    {
+        _convolution(result, input, BLUR_CONVOLUTION_MAT, firstRow, numRows);
+        _validateResult(result);
+    });
+}
+
+void sobelInPlace(Matrix& image, int numThreads)
+{
+    _convolutionInPlace(image, numThreads, _sobelRows);
+}
+
+FilterPipeline& FilterPipeline::addBlur()
+{
+    _stages.push_back({BLUR_FILTER, nullptr});
+    return *this;
+}
+
+FilterPipeline& FilterPipeline::addSobel()
+{
+    _stages.push_back({SOBEL_FILTER, nullptr});
+    return *this;
+}
+
+FilterPipeline& FilterPipeline::addQuantization(int levels)
+{
+    _stages.push_back({QUANTIZATION_FILTER, _quantizationTable(levels)});
+    return *this;
+}
+
+Matrix FilterPipeline::apply(const Matrix& image, int numThreads) const
+{
+    if(_stages.empty())
+    {
+        return image;
+    }
+    Matrix res(image.getRows(), image.getCols());
+    _applyInto(image, res.getData(), numThreads);
+    return res;
+}
+
+std::vector<Matrix> FilterPipeline::applyBatch(Span<const Matrix> images, int numThreads,
+                                               MatrixAllocator& allocator) const
+{
+    std::vector<Matrix> results;
+    results.reserve(images.size());
+    for(const Matrix& image : images)
+    {
+        results.emplace_back(image.getRows(), image.getCols(), allocator);
+    }
+
+    int poolThreads = ThreadPool::getInstance().getNumThreads();
+    int threads = numThreads == ALL_THREADS ? poolThreads : std::min(numThreads, poolThreads);
+    if(images.size() < threads)
+    {
+        for(long i = 0; i < images.size(); ++i)
+        {
+            _applyInto(images[i], results[i].getData(), numThreads);
+        }
+        return results;
+    }
+    _parallelBands((int) images.size(), 1, numThreads, [this, images, &results](int index, int)
+    {
+        _applyStrip(images[index], results[index].getData(), 0, images[index].getRows());
+    });
+    return results;
+}
+
+void FilterPipeline::_applyInto(const Matrix& image, Span<float> result, int numThreads) const
+{
+    long rowBytes = std::max(1L, (long) image.getCols() * (long) sizeof(float));
+    long chunkRows = std::max(1L, PARALLEL_TILE_BYTES / rowBytes / std::max(1, getNumStages()));
+    _parallelBands(image.getRows(), (int) std::min((long) image.getRows(),
+                                                   chunkRows * PIPELINE_TASK_CHUNKS),
+                   numThreads, [this, &image, result](int firstRow, int numRows)
+                   {
+                       _applyStrip(image, result, firstRow, numRows);
+                   });
+}
+
+std::vector<Matrix> quantizationBatch(Span<const Matrix> images, int levels, int numThreads,
+                                      MatrixAllocator& allocator)
+{
+    return FilterPipeline().addQuantization(levels).applyBatch(images, numThreads, allocator);
+}
 
-Matrix blur(const Matrix& image)
+std::vector<Matrix> blurBatch(Span<const Matrix> images, int numThreads,
+                              MatrixAllocator& allocator)
 {
-    Matrix convolutionMat = Matrix(image.getRows(), image.getCols());
-    for(int row = 0; row < image.getRows(); ++row)
+    return FilterPipeline().addBlur().applyBatch(images, numThreads, allocator);
+}
+
+std::vector<Matrix> sobelBatch(Span<const Matrix> images, int numThreads,
+                               MatrixAllocator& allocator)
+{
+    return FilterPipeline().addSobel().applyBatch(images, numThreads, allocator);
+}
+
+void FilterPipeline::_applyStrip(const Matrix& image, Span<float> result, int firstRow,
+                                 int numRows) const
+{
+    int rows = image.getRows();
+    int cols = image.getCols();
+    int numStages = getNumStages();
+    if(numStages == 0)
+    {
+        std::copy(image.getData().begin() + (long) firstRow * cols,
+                  image.getData().begin() + (long) (firstRow + numRows) * cols,
+                  result.begin() + (long) firstRow * cols);
+        return;
+    }
+    long rowBytes = std::max(1L, (long) cols * (long) sizeof(float));
+    int chunkRows = (int) std::max(1L, PARALLEL_TILE_BYTES / rowBytes / numStages);
+
+    //the window of a stage keeps the rows of the current chunk and the halo rows around them
+    //that the convolutions of the next stages read, the rows outside the image are 0.
+    std::vector<int> halos(numStages, 0);
+    for(int stage = numStages - 2; stage >= 0; --stage)
+    {
+        halos[stage] = halos[stage + 1] + (_stages[stage + 1].type == QUANTIZATION_FILTER ? 0 : 1);
+    }
+    std::vector<Matrix> windows;
+    for(int stage = 0; stage < numStages - 1; ++stage)
+    {
+        windows.emplace_back(chunkRows + 2 * halos[stage], cols);
+    }
+
+    for(int chunkFirst = firstRow; chunkFirst < firstRow + numRows; chunkFirst += chunkRows)
     {
-        for(int col = 0; col < image.getCols(); ++col)
+        int chunkEnd = std::min(firstRow + numRows, chunkFirst + chunkRows);
+        for(int stage = 0; stage < numStages; ++stage)
         {
-            convolutionMat(row, col) = BLUR_CONVOLUTION_MAT[row][col];
+            //the rows of the window of the stage before start at its halo above the chunk.
+            const Matrix& input = stage == 0 ? image : windows[stage - 1];
+            int inputFirst = stage == 0 ? 0 : chunkFirst - halos[stage - 1];
+            if(stage == numStages - 1)
+            {
+                _applyStage(_stages[stage],
+                            result.subspan((long) chunkFirst * cols,
+                                           (long) (chunkEnd - chunkFirst) * cols),
+                            input, chunkFirst - inputFirst, chunkEnd - chunkFirst);
+                continue;
+            }
+
+            int halo = halos[stage];
+            int windowFirst = chunkFirst - halo;
+            int newFirst = windowFirst;
+            Span<float> window = windows[stage].getData();
+            if(chunkFirst != firstRow)
+            {
+                //the halo rows of the previous chunk below it are the ones above this chunk.
+                std::copy(window.begin() + (long) chunkRows * cols,
+                          window.begin() + (long) (chunkRows + 2 * halo) * cols, window.begin());
+                newFirst = chunkFirst + halo;
+            }
+            int newEnd = chunkEnd + halo;
+            int computeFirst = std::min(std::max(newFirst, 0), newEnd);
+            int computeEnd = std::max(std::min(newEnd, rows), computeFirst);
+            std::fill(window.begin() + (long) (newFirst - windowFirst) * cols,
+                      window.begin() + (long) (computeFirst - windowFirst) * cols, 0.f);
+            std::fill(window.begin() + (long) (computeEnd - windowFirst) * cols,
+                      window.begin() + (long) (newEnd - windowFirst) * cols, 0.f);
+            if(computeEnd > computeFirst)
+            {
+                _applyStage(_stages[stage],
+                            window.subspan((long) (computeFirst - windowFirst) * cols,
+                                           (long) (computeEnd - computeFirst) * cols),
+                            input, computeFirst - inputFirst, computeEnd - computeFirst);
+            }
         }
     }
+}
 
-    Matrix convolutionResult = Matrix(image.getRows(), image.getCols());
+Matrix convolutionFilter(const Matrix& image, const Matrix& kernel)
+{
+    Matrix convolutionResult = convolve(image, kernel);
+    Span<float> values = convolutionResult.getData();
+    multiplyRound(values.data(), 1.f, values.data(), values.size());
+    _validateResult(values);
+    return convolutionResult;
+}
+
+Matrix gaussianBlur(const Matrix& image, int radius)
+{
+    return convolutionFilter(image, gaussianKernel(radius, std::max(radius, 1) / 3.f));
+}
 
-    _convolution(convolutionResult, image, convolutionMat);
-    _validateResult(convolutionResult);
+Matrix boxBlur(const Matrix& image, int radius)
+{
+    Matrix convolutionResult = SummedAreaTable(image).boxFilter(radius);
+    Span<float> values = convolutionResult.getData();
+    multiplyRound(values.data(), 1.f, values.data(), values.size());
+    _validateResult(values);
     return convolutionResult;
 }
 
-Matrix sobel(const Matrix& image)
+/**
+ * validate the dimensions of a streaming filter, exit the program if they are negative or
+ * bandRows is not positive.
+ */
+static void _validateStreamDimensions(int rows, int cols, int bandRows)
 {
-    Matrix convolutionMatX = Matrix(image.getRows(), image.getCols());
-    Matrix convolutionMatY = Matrix(image.getRows(), image.getCols());
+    if(rows < 0 || cols < 0 || bandRows <= 0)
+    {
+        cerr << INVALID_DIMENSIONS_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+}
 
-    Matrix convolutionResultsX = Matrix(image.getRows(), image.getCols());
-    Matrix convolutionResultsY = Matrix(image.getRows(), image.getCols());
+void _streamConvolutionBands(int rows, int cols, const RowBandReader& reader,
+                             const RowBandWriter& writer, int bandRows,
+                             const std::function<void(const Matrix& input, Span<float> result,
+                                                      int numRows)>& filterBand)
+{
+    _validateStreamDimensions(rows, cols, bandRows);
+    bandRows = std::min(bandRows, std::max(rows, 1));
 
-    for(int row = 0; row < image.getRows(); ++row)
+    //the input row i is the image row firstRow - CONVOLUTION_HALO_ROWS + i, the rows above the
+    //image start as 0.
+    Matrix input(bandRows + 2 * CONVOLUTION_HALO_ROWS, cols);
+    Matrix result(bandRows, cols);
+    int nextReadRow = 0;
+    for(int firstRow = 0; firstRow < rows; firstRow += bandRows)
     {
-        for(int col = 0; col < image.getCols(); ++col)
+        int numRows = std::min(bandRows, rows - firstRow);
+        int inputOffset = CONVOLUTION_HALO_ROWS - firstRow;
+        int endReadRow = std::min(rows, firstRow + numRows + CONVOLUTION_HALO_ROWS);
+        if(nextReadRow < endReadRow)
         {
-            convolutionMatX(row, col) = SOBEL_X_CONVOLUTION_MAT[row][col];
-            convolutionMatY(row, col) = SOBEL_Y_CONVOLUTION_MAT[row][col];
+            reader(nextReadRow, Span<float>(input.rowPtr(nextReadRow + inputOffset),
+                                            (long) (endReadRow - nextReadRow) * cols));
+            nextReadRow = endReadRow;
         }
+        //the halo rows below the image are 0.
+        float* belowImage = input.getData().data() + (long) (endReadRow + inputOffset) * cols;
+        std::fill(belowImage, belowImage + (long) (firstRow + numRows + CONVOLUTION_HALO_ROWS -
+                                                   endReadRow) * cols, 0.f);
+
+        Span<float> resultRows = result.getData().subspan(0, (long) numRows * cols);
+        filterBand(input, resultRows, numRows);
+        writer(firstRow, resultRows);
+
+        //the last rows of the band are the halo above the next band.
+        std::copy(input.rowPtr(numRows), input.rowPtr(numRows) + 2L * CONVOLUTION_HALO_ROWS * cols,
+                  input.rowPtr(0));
     }
+}
+
+void quantizationStream(int rows, int cols, const RowBandReader& reader,
+                        const RowBandWriter& writer, int levels, int bandRows)
+{
+    _validateStreamDimensions(rows, cols, bandRows);
+    bandRows = std::min(bandRows, std::max(rows, 1));
 
-    _convolution(convolutionResultsX, image, convolutionMatX);
-    _convolution(convolutionResultsY, image, convolutionMatY);
+    const float* table = _quantizationTable(levels);
+    Matrix band(bandRows, cols);
+    for(int firstRow = 0; firstRow < rows; firstRow += bandRows)
+    {
+        Span<float> bandRowsData = band.getData().subspan(
+                0, (long) std::min(bandRows, rows - firstRow) * cols);
+        reader(firstRow, bandRowsData);
+        _quantizeValues(bandRowsData, bandRowsData, table);
+        writer(firstRow, bandRowsData);
+    }
+}
 
-    Matrix res = convolutionResultsX + convolutionResultsY;
-    _validateResult(res);
+void blurStream(int rows, int cols, const RowBandReader& reader, const RowBandWriter& writer,
+                int bandRows)
+{
+    _streamConvolutionBands(rows, cols, reader, writer, bandRows,
+                            [](const Matrix& input, Span<float> result, int numRows)
+                            {
+                                _convolution(result, input, BLUR_CONVOLUTION_MAT,
+                                             CONVOLUTION_HALO_ROWS, numRows);
+                                _validateResult(result);
+                            });
+}
 
-    return res;
+void sobelStream(int rows, int cols, const RowBandReader& reader, const RowBandWriter& writer,
+                 int bandRows)
+{
+    _validateStreamDimensions(rows, cols, bandRows);
+    Matrix convolutionResultsY(std::min(bandRows, std::max(rows, 1)), cols);
+    _streamConvolutionBands(rows, cols, reader, writer, bandRows,
+                            [&convolutionResultsY](const Matrix& input, Span<float> result,
+                                                   int numRows)
+                            {
+                                Span<float> resultY = convolutionResultsY.getData().subspan(
+                                        0, result.size());
+                                _sobelBand(result, resultY, input, CONVOLUTION_HALO_ROWS,
+                                           numRows);
+                            });
 }
 
 
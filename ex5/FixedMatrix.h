@@ -0,0 +1,293 @@
+#ifndef SUMMER_EX4_FIXEDMATRIX_H
+#define SUMMER_EX4_FIXEDMATRIX_H
+
+/**
+ * @file FixedMatrix.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief a matrix with compile time dimensions for small kernels (convolution kernels, color
+ *        transforms), stored in place without any allocation. all the operations are constexpr
+ *        and loop over compile time bounds, so the compiler unrolls them. the arithmetic is the
+ *        plain one of T, meant for float and double coefficients.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <type_traits>
+#include "Matrix.h"
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @class FixedMatrix
+ * @brief A R x C matrix of T, row major.
+ */
+template <int R, int C, typename T = float>
+class FixedMatrix
+{
+
+public:
+    static_assert(R > 0 && C > 0, "a FixedMatrix has at least one row and one column");
+
+    static const int ROWS = R;
+
+    static const int COLS = C;
+
+    /**
+     * @brief a matrix with all coordinates 0.
+     */
+    constexpr FixedMatrix() : _data{} {}
+
+    /**
+     * @brief a matrix of the given R * C values, row after row, for example
+     *        FixedMatrix<2, 2> rotation(0.f, -1.f, 1.f, 0.f).
+     */
+    template <typename... Values,
+              typename = typename std::enable_if<
+                      sizeof...(Values) == R * C &&
+                      std::conjunction<std::is_arithmetic<Values>...>::value>::type>
+    constexpr FixedMatrix(Values... values) : _data{static_cast<T>(values)...} {}
+
+    /**
+     * @return the matrix with 1 on the diagonal and 0 elsewhere.
+     */
+    static constexpr FixedMatrix identity()
+    {
+        FixedMatrix result;
+        for(int i = 0; i < R && i < C; ++i)
+        {
+            result(i, i) = T(1);
+        }
+        return result;
+    }
+
+    /**
+     * @brief copies a dynamic matrix, exit the program if its dimensions are not R x C.
+     */
+    static FixedMatrix fromMatrix(const BasicMatrix<T>& mat)
+    {
+        if(mat.getRows() != R || mat.getCols() != C)
+        {
+            cerr << INVALID_DIMENSIONS_ERROR << endl;
+            exit(EXIT_FAILURE);
+        }
+        FixedMatrix result;
+        for(int i = 0; i < R * C; ++i)
+        {
+            result._data[i] = mat.uncheckedAt((long) i);
+        }
+        return result;
+    }
+
+    /**
+     * @return a dynamic matrix with the same coordinates.
+     */
+    BasicMatrix<T> toMatrix() const
+    {
+        BasicMatrix<T> result(R, C);
+        for(int i = 0; i < R * C; ++i)
+        {
+            result.uncheckedAt((long) i) = _data[i];
+        }
+        return result;
+    }
+
+    constexpr int getRows() const { return R; }
+
+    constexpr int getCols() const { return C; }
+
+    /**
+    *@fn FixedMatrix::operator()(int row, int col);
+    *@return the row col coordinate by reference, checked only when MATRIX_CHECKED_ACCESS is
+    *        defined, like the unchecked accessors of Matrix.
+    */
+    constexpr T& operator()(int row, int col)
+    {
+        if(row < 0 || col < 0 || R <= row || C <= col)
+        {
+            checkAccess(false);
+        }
+        return _data[row * C + col];
+    }
+
+    constexpr const T& operator()(int row, int col) const
+    {
+        if(row < 0 || col < 0 || R <= row || C <= col)
+        {
+            checkAccess(false);
+        }
+        return _data[row * C + col];
+    }
+
+    /**
+    *@fn FixedMatrix::operator[](int ind);
+    *@return the ind coordinate of the row major data by reference, checked only when
+    *        MATRIX_CHECKED_ACCESS is defined.
+    */
+    constexpr T& operator[](int ind)
+    {
+        if(ind < 0 || R * C <= ind)
+        {
+            checkAccess(false);
+        }
+        return _data[ind];
+    }
+
+    constexpr const T& operator[](int ind) const
+    {
+        if(ind < 0 || R * C <= ind)
+        {
+            checkAccess(false);
+        }
+        return _data[ind];
+    }
+
+    /**
+     * @return the R * C coordinates, row after row.
+     */
+    constexpr const T* data() const { return _data; }
+
+    constexpr FixedMatrix operator+(const FixedMatrix& rhs) const
+    {
+        FixedMatrix result;
+        for(int i = 0; i < R * C; ++i)
+        {
+            result._data[i] = _data[i] + rhs._data[i];
+        }
+        return result;
+    }
+
+    constexpr FixedMatrix& operator+=(const FixedMatrix& rhs)
+    {
+        for(int i = 0; i < R * C; ++i)
+        {
+            _data[i] += rhs._data[i];
+        }
+        return *this;
+    }
+
+    constexpr FixedMatrix operator*(const T& c) const
+    {
+        FixedMatrix result;
+        for(int i = 0; i < R * C; ++i)
+        {
+            result._data[i] = _data[i] * c;
+        }
+        return result;
+    }
+
+    friend constexpr FixedMatrix operator*(const T& c, const FixedMatrix& rhs) { return rhs * c; }
+
+    constexpr FixedMatrix& operator*=(const T& c)
+    {
+        for(int i = 0; i < R * C; ++i)
+        {
+            _data[i] *= c;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief the division by c, unlike Matrix a zero c is not checked (a constexpr division by
+     *        zero does not compile).
+     */
+    constexpr FixedMatrix operator/(const T& c) const
+    {
+        FixedMatrix result;
+        for(int i = 0; i < R * C; ++i)
+        {
+            result._data[i] = _data[i] / c;
+        }
+        return result;
+    }
+
+    /**
+     * @return the matrix multiplication, the dimensions are checked at compile time. every
+     *         coordinate sums its products in the order of the textbook loop.
+     */
+    template <int K>
+    constexpr FixedMatrix<R, K, T> operator*(const FixedMatrix<C, K, T>& rhs) const
+    {
+        FixedMatrix<R, K, T> result;
+        for(int i = 0; i < R; ++i)
+        {
+            for(int j = 0; j < K; ++j)
+            {
+                T sum = T(0);
+                for(int p = 0; p < C; ++p)
+                {
+                    sum += (*this)(i, p) * rhs(p, j);
+                }
+                result(i, j) = sum;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @return the matrix multiplication with a dynamic matrix of C rows (for example a color
+     *         transform of pixels stored one per column), exit the program if the rhs has
+     *         another number of rows.
+     */
+    BasicMatrix<T> operator*(const BasicMatrix<T>& rhs) const
+    {
+        if(rhs.getRows() != C)
+        {
+            cerr << INVALID_DIMENSIONS_ERROR << endl;
+            exit(EXIT_FAILURE);
+        }
+        BasicMatrix<T> result(R, rhs.getCols());
+        for(int i = 0; i < R; ++i)
+        {
+            T* resultRow = result.rowPtr(i);
+            for(int p = 0; p < C; ++p)
+            {
+                T lhsVal = (*this)(i, p);
+                const T* rhsRow = rhs.rowPtr(p);
+                for(int j = 0; j < rhs.getCols(); ++j)
+                {
+                    resultRow[j] += lhsVal * rhsRow[j];
+                }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @return the C x R transposed matrix.
+     */
+    constexpr FixedMatrix<C, R, T> transpose() const
+    {
+        FixedMatrix<C, R, T> result;
+        for(int i = 0; i < R; ++i)
+        {
+            for(int j = 0; j < C; ++j)
+            {
+                result(j, i) = (*this)(i, j);
+            }
+        }
+        return result;
+    }
+
+    constexpr bool operator==(const FixedMatrix& rhs) const
+    {
+        for(int i = 0; i < R * C; ++i)
+        {
+            if(_data[i] != rhs._data[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool operator!=(const FixedMatrix& rhs) const { return !(*this == rhs); }
+
+private:
+    T _data[R * C];
+};
+
+#endif //SUMMER_EX4_FIXEDMATRIX_H
@@ -0,0 +1,141 @@
+#ifndef SUMMER_EX4_HALF_H
+#define SUMMER_EX4_HALF_H
+
+/**
+ * @file Half.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief a software IEEE 754 half precision (fp16) float, for Matrix storage. it is only a
+ *        storage type, the arithmetic converts to float and back.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <cstdint>
+#include <cstring>
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @class Half
+ * @brief A 16 bit float: 1 sign bit, 5 exponent bits and 10 mantissa bits. converts implicitly
+ *        from and to float, the conversion from float rounds to nearest even like the hardware
+ *        conversions do.
+ */
+class Half
+{
+
+public:
+    /**
+     * @brief zero.
+     */
+    Half() : _bits(0) {}
+
+    /**
+     * @brief the nearest half of value, ties to even. too big values become infinity.
+     */
+    Half(float value) : _bits(_fromFloat(value)) {}
+
+    /**
+     * @return the exact float value of the half.
+     */
+    operator float() const { return _toFloat(_bits); }
+
+    /**
+     * @return the 16 bits of the half.
+     */
+    uint16_t getBits() const { return _bits; }
+
+    /**
+     * @return the half of the given 16 bits.
+     */
+    static Half fromBits(uint16_t bits)
+    {
+        Half half;
+        half._bits = bits;
+        return half;
+    }
+
+private:
+    uint16_t _bits;
+
+    /**
+     * @return the bits of the nearest half to value.
+     */
+    static uint16_t _fromFloat(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint16_t sign = (bits >> 16) & 0x8000;
+        uint32_t absBits = bits & 0x7fffffff;
+
+        if(absBits >= 0x7f800000) //infinity or nan, nan stays a (quiet) nan.
+        {
+            return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0);
+        }
+        if(absBits >= 0x477ff000) //65520 and above round to infinity.
+        {
+            return sign | 0x7c00;
+        }
+        if(absBits < 0x38800000) //below 2^-14, a subnormal half or zero.
+        {
+            if(absBits < 0x33000000) //below 2^-25, rounds to zero.
+            {
+                return sign;
+            }
+            int exponent = (int) (absBits >> 23);
+            uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+            int shift = 126 - exponent;
+            uint32_t halfMantissa = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if(remainder > halfway || (remainder == halfway && (halfMantissa & 1)))
+            {
+                ++halfMantissa;
+            }
+            return sign | halfMantissa;
+        }
+
+        //rebias the exponent from 127 to 15, a carry of the rounding moves to the exponent.
+        uint32_t halfBits = (absBits - 0x38000000) >> 13;
+        uint32_t remainder = absBits & 0x1fff;
+        if(remainder > 0x1000 || (remainder == 0x1000 && (halfBits & 1)))
+        {
+            ++halfBits;
+        }
+        return sign | halfBits;
+    }
+
+    /**
+     * @return the float value of the given half bits.
+     */
+    static float _toFloat(uint16_t half)
+    {
+        uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1f;
+        uint32_t mantissa = half & 0x3ff;
+        uint32_t bits;
+        if(exponent == 0)
+        {
+            //zero or subnormal, mantissa * 2^-24.
+            float value = mantissa * (1.f / 16777216.f);
+            return sign ? -value : value;
+        }
+        else if(exponent == 31)
+        {
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else
+        {
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+#endif //SUMMER_EX4_HALF_H
@@ -8,323 +8,553 @@
  */
 
 #include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <utility>
 #include "Matrix.h"
+#include "TiledMatrix.h"
+#include "ThreadPool.h"
+#include "SimdKernels.h"
 
-Matrix::Matrix(int rows, int cols)
-{
-    if(rows < 0 || cols < 0)
-    {
-        exit(EXIT_FAILURE);
-    }
-    else
-    {
-        _rows = rows;
-        _cols = cols;
-        _matrix = new float[rows * cols];
-        long matSize = _rows * _cols;
-        for(long i = 0; i < matSize; ++i)
-        {
-            _matrix[i] = 0;
-        }
-    }
-}
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
-Matrix::Matrix(const Matrix& rhs): _rows(rhs._rows ), _cols(rhs._cols)
-{
-    _matrix =  new float[_rows * _cols];
+// ------------------------------ gemm kernels ------------------------------
 
-    long matSize = _rows * _cols;
-    for(long i = 0; i < matSize; ++i)
-    {
-        _matrix[i] = rhs._matrix[i];
-    }
-}
+/**
+ * Number of lhs rows the multiplication micro-kernel keeps in registers.
+ */
+static const int GEMM_MR = 6;
 
-Matrix::~Matrix()
-{
-    delete[] _matrix;
-    _matrix = nullptr;
-}
+/**
+ * Number of rhs columns the multiplication micro-kernel keeps in registers.
+ */
+static const int GEMM_NR = 16;
 
-Matrix & Matrix::vectorize()
-{
-    _rows *= _cols;
-    _cols = 1;
-    return *this;
-}
+/**
+ * Number of lhs rows in a packed lhs block, GEMM_MC * GEMM_KC floats stay in the L2 cache.
+ */
+static const int GEMM_MC = 96;
 
-void Matrix::print() const
+/**
+ * The depth of the packed blocks, a GEMM_KC * GEMM_NR rhs micro-panel stays in the L1 cache.
+ */
+static const int GEMM_KC = 256;
+
+/**
+ * Number of rhs columns in a packed rhs block, GEMM_KC * GEMM_NC floats stay in the L3 cache.
+ */
+static const int GEMM_NC = 2048;
+
+/**
+ * Below this number of multiply-adds the packing costs more than it saves.
+ */
+static const long GEMM_SMALL_WORK = 32L * 32 * 32;
+
+/**
+ * Below this number of multiply-adds the product runs on the calling thread only.
+ */
+static const long GEMM_PARALLEL_WORK = 128L * 128 * 128;
+
+/**
+ * The number of result tiles per pool thread the parallel multiplication aims for, more tiles
+ * than threads balance the load when some threads are slower.
+ */
+static const int GEMM_TASKS_PER_THREAD = 4;
+
+/**
+ * The number of result tiles the parallel multiplication aims for in the deterministic mode,
+ * fixed so the tiles do not depend on the number of threads.
+ */
+static const int GEMM_DETERMINISTIC_TILES = 64;
+
+/**
+ * The minimal number of columns in a result tile of the parallel multiplication.
+ */
+static const int GEMM_MIN_TASK_COLS = 8 * GEMM_NR;
+
+/**
+ * @brief the portable micro-kernel, adds to the GEMM_MR x GEMM_NR tile in 'result' the product
+ *        of a packed lhs sliver and a packed rhs sliver. the tile is loaded before the
+ *        accumulation so every coordinate sums its products in the same order as the textbook
+ *        loop.
+ * @param kc the depth of the slivers.
+ * @param packedLhs GEMM_MR lhs rows packed column by column.
+ * @param packedRhs GEMM_NR rhs columns packed row by row.
+ * @param result the top left coordinate of the result tile.
+ * @param ldc the distance between two rows of the result.
+ */
+static void _microKernel(int kc, const float* packedLhs, const float* packedRhs, float* result,
+                         long ldc)
 {
-    for(int row = 0; row < _rows; ++row)
+    float acc[GEMM_MR][GEMM_NR];
+    for(int i = 0; i < GEMM_MR; ++i)
     {
-        for(int col = 0; col < _cols - 1; ++col)
-        {
-            cout << this->operator()(row, col) << " ";
-        }
-        cout << this->operator()(row, _cols - 1);
-        if(row != _rows - 1)
+        for(int j = 0; j < GEMM_NR; ++j)
         {
-            cout << endl;
+            acc[i][j] = result[i * ldc + j];
         }
     }
-}
 
-Matrix& Matrix::operator=(const Matrix &rhs)
-{
-    if(this == &rhs)
+    for(int p = 0; p < kc; ++p)
     {
-        return *this;
+        const float* lhsCol = packedLhs + p * GEMM_MR;
+        const float* rhsRow = packedRhs + p * GEMM_NR;
+        for(int i = 0; i < GEMM_MR; ++i)
+        {
+            float lhsVal = lhsCol[i];
+            for(int j = 0; j < GEMM_NR; ++j)
+            {
+                acc[i][j] += lhsVal * rhsRow[j];
+            }
+        }
     }
 
-    _rows = rhs._rows;
-    _cols = rhs._cols;
-    delete[] _matrix;
-
-    _matrix = new float[rhs._rows * rhs._cols]();
-
-    long matSize = _rows * _cols;
-    for(long i = 0; i < matSize; ++i)
+    for(int i = 0; i < GEMM_MR; ++i)
     {
-        _matrix[i] = rhs._matrix[i];
+        for(int j = 0; j < GEMM_NR; ++j)
+        {
+            result[i * ldc + j] = acc[i][j];
+        }
     }
-    return *this;
 }
 
-Matrix Matrix::operator*(const Matrix &rhs) const
+#ifdef MATRIX_X86_DISPATCH
+/**
+ * @brief the AVX2 + FMA version of _microKernel, holds the whole tile in 12 ymm registers.
+ */
+__attribute__((target("avx2,fma")))
+static void _microKernelAvx2(int kc, const float* packedLhs, const float* packedRhs,
+                             float* result, long ldc)
 {
-    if(_cols != rhs._rows)
+    __m256 acc[GEMM_MR][2];
+    for(int i = 0; i < GEMM_MR; ++i)
     {
-        cerr << INVALID_DIMENSIONS_ERROR << endl;
-        exit(EXIT_FAILURE);
+        acc[i][0] = _mm256_loadu_ps(result + i * ldc);
+        acc[i][1] = _mm256_loadu_ps(result + i * ldc + 8);
     }
 
-    Matrix newMat = Matrix(_rows, rhs._cols);
-    for(int i = 0; i < newMat._rows; i++)
+    for(int p = 0; p < kc; ++p)
     {
-        for(int j = 0; j < newMat._cols; j++)
+        __m256 rhsLow = _mm256_loadu_ps(packedRhs + p * GEMM_NR);
+        __m256 rhsHigh = _mm256_loadu_ps(packedRhs + p * GEMM_NR + 8);
+        for(int i = 0; i < GEMM_MR; ++i)
         {
-            for(int k = 0; k < _cols; k++)
-            {
-                newMat(i, j) += (this->operator()(i, k) * rhs(k, j));
-            }
+            __m256 lhsVal = _mm256_broadcast_ss(packedLhs + p * GEMM_MR + i);
+            acc[i][0] = _mm256_fmadd_ps(lhsVal, rhsLow, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(lhsVal, rhsHigh, acc[i][1]);
         }
     }
-    return newMat;
-}
 
-Matrix Matrix::operator*(const float &c) const
-{
-    return c * (*this);
-}
-
-Matrix operator*(const int &c, const Matrix &rhs)
-{
-    Matrix newMat = Matrix(rhs._rows, rhs._cols);
-    long matSize = newMat._rows * newMat._cols;
-    for(long i = 0; i < matSize; ++i)
+    for(int i = 0; i < GEMM_MR; ++i)
     {
-        newMat._matrix[i] = rhs._matrix[i] * c;
+        _mm256_storeu_ps(result + i * ldc, acc[i][0]);
+        _mm256_storeu_ps(result + i * ldc + 8, acc[i][1]);
     }
-
-    return newMat;
 }
+#endif
 
-Matrix &Matrix::operator*=(const Matrix &rhs)
-{
-    Matrix newMat = Matrix(_rows, rhs._cols);
-    newMat = (*this) * rhs; //validate the dimensions in ((*this) * mat) operator.
-
-    *this = newMat;
-    return *this;
-}
+/**
+ * The type of the micro-kernels above.
+ */
+typedef void (*MicroKernel)(int, const float*, const float*, float*, long);
 
-Matrix& Matrix::operator*=(const float &scalar)
+/**
+ * @return the fastest micro-kernel the running cpu supports, detected once.
+ */
+static MicroKernel _selectMicroKernel()
 {
-    int matSize = _rows * _cols;
-    for(int i = 0; i < matSize; ++i)
+#ifdef MATRIX_X86_DISPATCH
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
     {
-        _matrix[i] *= scalar;
+        return _microKernelAvx2;
     }
-    return *this;
+#endif
+    return _microKernel;
 }
 
-
-Matrix Matrix::operator+(const Matrix &rhs) const
+/**
+ * @brief a row major operand of the multiplication kernels, its coordinate (row, col) is
+ *        data[row * ld + col]. F is float, or const float for the sources.
+ */
+template <typename F>
+struct RowMajorOperand
 {
-    _isValidForAddition(*this, rhs); //if not will exit the program
+    F* data;
+    long ld;
 
-    Matrix newMat = Matrix(_rows, _cols);
-    for(long int i = 0; i < _rows * _cols; i++)
-    {
-        newMat._matrix[i] = _matrix[i] + rhs._matrix[i];
-    }
-    return newMat;
-}
+    F* at(int row, int col) const { return data + row * ld + col; }
 
-Matrix &Matrix::operator+=(const Matrix &rhs)
-{
-    _isValidForAddition(*this, rhs); //if not will exit the program
+    RowMajorOperand block(int row, int col) const { return {at(row, col), ld}; }
 
-    int matSize = _rows * _cols;
+    /**
+     * @return the number of coordinates of the row from col on that are contiguous.
+     */
+    int runLength(int) const { return INT32_MAX; }
 
-    for(int i = 0; i < matSize; ++i)
-    {
-        _matrix[i] += rhs._matrix[i];
-    }
-    return *this;
-}
+    /**
+     * @return the distance between the numRows rows from row, 0 if it is not even.
+     */
+    long rowStride(int, int) const { return ld; }
+};
 
-Matrix& Matrix::operator+=(const float &scalar)
+/**
+ * @brief an operand of the multiplication kernels in the tile layout of TiledMatrix, from the
+ *        coordinate (firstRow, firstCol) of the matrix.
+ */
+template <typename F>
+struct TiledOperand
 {
-    int matSize = _rows * _cols;
+    F* tiles;
+    int tileCols;
+    int firstRow;
+    int firstCol;
 
-    for(int i = 0; i < matSize; ++i)
+    F* at(int row, int col) const
     {
-        _matrix[i] += scalar;
+        row += firstRow;
+        col += firstCol;
+        return tiles + ((long) (row / TILE_SIZE) * tileCols + col / TILE_SIZE) * TILE_SIZE *
+                       TILE_SIZE + (row % TILE_SIZE) * TILE_SIZE + col % TILE_SIZE;
     }
-    return *this;
-}
 
-const float& Matrix::operator[](const int &ind) const
-{
-    if(ind < 0 || ind >= _rows * _cols)
+    TiledOperand block(int row, int col) const
     {
-        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
-        exit(EXIT_FAILURE);
+        return {tiles, tileCols, firstRow + row, firstCol + col};
     }
-    return _matrix[ind];
-}
 
-float& Matrix::operator[](const int &ind)
-{
-    if(ind < 0 || ind >= _rows * _cols)
+    int runLength(int col) const { return TILE_SIZE - (firstCol + col) % TILE_SIZE; }
+
+    long rowStride(int row, int numRows) const
     {
-        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
-        exit(EXIT_FAILURE);
+        return (firstRow + row) % TILE_SIZE + numRows <= TILE_SIZE ? TILE_SIZE : 0;
     }
-    return _matrix[ind];
-}
+};
+
+static_assert(TILE_SIZE % GEMM_NR == 0, "a rhs sliver in the tile layout is in one tile");
 
-const float& Matrix::operator()(const int &row, const int &col) const
+/**
+ * @brief packs the mc x kc lhs block into GEMM_MR row slivers, each sliver stored column by
+ *        column, the last sliver is padded with zeros.
+ */
+template <typename Lhs>
+static void _packLhs(const Lhs& lhs, int mc, int kc, float* packed)
 {
-    if(row < 0 || col < 0 || _rows <= row || _cols <= col)
+    for(int ir = 0; ir < mc; ir += GEMM_MR)
     {
-        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
-        exit(EXIT_FAILURE);
+        int mr = std::min(GEMM_MR, mc - ir);
+        for(int p = 0; p < kc; ++p)
+        {
+            for(int i = 0; i < GEMM_MR; ++i)
+            {
+                *packed++ = i < mr ? *lhs.at(ir + i, p) : 0.f;
+            }
+        }
     }
-    int returnInd = _cols * row + col;
-    return _matrix[returnInd];
 }
 
-float& Matrix::operator()(const int &row, const int &col)
+/**
+ * @brief packs the kc x nc rhs block into GEMM_NR column slivers, each sliver stored row by row,
+ *        the last sliver is padded with zeros. the columns of a sliver are contiguous, the blocks
+ *        start at a multiple of GEMM_NR columns.
+ */
+template <typename Rhs>
+static void _packRhs(const Rhs& rhs, int kc, int nc, float* packed)
 {
-    if(row < 0 || col < 0 || _rows <= row || _cols <= col)
+    for(int jr = 0; jr < nc; jr += GEMM_NR)
     {
-        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
-        exit(EXIT_FAILURE);
+        int nr = std::min(GEMM_NR, nc - jr);
+        for(int p = 0; p < kc; ++p)
+        {
+            const float* rhsRow = rhs.at(p, jr);
+            for(int j = 0; j < GEMM_NR; ++j)
+            {
+                *packed++ = j < nr ? rhsRow[j] : 0.f;
+            }
+        }
     }
-    int returnInd = _cols * row + col;
-    return _matrix[returnInd];
 }
 
-bool Matrix::operator==(const Matrix &rhs) const
+/**
+ * @brief runs the micro-kernel on a tile that may be cut by the result edges, or whose rows are
+ *        not evenly spaced, through a full size scratch tile.
+ */
+template <typename Result>
+static void _edgeMicroKernel(MicroKernel kernel, int kc, const float* packedLhs,
+                             const float* packedRhs, const Result& result, int mr, int nr)
 {
-    if(_rows != rhs._rows || _cols != rhs._cols)
+    float tile[GEMM_MR * GEMM_NR] = {};
+    for(int i = 0; i < mr; ++i)
     {
-        return false;
+        std::copy(result.at(i, 0), result.at(i, 0) + nr, tile + i * GEMM_NR);
     }
-
-    int matSize = _cols * _rows;
-    for(int i = 0; i < matSize; ++i)
+    kernel(kc, packedLhs, packedRhs, tile, GEMM_NR);
+    for(int i = 0; i < mr; ++i)
     {
-        if(_matrix[i] != rhs._matrix[i])
-        {
-            return false;
-        }
+        std::copy(tile + i * GEMM_NR, tile + i * GEMM_NR + nr, result.at(i, 0));
     }
-    return true;
 }
 
-Matrix Matrix::operator/(const float &c) const
+/**
+ * @brief adds to the m x n 'result' the product of the m x k 'lhs' and the k x n 'rhs', the
+ *        operands are row major or tiled. big products are split into cache sized blocks that
+ *        are packed to contiguous slivers and multiplied by a register tiled micro-kernel, small
+ *        products use a plain i-k-j loop over the contiguous runs of the rows. isSmall is set
+ *        by the whole product, not by the block, so all the blocks of a product round the same
+ *        way (the micro-kernel may use FMA, the loop does not).
+ */
+template <typename Lhs, typename Rhs, typename Result>
+static void _gemmSerial(const Lhs& lhs, const Rhs& rhs, const Result& result, int m, int n,
+                        int k, bool isSmall)
 {
-    _isValidScalarForDivision(c); //if not will exit the program
-    Matrix newMat(_rows, _cols);
-    int matSize = _rows * _cols;
-    for(int i = 0; i < matSize; ++i)
+    if(isSmall)
     {
-        newMat[i] = _matrix[i] / c;
+        for(int i = 0; i < m; ++i)
+        {
+            for(int p = 0; p < k; ++p)
+            {
+                float lhsVal = *lhs.at(i, p);
+                for(int j = 0; j < n;)
+                {
+                    int run = std::min(n - j, std::min(rhs.runLength(j), result.runLength(j)));
+                    const float* rhsRow = rhs.at(p, j);
+                    float* resultRow = result.at(i, j);
+                    for(int col = 0; col < run; ++col)
+                    {
+                        resultRow[col] += lhsVal * rhsRow[col];
+                    }
+                    j += run;
+                }
+            }
+        }
+        return;
     }
-    return newMat;
-}
 
-Matrix& Matrix::operator/=(const float &c)
-{
-    _isValidScalarForDivision(c); //if not will exit the program
-    int matSize = _rows * _cols;
-    for(int i = 0; i < matSize; ++i)
+    static const MicroKernel kernel = _selectMicroKernel();
+    thread_local std::vector<float> packedLhs(GEMM_MC * GEMM_KC + GEMM_MR * GEMM_KC);
+    thread_local std::vector<float> packedRhs(GEMM_KC * GEMM_NC + GEMM_NR * GEMM_KC);
+
+    for(int jc = 0; jc < n; jc += GEMM_NC)
     {
-        _matrix[i] /= c;
+        int nc = std::min(GEMM_NC, n - jc);
+        for(int pc = 0; pc < k; pc += GEMM_KC)
+        {
+            int kc = std::min(GEMM_KC, k - pc);
+            _packRhs(rhs.block(pc, jc), kc, nc, packedRhs.data());
+            for(int ic = 0; ic < m; ic += GEMM_MC)
+            {
+                int mc = std::min(GEMM_MC, m - ic);
+                _packLhs(lhs.block(ic, pc), mc, kc, packedLhs.data());
+                for(int jr = 0; jr < nc; jr += GEMM_NR)
+                {
+                    int nr = std::min(GEMM_NR, nc - jr);
+                    for(int ir = 0; ir < mc; ir += GEMM_MR)
+                    {
+                        int mr = std::min(GEMM_MR, mc - ir);
+                        long ldc = result.rowStride(ic + ir, mr);
+                        if(mr == GEMM_MR && nr == GEMM_NR && ldc != 0)
+                        {
+                            kernel(kc, packedLhs.data() + ir * kc, packedRhs.data() + jr * kc,
+                                   result.at(ic + ir, jc + jr), ldc);
+                        }
+                        else
+                        {
+                            _edgeMicroKernel(kernel, kc, packedLhs.data() + ir * kc,
+                                             packedRhs.data() + jr * kc,
+                                             result.block(ic + ir, jc + jr), mr, nr);
+                        }
+                    }
+                }
+            }
+        }
     }
-    return *this;
 }
 
-istream& operator>>(istream &is, Matrix &rhs)
+/**
+ * @brief the parallel driver of _gemmSerial. the result is split into tiles of whole GEMM_MC
+ *        row blocks, each tile is computed by one task with the full depth, so every coordinate
+ *        sums its products in the same order whatever the number of threads is. when there are
+ *        too few tiles to feed the pool and the deterministic mode is off, the depth is split
+ *        too and the partial products are added up at the end, whose rounding then depends on
+ *        the number of threads. in the deterministic mode the tiles do not depend on the number
+ *        of threads either. the split depends on the dimensions only, not on the layout.
+ */
+template <typename Lhs, typename Rhs, typename Result>
+static void _gemm(const Lhs& lhs, const Rhs& rhs, const Result& result, int m, int n, int k,
+                  bool deterministic)
 {
-    if(!is.good())
+    ThreadPool& pool = ThreadPool::getInstance();
+    int numThreads = pool.getNumThreads();
+    if(numThreads == 1 || (long) m * n * k <= GEMM_PARALLEL_WORK)
     {
-        cerr << LOAD_FROM_FILE_ERROR << endl;
-        exit(EXIT_FAILURE);
+        _gemmSerial(lhs, rhs, result, m, n, k, (long) m * n * k <= GEMM_SMALL_WORK);
+        return;
     }
 
-    float curData;
-    int curInd = 0;
-    while(is >> curData)
+    //the product is above GEMM_PARALLEL_WORK, so every tile runs the micro-kernel.
+    int rowBlocks = (m + GEMM_MC - 1) / GEMM_MC;
+    int wantedTiles = deterministic ? GEMM_DETERMINISTIC_TILES :
+                      GEMM_TASKS_PER_THREAD * numThreads;
+    int maxColBlocks = std::max(1, n / GEMM_MIN_TASK_COLS);
+    int colBlocks = std::min(maxColBlocks, std::max(1, wantedTiles / rowBlocks));
+    int tileCols = ((n + colBlocks - 1) / colBlocks + GEMM_NR - 1) / GEMM_NR * GEMM_NR;
+    colBlocks = (n + tileCols - 1) / tileCols;
+    int numTiles = rowBlocks * colBlocks;
+
+    int depthBlocks = 1;
+    if(!deterministic && numTiles < numThreads)
     {
-        rhs[curInd] = curData;
-        curInd++;
+        depthBlocks = std::min(numThreads / numTiles, std::max(1, k / GEMM_KC));
     }
-    return is;
-}
 
-ostream& operator<<(ostream& os, const Matrix &rhs)
-{
-    if(!os.good())
+    if(depthBlocks == 1)
     {
-        cerr << LOAD_FROM_FILE_ERROR << endl;
-        exit(EXIT_FAILURE);
+        pool.parallelFor(numTiles, [&](int tile)
+        {
+            int row = tile / colBlocks * GEMM_MC;
+            int col = tile % colBlocks * tileCols;
+            _gemmSerial(lhs.block(row, 0), rhs.block(0, col), result.block(row, col),
+                        std::min(GEMM_MC, m - row), std::min(tileCols, n - col), k, false);
+        });
+        return;
     }
 
-    for(int row = 0; row < rhs._rows; ++row)
+    int blockDepth = (k + depthBlocks - 1) / depthBlocks;
+    std::vector<float> partials((long) (depthBlocks - 1) * m * n, 0.f);
+    pool.parallelFor(numTiles * depthBlocks, [&](int task)
     {
-        for(int col = 0; col < rhs._cols - 1; ++col)
+        int tile = task % numTiles;
+        int depthBlock = task / numTiles;
+        int row = tile / colBlocks * GEMM_MC;
+        int col = tile % colBlocks * tileCols;
+        int depth = depthBlock * blockDepth;
+        int rows = std::min(GEMM_MC, m - row);
+        int cols = std::min(tileCols, n - col);
+        int depths = std::max(0, std::min(blockDepth, k - depth));
+        if(depthBlock == 0)
         {
-            os << rhs(row, col) << " ";
+            _gemmSerial(lhs.block(row, depth), rhs.block(depth, col), result.block(row, col),
+                        rows, cols, depths, false);
+            return;
         }
-        os << rhs(row, rhs._cols - 1);
-        if(row != rhs._rows - 1)
+        RowMajorOperand<float> partial = {partials.data() + (depthBlock - 1L) * m * n, n};
+        _gemmSerial(lhs.block(row, depth), rhs.block(depth, col), partial.block(row, col), rows,
+                    cols, depths, false);
+    });
+    pool.parallelFor(m, [&](int row)
+    {
+        for(int depthBlock = 1; depthBlock < depthBlocks; ++depthBlock)
         {
-            os << endl;
+            const float* partialRow = partials.data() + (depthBlock - 1L) * m * n + (long) row * n;
+            for(int col = 0; col < n; ++col)
+            {
+                *result.at(row, col) += partialRow[col];
+            }
         }
+    });
+}
+
+// ------------------------------ errors ------------------------------
+
+void exitWithError(const char* error)
+{
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+}
+
+// ------------------------------ MatrixBase ------------------------------
+
+bool MatrixBase::_deterministic = MatrixBase::_defaultDeterministic();
+
+/**
+ * The number of buffers _allocate returned, see MatrixBase::getAllocationCount.
+ */
+static std::atomic<long> gAllocationCount(0);
+
+/**
+ * The default allocator of the calling thread, nullptr for the heap allocator.
+ */
+static thread_local MatrixAllocator* gDefaultAllocator = nullptr;
+
+bool MatrixBase::_defaultDeterministic()
+{
+    const char* envVal = std::getenv(DETERMINISTIC_ENV_VAR);
+    return envVal != nullptr && std::atoi(envVal) != 0;
+}
+
+long MatrixBase::getAllocationCount()
+{
+    return gAllocationCount;
+}
+
+void MatrixBase::resetAllocationCount()
+{
+    gAllocationCount = 0;
+}
+
+void MatrixBase::_countAllocation()
+{
+    ++gAllocationCount;
+}
+
+MatrixAllocator& MatrixBase::getDefaultAllocator()
+{
+    if(gDefaultAllocator == nullptr)
+    {
+        return HeapAllocator::getInstance();
     }
-    return os;
+    return *gDefaultAllocator;
 }
 
-void Matrix::_isValidForAddition(const Matrix &leftMat, const Matrix &rightMat)
+void MatrixBase::setDefaultAllocator(MatrixAllocator* allocator)
 {
-    if(leftMat._rows != rightMat._rows || leftMat._cols != rightMat._cols)
+    gDefaultAllocator = allocator;
+}
+
+// ------------------------------ Matrix ------------------------------
+
+template <>
+Matrix Matrix::operator*(const Matrix &rhs) const
+{
+    if(_cols != rhs._rows)
     {
         cerr << INVALID_DIMENSIONS_ERROR << endl;
         exit(EXIT_FAILURE);
     }
+
+    Matrix newMat = Matrix(_rows, rhs._cols);
+    _gemm(RowMajorOperand<const float>{_matrix, _cols},
+          RowMajorOperand<const float>{rhs._matrix, rhs._cols},
+          RowMajorOperand<float>{newMat._matrix, rhs._cols}, _rows, rhs._cols, _cols,
+          _deterministic);
+    return newMat;
+}
+
+template <>
+Matrix& Matrix::operator+=(const float &scalar)
+{
+    addScalar(_matrix, scalar, _matrix, (long) _rows * _cols);
+    return *this;
 }
 
-void Matrix::_isValidScalarForDivision(const int &c)
+// ------------------------------ TiledMatrix ------------------------------
+
+TiledMatrix TiledMatrix::operator*(const TiledMatrix& rhs) const
 {
-    if(c == 0)
+    if(_cols != rhs._rows)
     {
-        cerr << DIVISION_BY_ZERO_ERROR << endl;
+        cerr << INVALID_DIMENSIONS_ERROR << endl;
         exit(EXIT_FAILURE);
     }
-}
-
 
+    TiledMatrix result(_rows, rhs._cols);
+    _gemm(TiledOperand<const float>{_tiles.getData().data(), getTileCols(), 0, 0},
+          TiledOperand<const float>{rhs._tiles.getData().data(), rhs.getTileCols(), 0, 0},
+          TiledOperand<float>{result._tiles.getData().data(), result.getTileCols(), 0, 0},
+          _rows, rhs._cols, _cols, MatrixBase::isDeterministic());
+    return result;
+}
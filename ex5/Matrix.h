@@ -7,13 +7,19 @@
  * @version 1.0
  * @date 7 September 2020
  *
- * @brief header file of Matrix.cpp
+ * @brief header file of Matrix.cpp, BasicMatrix is a template over the element type (float,
+ *        double, int16_t, uint8_t or Half) and Matrix is the float one. the generic members are
+ *        defined at the end of this file, the float fast paths in Matrix.cpp.
  *
  */
 
 // ------------------------------ includes ------------------------------
 
 #include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
 
 // -------------------------- using definitions -------------------------
 
@@ -31,17 +37,126 @@ using std::cin;
 #define INDEX_OUT_OF_RANGE_ERROR "Index out of range."
 #define LOAD_FROM_FILE_ERROR "Error loading from input stream."
 
+/**
+ * The environment variable that turns the deterministic mode on when set to a non zero number.
+ */
+#define DETERMINISTIC_ENV_VAR "MATRIX_DETERMINISTIC"
+
+// ------------------------------ includes ------------------------------
+
+#include "Half.h"
+#include "ElementTraits.h"
+#include "MatrixExpression.h"
+#include "Span.h"
+#include "MatrixAllocator.h"
+#include "MatrixIO.h"
+
 
 // ------------------------------ functions -----------------------------
 
 /**
- * @class Matrix
- * @brief The class represents a matrix that contain float, with the API operations.
+ * @brief prints the error and exits the program, the error path of the non template sources.
+ * @param error: the error message.
+ */
+void exitWithError(const char* error);
+
+/**
+ * @class MatrixBase
+ * @brief The state all the element types share: the deterministic mode of the multiplication,
+ *        the allocation count and the default allocator.
  */
-class Matrix
+class MatrixBase
 {
 
 public:
+    /**
+     * @fn MatrixBase::setDeterministic(bool deterministic);
+     * @brief set the deterministic mode of the matrix multiplication. in this mode the product
+     *        is bit identical whatever the number of threads is, otherwise products with few
+     *        result tiles may split their depth between threads. the initial mode is read from
+     *        DETERMINISTIC_ENV_VAR, off when it is not set. the number of threads is set by
+     *        ThreadPool::setNumThreads.
+     * @param deterministic true to turn the deterministic mode on.
+     */
+    static void setDeterministic(bool deterministic) { _deterministic = deterministic; }
+
+    /**
+     * @fn MatrixBase::isDeterministic();
+     * @return true if the deterministic mode of the matrix multiplication is on.
+     */
+    static bool isDeterministic() { return _deterministic; }
+
+    /**
+     * @fn MatrixBase::getAllocationCount();
+     * @return the number of _matrix buffers allocated by all the matrices (of all the element
+     *         types) since the program started or since the last resetAllocationCount call, lets
+     *         tests check that no buffer is copied needlessly.
+     */
+    static long getAllocationCount();
+
+    /**
+     * @fn MatrixBase::resetAllocationCount();
+     * @brief set the allocation count to 0.
+     */
+    static void resetAllocationCount();
+
+    /**
+     * @fn MatrixBase::getDefaultAllocator();
+     * @return the allocator of the matrices the calling thread constructs without an explicit
+     *         allocator (and of copies and expression results), the heap allocator unless
+     *         setDefaultAllocator was called.
+     */
+    static MatrixAllocator& getDefaultAllocator();
+
+    /**
+     * @fn MatrixBase::setDefaultAllocator(MatrixAllocator* allocator);
+     * @brief set the default allocator of the calling thread, for example a PoolAllocator or a
+     *        FrameArena around a frame loop, so the code inside it needs no change.
+     * @param allocator: the new default allocator, nullptr for the heap allocator.
+     */
+    static void setDefaultAllocator(MatrixAllocator* allocator);
+
+protected:
+    /**
+     *@static the default number of rows created in the default constructor.
+     */
+    static const int DEFAULT_ROWS = 1;
+
+    /**
+     *@static the default number of column created in the default constructor.
+     */
+    static const int DEFAULT_COLS = 1;
+
+    /**
+     *@static the deterministic mode of the matrix multiplication.
+     */
+    static bool _deterministic;
+
+    /**
+     * @return the initial deterministic mode, read from DETERMINISTIC_ENV_VAR.
+     */
+    static bool _defaultDeterministic();
+
+    /**
+     * adds one to the allocation count.
+     */
+    static void _countAllocation();
+};
+
+/**
+ * @class BasicMatrix
+ * @brief The class represents a matrix that contain elements of type T, with the API
+ *        operations. the element-wise arithmetic is the one of ElementTraits<T>, the scalars
+ *        are of type Scalar (float for the integer types and Half).
+ */
+template <typename T>
+class BasicMatrix : public MatrixBase
+{
+
+public:
+    typedef T value_type;
+    typedef typename ElementTraits<T>::Scalar Scalar;
+
     /**
      * @brief The class constructor - other constructors make deligation to him, Inits a new
      * matrix with all coordinates 0, allocates _matrix member - will freed in destructor.
@@ -49,232 +164,409 @@ public:
      * @param rows: the matrix row number
      * @param cols: the matrix column number.
      */
-    Matrix(int rows, int cols);
+    BasicMatrix(int rows, int cols);
+
+    /**
+     * @brief Inits a new matrix with all coordinates 0, the _matrix member is taken from the
+     * given allocator instead of the default one, and given back to it in the destructor.
+     * if rows or cols negative it will exit the program.
+     * @param rows: the matrix row number
+     * @param cols: the matrix column number.
+     * @param allocator: the allocator of _matrix, must outlive the matrix.
+     */
+    BasicMatrix(int rows, int cols, MatrixAllocator& allocator);
 
     /**
      * @brief The class default constructor - delegate to class constructor with row = col = 1.
      */
-    Matrix() : Matrix(DEFAULT_ROWS, DEFAULT_COLS){}
+    BasicMatrix() : BasicMatrix(DEFAULT_ROWS, DEFAULT_COLS){}
 
     /**
       * @brief The class copy constructor - create new matrix with the same rows and same column
-      * of the copied matrix, allocates new _matrix member - will freed in destructor.
+      * of the copied matrix, allocates new _matrix member from the default allocator - will
+      * freed in destructor.
       * @param rhs: the matrix to copy from
       */
-    Matrix(const Matrix& rhs);
+    BasicMatrix(const BasicMatrix& rhs);
+
+    /**
+      * @brief The class move constructor - takes the _matrix of the moved matrix without copying
+      * it, the moved matrix is left as an empty 0 x 0 matrix.
+      * @param rhs: the matrix to move from
+      */
+    BasicMatrix(BasicMatrix&& rhs) noexcept;
+
+    /**
+     * @brief constructs a matrix from a lazy expression (the result of operator+, operator/ and
+     *        the scalar operator*), evaluated in one pass into the only allocation.
+     * @param expr: the expression to evaluate.
+     */
+    template <typename E>
+    BasicMatrix(const MatrixExpression<E>& expr);
 
     /**
      * @brief The class destructor - delete the _matrix (member) array.
      */
-    ~Matrix();
+    ~BasicMatrix();
 
     /**
-    *@fn Matrix::getRows()const
+    *@fn BasicMatrix::getRows()const
     *@brief return the member _rows that represent the number of rows in _matrix.
     */
     int getRows() const { return _rows; };
 
     /**
-    *@fn Matrix::getCols()const
+    *@fn BasicMatrix::getCols()const
     *@brief return the member _cols that represent the number of column in _matrix.
     */
     int getCols() const { return _cols; };
 
     /**
-    *@fn Matrix::operator=(Matrix const &rhs);
+    *@fn BasicMatrix::operator=(BasicMatrix const &rhs);
     *@brief delete _matrix and allocates new if the rhs not the same size, the copy all the
     *       coordinates
     *@param rhs: the matrix to copy from.
     *@return reference to the lhs matrix.
     */
-    Matrix& operator=(const Matrix& rhs);
+    BasicMatrix& operator=(const BasicMatrix& rhs);
+
+    /**
+    *@fn BasicMatrix::operator=(BasicMatrix&& rhs);
+    *@brief delete _matrix and take the _matrix of rhs without copying it, rhs is left as an empty
+    *       0 x 0 matrix.
+    *@param rhs: the matrix to move from.
+    *@return reference to the lhs matrix.
+    */
+    BasicMatrix& operator=(BasicMatrix&& rhs) noexcept;
 
     /**
-    *@fn Matrix::operator*(const Matrix &rhs) const;
+    *@fn BasicMatrix::swap(BasicMatrix& rhs);
+    *@brief exchange the dimensions and the _matrix of the two matrices without copying.
+    *@param rhs: the matrix to swap with.
+    */
+    void swap(BasicMatrix& rhs) noexcept;
+
+    /**
+    *@fn BasicMatrix::operator=(const MatrixExpression<E>& expr);
+    *@brief evaluates the expression into the matrix, the buffer is reused when the size does not
+    *       change. the expression may refer to this matrix.
+    *@param expr: the expression to evaluate.
+    *@return reference to the lhs matrix.
+    */
+    template <typename E>
+    BasicMatrix& operator=(const MatrixExpression<E>& expr);
+
+    /**
+    *@fn BasicMatrix::operator*(const BasicMatrix &rhs) const;
     *@brief construct new matrix from the matrix's multiplication and return it by value.
+    *       the other element types sum in ElementTraits<T>::Accumulator, for float
+    *       big products run through a cache blocked, register tiled kernel. every coordinate
+    *       sums its products in the same order as the textbook loop, so the result is identical
+    *       to it, except on cpus with FMA where each product-add is rounded once, then a
+    *       coordinate may differ from the textbook result by at most
+    *       _cols * FLT_EPSILON * sum(|lhs(i, p) * rhs(p, j)|).
     *@param rhs: the matrix to multiply the lhs with.
     *@return the new constructed matrix by value.
     */
-    Matrix operator*(const Matrix& rhs) const;
+    BasicMatrix operator*(const BasicMatrix& rhs) const;
 
     /**
-    *@fn Matrix::operator*(float c) const;
-    *@brief construct new matrix from the matrix and param c multiplication.
+    *@fn BasicMatrix::operator*(Scalar c) const;
+    *@brief the lazy multiplication of the matrix by param c.
     *@param c: the param to multiply the lhs matrix with.
-    *@return the new constructed matrix by value.
+    *@return the expression, evaluated when it is assigned to a matrix.
     */
-    Matrix operator*(const float& c) const;
+    ScaledExpression<MatrixRef<T>> operator*(const Scalar& c) const
+    {
+        return ScaledExpression<MatrixRef<T>>(MatrixRef<T>(*this), c);
+    }
 
     /**
-    *@fn operator*(float c, const Matrix &rhs);
-    *@brief construct new matrix from the matrix and param c multiplication.
+    *@fn operator*(Scalar c, const BasicMatrix &rhs);
+    *@brief the lazy multiplication of the matrix by param c.
     *@param scalarOnLeft: the param to multiply the rhs matrix with.
     *@param rhs: the rhs matrix to multiply the param c with.
-    *@return the new constructed matrix by value.
+    *@return the expression, evaluated when it is assigned to a matrix.
     */
-    friend Matrix operator*(const int& scalarOnLeft, const Matrix& rhs);
+    friend ScaledExpression<MatrixRef<T>> operator*(const Scalar& scalarOnLeft,
+                                                    const BasicMatrix& rhs)
+    {
+        return ScaledExpression<MatrixRef<T>>(MatrixRef<T>(rhs), scalarOnLeft);
+    }
 
     /**
-    *@fn operator*=(const Matrix &rhs);
+    *@fn operator*=(const BasicMatrix &rhs);
     *@brief multiply the lhs Matrix with the rhs, exit the program if the dimensions not valid.
     *@param rhs: the rhs matrix to multiply the param c with.
     *@return the lhs matrix after multiplication by reference.
     */
-    Matrix& operator*=(const Matrix& rhs);
+    BasicMatrix& operator*=(const BasicMatrix& rhs);
 
     /**
-    *@fn operator*=(const float& scalar);
+    *@fn operator*=(const Scalar& scalar);
     *@brief multiply the lhs Matrix with the rhs.
     *@param scalar: the param to multiply the lhs matrix with.
     *@return the lhs matrix after multiplication by reference.
     */
-    Matrix& operator*=(const float& scalar);
+    BasicMatrix& operator*=(const Scalar& scalar);
 
     /**
-    *@fn operator/(float c);
-    *@brief construct new matrix from the lhs Matrix and divide it by param c, exit the program if
-    *       c == 0.
-    *@param c: the param to divide new constructed matrix with.
-    *@return the new constructed matrix by value.
+    *@fn operator/(Scalar c);
+    *@brief the lazy division of the lhs Matrix by param c, exit the program if c == 0.
+    *@param c: the param to divide the matrix with.
+    *@return the expression, evaluated when it is assigned to a matrix.
     */
-    Matrix operator/(const float& c) const;
+    QuotientExpression<MatrixRef<T>> operator/(const Scalar& c) const
+    {
+        //the expression validates the scalar, if not valid will exit the program
+        return QuotientExpression<MatrixRef<T>>(MatrixRef<T>(*this), c);
+    }
 
     /**
-    *@fn operator/=(float c);
+    *@fn operator/=(Scalar c);
     *@brief divide the lhs Matrix by param c, exit the program if c == 0.
     *@param c: the param to divide the lhs matrix with.
     *@return the lhs matrix by reference.
     */
-    Matrix& operator/=(const float& c);
+    BasicMatrix& operator/=(const Scalar& c);
 
     /**
-    *@fn Matrix::operator+(const Matrix &rhs);
-    *@brief construct new matrix from the matrix's and adding it to the rhs.
-    *@param rhs: the rhs matrix to add with new constructed matrix.
-    *@return the new constructed matrix by value after adding.
+    *@fn BasicMatrix::operator+(const BasicMatrix &rhs);
+    *@brief the lazy addition of the matrix's, exit the program if the dimensions not valid.
+    *@param rhs: the rhs matrix to add.
+    *@return the expression, evaluated when it is assigned to a matrix.
     */
-    Matrix operator+(const Matrix& rhs) const;
+    SumExpression<MatrixRef<T>, MatrixRef<T>> operator+(const BasicMatrix& rhs) const
+    {
+        //the expression validates the dimensions, if not valid will exit the program
+        return SumExpression<MatrixRef<T>, MatrixRef<T>>(MatrixRef<T>(*this), MatrixRef<T>(rhs));
+    }
 
     /**
-    *@fn operator+=(const Matrix& rhs);
+    *@fn operator+=(const BasicMatrix& rhs);
     *@brief add the lhs matrix with the rhs, exit the program if the dimensions not valid.
     *@param rhs: the rhs matrix to add with lhs matrix.
     *@return the lhs matrix by reference.
     */
-    Matrix& operator+=(const Matrix& rhs);
+    BasicMatrix& operator+=(const BasicMatrix& rhs);
+
+    /**
+    *@fn operator+=(const MatrixExpression<E>& expr);
+    *@brief add the expression to the lhs matrix in one pass, exit the program if the dimensions
+    *       not valid.
+    *@param expr: the expression to add with lhs matrix.
+    *@return the lhs matrix by reference.
+    */
+    template <typename E>
+    BasicMatrix& operator+=(const MatrixExpression<E>& expr);
 
     /**
-    *@fn operator+=(const float& scalar);
+    *@fn operator+=(const Scalar& scalar);
     *@brief add the scalar to each index in the matrix, exit the program if the dimensions not
     *       valid.
     *@param scalar: the scalar to add to each index in the matrix.
     *@return the lhs matrix by reference.
     */
-    Matrix& operator+=(const float& scalar);
+    BasicMatrix& operator+=(const Scalar& scalar);
 
     /**
-    *@fn Matrix::operator()(const int& row, const int& col) const;
+    *@fn BasicMatrix::operator()(const int& row, const int& col) const;
     *@return the _matrix row col coordinate by const reference, exit the program if one of them not
     *        valid.
     */
-    const float& operator()(const int& row, const int& col) const;
+    const T& operator()(const int& row, const int& col) const;
 
     /**
-    *@fn Matrix::operator()(const int& row, const int& col);
+    *@fn BasicMatrix::operator()(const int& row, const int& col);
     *@return the _matrix row col coordinate by reference, exit the program if one of them not
     *        valid.
     */
-    float& operator()(const int& row, const int& col);
+    T& operator()(const int& row, const int& col);
 
     /**
-    *@fn Matrix::operator[](const int& ind) const;
+    *@fn BasicMatrix::operator[](const int& ind) const;
     *@return the _matrix index coordinate by const reference, exit the program if the index not
     *        valid.
     */
-    const float& operator[](const int& ind) const;
+    const T& operator[](const int& ind) const;
 
     /**
-    *@fn Matrix::operator[](const int& ind);
+    *@fn BasicMatrix::operator[](const int& ind);
     *@return the _matrix index coordinate by reference, exit the program if the index not valid.
     */
-    float& operator[](const int& ind);
+    T& operator[](const int& ind);
 
     /**
-    *@fn Matrix::operator==(const Matrix& rhs) const;
-    *@return true if lhs and rhs have the same values in each of there indexes.
+    *@fn BasicMatrix::uncheckedAt(int row, int col);
+    *@return the _matrix row col coordinate by reference without the range check of operator(),
+    *        for inner loops. checked only when MATRIX_CHECKED_ACCESS is defined.
     */
-    bool operator==(const Matrix& rhs) const;
+    T& uncheckedAt(int row, int col)
+    {
+        checkAccess(0 <= row && 0 <= col && row < _rows && col < _cols);
+        return _matrix[(long) row * _cols + col];
+    }
 
     /**
-    *@fn Matrix::operator!=(const Matrix& rhs);
-    *@return false if lhs and rhs have the same values in each of there indexes.
+    *@fn BasicMatrix::uncheckedAt(int row, int col) const;
+    *@return the _matrix row col coordinate by const reference, see the non const version.
     */
-    bool operator!=(const Matrix& rhs) const { return !(*this == rhs); }
+    const T& uncheckedAt(int row, int col) const
+    {
+        checkAccess(0 <= row && 0 <= col && row < _rows && col < _cols);
+        return _matrix[(long) row * _cols + col];
+    }
 
     /**
-    *@fn friend operator>>(istream& is, Matrix& rhs);
-    *@brief: Fills matrix elements, read the input stream fully to the rhs, exit the program if
-    *        is (the input stream) is not valid.
-    *@param is the input stream to load to rhs.
-    *@param rhs the matrix to load the is to.
-    *@return reference to lhs istream.
+    *@fn BasicMatrix::uncheckedAt(long ind);
+    *@return the _matrix index coordinate by reference without the range check of operator[],
+    *        checked only when MATRIX_CHECKED_ACCESS is defined.
     */
-    friend istream& operator>>(istream& is, Matrix& rhs);
+    T& uncheckedAt(long ind)
+    {
+        checkAccess(0 <= ind && ind < (long) _rows * _cols);
+        return _matrix[ind];
+    }
 
     /**
-    *@fn friend ostream& operator<<(ostream& os, const Matrix& rhs);
-    *@brief: write the rhs to the given os (output stream), each row in new line, each coordinate
-    *        in the row separated by space, no new line after the last row.
-    *        exit the program if the os is not valid.
-    *@param os the output stream to write the rhs to.
-    *@param rhs the matrix to write to the os.
-    *@return reference to lhs ostream.
+    *@fn BasicMatrix::uncheckedAt(long ind) const;
+    *@return the _matrix index coordinate by const reference, see the non const version.
     */
-    friend ostream& operator<<(ostream& os, const Matrix& rhs);
+    const T& uncheckedAt(long ind) const
+    {
+        checkAccess(0 <= ind && ind < (long) _rows * _cols);
+        return _matrix[ind];
+    }
 
     /**
-     * @fn Matrix::vectorize();
+    *@fn BasicMatrix::rowPtr(int row);
+    *@return pointer to the first coordinate of the row, the row coordinates are contiguous.
+    *        checked only when MATRIX_CHECKED_ACCESS is defined.
+    */
+    T* rowPtr(int row)
+    {
+        checkAccess(0 <= row && row < _rows);
+        return _matrix + (long) row * _cols;
+    }
+
+    /**
+    *@fn BasicMatrix::rowPtr(int row) const;
+    *@return const pointer to the first coordinate of the row, see the non const version.
+    */
+    const T* rowPtr(int row) const
+    {
+        checkAccess(0 <= row && row < _rows);
+        return _matrix + (long) row * _cols;
+    }
+
+    /**
+    *@fn BasicMatrix::getRow(int row);
+    *@return a view of the row, valid as long as the matrix is not resized or destroyed.
+    */
+    Span<T> getRow(int row) { return Span<T>(rowPtr(row), _cols); }
+
+    /**
+    *@fn BasicMatrix::getRow(int row) const;
+    *@return a read only view of the row, see the non const version.
+    */
+    Span<const T> getRow(int row) const { return Span<const T>(rowPtr(row), _cols); }
+
+    /**
+    *@fn BasicMatrix::getData();
+    *@return a view of all the coordinates, row after row.
+    */
+    Span<T> getData() { return Span<T>(_matrix, (long) _rows * _cols); }
+
+    /**
+    *@fn BasicMatrix::getData() const;
+    *@return a read only view of all the coordinates, row after row.
+    */
+    Span<const T> getData() const
+    {
+        return Span<const T>(_matrix, (long) _rows * _cols);
+    }
+
+    /**
+    *@fn BasicMatrix::operator==(const BasicMatrix& rhs) const;
+    *@return true if lhs and rhs have the same values in each of there indexes.
+    */
+    bool operator==(const BasicMatrix& rhs) const;
+
+    /**
+    *@fn BasicMatrix::operator!=(const BasicMatrix& rhs);
+    *@return false if lhs and rhs have the same values in each of there indexes.
+    */
+    bool operator!=(const BasicMatrix& rhs) const { return !(*this == rhs); }
+
+    /**
+     * @fn BasicMatrix::vectorize();
      * @brief change matrix to be vector - change the matrix to be 1 column matrix with the
      *        current values.
      */
-    Matrix& vectorize();
+    BasicMatrix& vectorize();
 
     /**
-     * @fn Matrix::print();
+     * @fn BasicMatrix::print();
      * prints to the standard output - each row in new line, each coordinate in the row separated
      * by space, no new line after the last row.
      */
     void print() const;
 
+    /**
+    *@fn BasicMatrix::getAllocator()const
+    *@brief return the allocator of _matrix.
+    */
+    MatrixAllocator& getAllocator() const { return *_allocator; }
+
 private:
 
+    friend class MatrixRef<T>;
+
+    template <typename U>
+    friend class MappedMatrix;
+
+    template <typename U>
+    friend istream& operator>>(istream& is, BasicMatrix<U>& rhs);
+
+    template <typename U>
+    friend ostream& operator<<(ostream& os, const BasicMatrix<U>& rhs);
+
     /**
-    *@memberof Matrix::_rows
+    *@memberof BasicMatrix::_rows
     *@brief represent the matrix number of rows.
     */
     int _rows;
 
     /**
-    *@memberof Matrix:: _cols
+    *@memberof BasicMatrix:: _cols
     *@brief represent the matrix number of column.
     */
     int _cols;
 
     /**
-    *@memberof Matrix::_matirx
-    *@brief pointer to array of float of size _rows * _cols (dynamically allocated).
+    *@memberof BasicMatrix::_matirx
+    *@brief pointer to array of T of size _rows * _cols (dynamically allocated, aligned to
+    *       SIMD_ALIGNMENT bytes).
     */
-    float* _matrix;
+    T* _matrix;
 
     /**
-     *@static the default number of rows created in the default constructor.
-     */
-    static const int DEFAULT_ROWS = 1;
+    *@memberof BasicMatrix::_allocator
+    *@brief the allocator _matrix was taken from.
+    */
+    MatrixAllocator* _allocator;
 
     /**
-     *@static the default number of column created in the default constructor.
+     * adopts data, an array of rows * cols elements taken from allocator, without copying it.
+     * the array is given back to allocator in the destructor, it is not counted as an
+     * allocation. used by MappedMatrix to build a matrix on a mapped file.
      */
-    static const int DEFAULT_COLS = 1;
+    BasicMatrix(int rows, int cols, T* data, MatrixAllocator& allocator) : _rows(rows),
+                                                                          _cols(cols),
+                                                                          _matrix(data),
+                                                                          _allocator(&allocator)
+    {
+    }
 
     /**
      * validate that both leftMat and rightMat have the same dimensions.
@@ -282,15 +574,569 @@ private:
      * @param leftMat the left Matrix in the addition.
      * @param rightMat the right Matrix in the addition.
      */
-    static void _isValidForAddition(const Matrix& leftMat, const Matrix& rightMat);
+    static void _isValidForAddition(const BasicMatrix& leftMat, const BasicMatrix& rightMat);
 
     /**
      * validate that the scalar is valid for division, means c != 0. exit the program if c not
      * valid.
      * @param c the scalar to check if valid for division with.
      */
-    static void _isValidScalarForDivision(const int& c);
+    static void _isValidScalarForDivision(const Scalar& c);
+
+    /**
+     * allocates an uninitialized array of T aligned to SIMD_ALIGNMENT bytes from _allocator.
+     * @param size the number of elements in the array.
+     * @return the allocated array, freed with _deallocate.
+     */
+    T* _allocate(long size);
+
+    /**
+     * gives an array allocated by _allocate back to _allocator.
+     * @param data the array to free, may be nullptr.
+     * @param size the number of elements in the array.
+     */
+    void _deallocate(T* data, long size);
+
+    /**
+     * writes the matrix to os, each row in new line, each coordinate in the row separated by
+     * space, no new line after the last row. streams with the default format go through the
+     * buffered writeScalars.
+     * @param os the output stream to write to.
+     */
+    void _write(ostream& os) const;
 
 };
 
+/**
+ * The float matrix, the type the rest of the code uses.
+ */
+using Matrix = BasicMatrix<float>;
+
+/**
+ * The float fast paths, defined in Matrix.cpp: the cache blocked parallel multiplication and
+ * the vectorized scalar addition.
+ */
+template <>
+Matrix Matrix::operator*(const Matrix& rhs) const;
+
+template <>
+Matrix& Matrix::operator+=(const float& scalar);
+
+/**
+*@fn operator>>(istream& is, BasicMatrix<T>& rhs);
+*@brief: Fills matrix elements, read the input stream fully to the rhs, exit the program if
+*        is (the input stream) is not valid or has more values than the matrix. the values are
+*        parsed in bulk by readScalars as Scalar and converted with ElementTraits<T>::fromScalar.
+*@param is the input stream to load to rhs.
+*@param rhs the matrix to load the is to.
+*@return reference to lhs istream.
+*/
+template <typename T>
+istream& operator>>(istream& is, BasicMatrix<T>& rhs)
+{
+    if(!is.good())
+    {
+        cerr << LOAD_FROM_FILE_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    typedef typename BasicMatrix<T>::Scalar Scalar;
+    Span<T> data = rhs.getData();
+    long numRead;
+    if(std::is_same<T, Scalar>::value)
+    {
+        numRead = readScalars(is, reinterpret_cast<Scalar*>(data.data()), data.size());
+    }
+    else
+    {
+        std::vector<Scalar> values(data.size());
+        numRead = readScalars(is, values.data(), data.size());
+        for(long i = 0; i < numRead && i < data.size(); ++i)
+        {
+            data[i] = ElementTraits<T>::fromScalar(values[i]);
+        }
+    }
+    if(numRead > data.size())
+    {
+        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+    return is;
+}
+
+/**
+*@fn operator<<(ostream& os, const BasicMatrix<T>& rhs);
+*@brief: write the rhs to the given os (output stream), each row in new line, each coordinate
+*        in the row separated by space, no new line after the last row. the values are written
+*        as Scalar, so uint8 values are written as numbers.
+*        exit the program if the os is not valid.
+*@param os the output stream to write the rhs to.
+*@param rhs the matrix to write to the os.
+*@return reference to lhs ostream.
+*/
+template <typename T>
+ostream& operator<<(ostream& os, const BasicMatrix<T>& rhs)
+{
+    if(!os.good())
+    {
+        cerr << LOAD_FROM_FILE_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    rhs._write(os);
+    return os;
+}
+
+/**
+ * @brief writes the matrix the expression evaluates to.
+ */
+template <typename E>
+ostream& operator<<(ostream& os, const MatrixExpression<E>& expr)
+{
+    return os << BasicMatrix<typename E::value_type>(expr);
+}
+
+/**
+ * @brief swap for the std algorithms and the std::swap idiom, calls lhs.swap(rhs).
+ */
+template <typename T>
+inline void swap(BasicMatrix<T>& lhs, BasicMatrix<T>& rhs) noexcept
+{
+    lhs.swap(rhs);
+}
+
+// -------------------------- expression templates ----------------------
+
+template <typename T>
+inline MatrixRef<T>::MatrixRef(const BasicMatrix<T>& mat) : _data(mat._matrix), _rows(mat._rows),
+                                                             _cols(mat._cols)
+{
+}
+
+template <typename T>
+template <typename E>
+BasicMatrix<T>::BasicMatrix(const MatrixExpression<E>& expr) : _rows(expr.self().getRows()),
+                                                               _cols(expr.self().getCols()),
+                                                               _allocator(&getDefaultAllocator())
+{
+    _matrix = _allocate((long) _rows * _cols);
+    evaluateExpression(expr.self(), _matrix);
+}
+
+template <typename T>
+template <typename E>
+BasicMatrix<T>& BasicMatrix<T>::operator=(const MatrixExpression<E>& expr)
+{
+    long matSize = (long) expr.self().getRows() * expr.self().getCols();
+    if(matSize == (long) _rows * _cols)
+    {
+        evaluateExpression(expr.self(), _matrix);
+    }
+    else
+    {
+        T* newMatrix = _allocate(matSize);
+        evaluateExpression(expr.self(), newMatrix);
+        _deallocate(_matrix, (long) _rows * _cols);
+        _matrix = newMatrix;
+    }
+    _rows = expr.self().getRows();
+    _cols = expr.self().getCols();
+    return *this;
+}
+
+template <typename T>
+template <typename E>
+BasicMatrix<T>& BasicMatrix<T>::operator+=(const MatrixExpression<E>& expr)
+{
+    *this = MatrixRef<T>(*this) + expr;
+    return *this;
+}
+
+template <typename T, typename E>
+SumExpression<MatrixRef<T>, E> operator+(const BasicMatrix<T>& lhs, const MatrixExpression<E>& rhs)
+{
+    return SumExpression<MatrixRef<T>, E>(MatrixRef<T>(lhs), rhs.self());
+}
+
+template <typename E, typename T>
+SumExpression<E, MatrixRef<T>> operator+(const MatrixExpression<E>& lhs, const BasicMatrix<T>& rhs)
+{
+    return SumExpression<E, MatrixRef<T>>(lhs.self(), MatrixRef<T>(rhs));
+}
+
+/**
+ * The matrix multiplication of expressions evaluates them first. the matrix parameters of the
+ * mixed operators take their type from the expression, so another expression converts to them.
+ */
+template <typename E>
+BasicMatrix<typename E::value_type> operator*(const MatrixExpression<E>& lhs,
+                                              const BasicMatrix<typename E::value_type>& rhs)
+{
+    return BasicMatrix<typename E::value_type>(lhs) * rhs;
+}
+
+template <typename E>
+BasicMatrix<typename E::value_type> operator*(const BasicMatrix<typename E::value_type>& lhs,
+                                              const MatrixExpression<E>& rhs)
+{
+    return lhs * BasicMatrix<typename E::value_type>(rhs);
+}
+
+template <typename L, typename R>
+BasicMatrix<typename L::value_type> operator*(const MatrixExpression<L>& lhs,
+                                              const MatrixExpression<R>& rhs)
+{
+    typedef BasicMatrix<typename L::value_type> Result;
+    return Result(lhs) * Result(rhs);
+}
+
+template <typename E>
+bool operator==(const MatrixExpression<E>& lhs, const BasicMatrix<typename E::value_type>& rhs)
+{
+    return rhs == BasicMatrix<typename E::value_type>(lhs);
+}
+
+template <typename E>
+bool operator!=(const MatrixExpression<E>& lhs, const BasicMatrix<typename E::value_type>& rhs)
+{
+    return rhs != BasicMatrix<typename E::value_type>(lhs);
+}
+
+// -------------------------- generic members ---------------------------
+
+template <typename T>
+BasicMatrix<T>::BasicMatrix(int rows, int cols) : BasicMatrix(rows, cols, getDefaultAllocator())
+{
+}
+
+template <typename T>
+BasicMatrix<T>::BasicMatrix(int rows, int cols, MatrixAllocator& allocator) : _allocator(&allocator)
+{
+    if(rows < 0 || cols < 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+    else
+    {
+        _rows = rows;
+        _cols = cols;
+        long matSize = (long) _rows * _cols;
+        _matrix = _allocate(matSize);
+        std::fill(_matrix, _matrix + matSize, T());
+    }
+}
+
+template <typename T>
+BasicMatrix<T>::BasicMatrix(const BasicMatrix& rhs): _rows(rhs._rows ), _cols(rhs._cols),
+                                                     _allocator(&getDefaultAllocator())
+{
+    long matSize = (long) _rows * _cols;
+    _matrix = _allocate(matSize);
+    std::copy(rhs._matrix, rhs._matrix + matSize, _matrix);
+}
+
+template <typename T>
+BasicMatrix<T>::BasicMatrix(BasicMatrix&& rhs) noexcept : _rows(rhs._rows), _cols(rhs._cols),
+                                                          _matrix(rhs._matrix),
+                                                          _allocator(rhs._allocator)
+{
+    rhs._rows = 0;
+    rhs._cols = 0;
+    rhs._matrix = nullptr;
+}
+
+template <typename T>
+BasicMatrix<T>::~BasicMatrix()
+{
+    _deallocate(_matrix, (long) _rows * _cols);
+    _matrix = nullptr;
+}
+
+template <typename T>
+BasicMatrix<T>& BasicMatrix<T>::vectorize()
+{
+    _rows *= _cols;
+    _cols = 1;
+    return *this;
+}
+
+template <typename T>
+void BasicMatrix<T>::print() const
+{
+    _write(cout);
+}
+
+template <typename T>
+BasicMatrix<T>& BasicMatrix<T>::operator=(const BasicMatrix& rhs)
+{
+    if(this == &rhs)
+    {
+        return *this;
+    }
+
+    long matSize = (long) rhs._rows * rhs._cols;
+    if(matSize != (long) _rows * _cols)
+    {
+        _deallocate(_matrix, (long) _rows * _cols);
+        _matrix = _allocate(matSize);
+    }
+    _rows = rhs._rows;
+    _cols = rhs._cols;
+
+    std::copy(rhs._matrix, rhs._matrix + matSize, _matrix);
+    return *this;
+}
+
+template <typename T>
+BasicMatrix<T>& BasicMatrix<T>::operator=(BasicMatrix&& rhs) noexcept
+{
+    if(this == &rhs)
+    {
+        return *this;
+    }
+
+    _deallocate(_matrix, (long) _rows * _cols);
+    _rows = rhs._rows;
+    _cols = rhs._cols;
+    _matrix = rhs._matrix;
+    _allocator = rhs._allocator;
+    rhs._rows = 0;
+    rhs._cols = 0;
+    rhs._matrix = nullptr;
+    return *this;
+}
+
+template <typename T>
+void BasicMatrix<T>::swap(BasicMatrix& rhs) noexcept
+{
+    std::swap(_rows, rhs._rows);
+    std::swap(_cols, rhs._cols);
+    std::swap(_matrix, rhs._matrix);
+    std::swap(_allocator, rhs._allocator);
+}
+
+/**
+ * The generic multiplication, an i-k-j loop that sums every result row in a row of
+ * ElementTraits<T>::Accumulator, so the integer types saturate only once per coordinate.
+ */
+template <typename T>
+BasicMatrix<T> BasicMatrix<T>::operator*(const BasicMatrix& rhs) const
+{
+    if(_cols != rhs._rows)
+    {
+        cerr << INVALID_DIMENSIONS_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    typedef typename ElementTraits<T>::Accumulator Accumulator;
+    BasicMatrix newMat = BasicMatrix(_rows, rhs._cols);
+    std::vector<Accumulator> accRow(rhs._cols);
+    for(int i = 0; i < _rows; ++i)
+    {
+        std::fill(accRow.begin(), accRow.end(), Accumulator());
+        for(int p = 0; p < _cols; ++p)
+        {
+            Accumulator lhsVal = (Accumulator) _matrix[(long) i * _cols + p];
+            const T* rhsRow = rhs._matrix + (long) p * rhs._cols;
+            for(int j = 0; j < rhs._cols; ++j)
+            {
+                accRow[j] += lhsVal * (Accumulator) rhsRow[j];
+            }
+        }
+        T* resultRow = newMat._matrix + (long) i * rhs._cols;
+        for(int j = 0; j < rhs._cols; ++j)
+        {
+            resultRow[j] = ElementTraits<T>::fromAccumulator(accRow[j]);
+        }
+    }
+    return newMat;
+}
+
+template <typename T>
+BasicMatrix<T>& BasicMatrix<T>::operator*=(const BasicMatrix& rhs)
+{
+    *this = (*this) * rhs; //validate the dimensions in ((*this) * mat) operator.
+    return *this;
+}
+
+template <typename T>
+BasicMatrix<T>& BasicMatrix<T>::operator*=(const Scalar& scalar)
+{
+    evaluateExpression((*this) * scalar, _matrix);
+    return *this;
+}
+
+template <typename T>
+BasicMatrix<T>& BasicMatrix<T>::operator+=(const BasicMatrix& rhs)
+{
+    _isValidForAddition(*this, rhs); //if not will exit the program
+
+    evaluateExpression((*this) + rhs, _matrix);
+    return *this;
+}
+
+template <typename T>
+BasicMatrix<T>& BasicMatrix<T>::operator+=(const Scalar& scalar)
+{
+    long matSize = (long) _rows * _cols;
+    for(long i = 0; i < matSize; ++i)
+    {
+        _matrix[i] = ElementTraits<T>::addScalar(_matrix[i], scalar);
+    }
+    return *this;
+}
+
+template <typename T>
+BasicMatrix<T>& BasicMatrix<T>::operator/=(const Scalar& c)
+{
+    _isValidScalarForDivision(c); //if not will exit the program
+    evaluateExpression((*this) / c, _matrix);
+    return *this;
+}
+
+template <typename T>
+const T& BasicMatrix<T>::operator[](const int &ind) const
+{
+    if(ind < 0 || ind >= _rows * _cols)
+    {
+        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+    return _matrix[ind];
+}
+
+template <typename T>
+T& BasicMatrix<T>::operator[](const int &ind)
+{
+    if(ind < 0 || ind >= _rows * _cols)
+    {
+        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+    return _matrix[ind];
+}
+
+template <typename T>
+const T& BasicMatrix<T>::operator()(const int &row, const int &col) const
+{
+    if(row < 0 || col < 0 || _rows <= row || _cols <= col)
+    {
+        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+    int returnInd = _cols * row + col;
+    return _matrix[returnInd];
+}
+
+template <typename T>
+T& BasicMatrix<T>::operator()(const int &row, const int &col)
+{
+    if(row < 0 || col < 0 || _rows <= row || _cols <= col)
+    {
+        cerr << INDEX_OUT_OF_RANGE_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+    int returnInd = _cols * row + col;
+    return _matrix[returnInd];
+}
+
+template <typename T>
+bool BasicMatrix<T>::operator==(const BasicMatrix &rhs) const
+{
+    if(_rows != rhs._rows || _cols != rhs._cols)
+    {
+        return false;
+    }
+
+    long matSize = (long) _cols * _rows;
+    for(long i = 0; i < matSize; ++i)
+    {
+        if(ElementTraits<T>::toScalar(_matrix[i]) != ElementTraits<T>::toScalar(rhs._matrix[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void BasicMatrix<T>::_write(ostream& os) const
+{
+    typedef typename ElementTraits<T>::Scalar Scalar;
+    if(hasDefaultFormat(os))
+    {
+        if(std::is_same<T, Scalar>::value)
+        {
+            writeScalars(os, reinterpret_cast<const Scalar*>(_matrix), _rows, _cols);
+            return;
+        }
+        std::vector<Scalar> rowValues(_cols);
+        for(int row = 0; row < _rows; ++row)
+        {
+            const T* rowData = rowPtr(row);
+            for(int col = 0; col < _cols; ++col)
+            {
+                rowValues[col] = ElementTraits<T>::toScalar(rowData[col]);
+            }
+            writeScalars(os, rowValues.data(), 1, _cols);
+            if(row != _rows - 1)
+            {
+                os << '\n';
+            }
+        }
+        return;
+    }
+
+    //a stream with its own format (precision, width, flags or locale) gets it for every value.
+    for(int row = 0; row < _rows; ++row)
+    {
+        Span<const T> rowView = getRow(row);
+        for(long col = 0; col < rowView.size(); ++col)
+        {
+            if(col != 0)
+            {
+                os << " ";
+            }
+            os << ElementTraits<T>::toScalar(rowView[col]);
+        }
+        if(row != _rows - 1)
+        {
+            os << endl;
+        }
+    }
+}
+
+template <typename T>
+T* BasicMatrix<T>::_allocate(long size)
+{
+    _countAllocation();
+    return static_cast<T*>(_allocator->allocate(size * (long) sizeof(T)));
+}
+
+template <typename T>
+void BasicMatrix<T>::_deallocate(T* data, long size)
+{
+    _allocator->deallocate(data, size * (long) sizeof(T));
+}
+
+template <typename T>
+void BasicMatrix<T>::_isValidForAddition(const BasicMatrix &leftMat, const BasicMatrix &rightMat)
+{
+    if(leftMat._rows != rightMat._rows || leftMat._cols != rightMat._cols)
+    {
+        cerr << INVALID_DIMENSIONS_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+template <typename T>
+void BasicMatrix<T>::_isValidScalarForDivision(const Scalar &c)
+{
+    if(c == 0)
+    {
+        cerr << DIVISION_BY_ZERO_ERROR << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
 #endif //SUMMER_EX4_MATRIX_H
@@ -0,0 +1,235 @@
+/**
+ * @file MatrixAllocator.cpp
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief The allocation policies of the Matrix storage implementation.
+ */
+
+#include <new>
+#include <algorithm>
+#include "MatrixAllocator.h"
+#include "SimdKernels.h"
+
+/**
+ * @return the given bytes rounded up to a multiple of SIMD_ALIGNMENT.
+ */
+static long _alignedBytes(long bytes)
+{
+    return (bytes + SIMD_ALIGNMENT - 1) / SIMD_ALIGNMENT * SIMD_ALIGNMENT;
+}
+
+// ------------------------------ MatrixAllocator ------------------------------
+
+MatrixAllocator::MatrixAllocator() : _requests(0), _systemAllocations(0), _systemFrees(0),
+                                     _bytesInUse(0), _peakBytesInUse(0)
+{
+}
+
+AllocationStats MatrixAllocator::getStats() const
+{
+    return {_requests, _systemAllocations, _systemFrees, _bytesInUse, _peakBytesInUse};
+}
+
+void MatrixAllocator::resetStats()
+{
+    _requests = 0;
+    _systemAllocations = 0;
+    _systemFrees = 0;
+    _peakBytesInUse = _bytesInUse.load();
+}
+
+void MatrixAllocator::_recordRequest(long bytes)
+{
+    ++_requests;
+    long inUse = _bytesInUse += bytes;
+    long peak = _peakBytesInUse;
+    while(inUse > peak && !_peakBytesInUse.compare_exchange_weak(peak, inUse))
+    {
+    }
+}
+
+void MatrixAllocator::_recordRelease(long bytes)
+{
+    _bytesInUse -= bytes;
+}
+
+void* MatrixAllocator::_systemAllocate(long bytes)
+{
+    return ::operator new(bytes, std::align_val_t(SIMD_ALIGNMENT));
+}
+
+void MatrixAllocator::_systemFree(void* data)
+{
+    ::operator delete(data, std::align_val_t(SIMD_ALIGNMENT));
+}
+
+// ------------------------------ HeapAllocator ------------------------------
+
+void* HeapAllocator::allocate(long bytes)
+{
+    if(bytes == 0)
+    {
+        return nullptr;
+    }
+    _recordRequest(bytes);
+    _recordSystemAllocation();
+    return _systemAllocate(bytes);
+}
+
+void HeapAllocator::deallocate(void* data, long bytes)
+{
+    if(data == nullptr)
+    {
+        return;
+    }
+    _recordRelease(bytes);
+    _recordSystemFree();
+    _systemFree(data);
+}
+
+HeapAllocator& HeapAllocator::getInstance()
+{
+    static HeapAllocator instance;
+    return instance;
+}
+
+// ------------------------------ PoolAllocator ------------------------------
+
+PoolAllocator::~PoolAllocator()
+{
+    trim();
+}
+
+void* PoolAllocator::allocate(long bytes)
+{
+    if(bytes == 0)
+    {
+        return nullptr;
+    }
+    bytes = _sizeClass(bytes);
+    _recordRequest(bytes);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<void*>& freeList = _freeLists[bytes];
+        if(!freeList.empty())
+        {
+            void* data = freeList.back();
+            freeList.pop_back();
+            return data;
+        }
+    }
+    _recordSystemAllocation();
+    return _systemAllocate(bytes);
+}
+
+void PoolAllocator::deallocate(void* data, long bytes)
+{
+    if(data == nullptr)
+    {
+        return;
+    }
+    bytes = _sizeClass(bytes);
+    _recordRelease(bytes);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _freeLists[bytes].push_back(data);
+}
+
+void PoolAllocator::trim()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(auto& sizeClass : _freeLists)
+    {
+        for(void* data : sizeClass.second)
+        {
+            _recordSystemFree();
+            _systemFree(data);
+        }
+    }
+    _freeLists.clear();
+}
+
+PoolAllocator& PoolAllocator::getThreadInstance()
+{
+    thread_local PoolAllocator instance;
+    return instance;
+}
+
+long PoolAllocator::_sizeClass(long bytes)
+{
+    long step = SIMD_ALIGNMENT;
+    while(step * 8 <= bytes)
+    {
+        step *= 2;
+    }
+    //bytes < 8 * step, so rounding up to a multiple of step adds less than a quarter.
+    return (bytes + step - 1) / step * step;
+}
+
+// ------------------------------ FrameArena ------------------------------
+
+FrameArena::FrameArena(long chunkBytes) : _chunkBytes(_alignedBytes(chunkBytes)), _curChunk(0),
+                                          _curOffset(0), _frameBytes(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    release();
+}
+
+void* FrameArena::allocate(long bytes)
+{
+    if(bytes == 0)
+    {
+        return nullptr;
+    }
+    bytes = _alignedBytes(bytes);
+    _recordRequest(bytes);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frameBytes += bytes;
+    while(_curChunk < _chunks.size() && _curOffset + bytes > _chunks[_curChunk].bytes)
+    {
+        ++_curChunk;
+        _curOffset = 0;
+    }
+    if(_curChunk == _chunks.size())
+    {
+        long chunkBytes = std::max(_chunkBytes, bytes);
+        _recordSystemAllocation();
+        _chunks.push_back({static_cast<char*>(_systemAllocate(chunkBytes)), chunkBytes});
+        _curOffset = 0;
+    }
+    char* data = _chunks[_curChunk].data + _curOffset;
+    _curOffset += bytes;
+    return data;
+}
+
+void FrameArena::deallocate(void* data, long bytes)
+{
+    (void) data;
+    (void) bytes;
+}
+
+void FrameArena::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _recordRelease(_frameBytes);
+    _frameBytes = 0;
+    _curChunk = 0;
+    _curOffset = 0;
+}
+
+void FrameArena::release()
+{
+    reset();
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(Chunk& chunk : _chunks)
+    {
+        _recordSystemFree();
+        _systemFree(chunk.data);
+    }
+    _chunks.clear();
+}
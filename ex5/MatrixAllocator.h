@@ -0,0 +1,280 @@
+#ifndef SUMMER_EX4_MATRIXALLOCATOR_H
+#define SUMMER_EX4_MATRIXALLOCATOR_H
+
+/**
+ * @file MatrixAllocator.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief header file of MatrixAllocator.cpp, the allocation policies of the Matrix storage.
+ *        every allocator returns arrays aligned to SIMD_ALIGNMENT bytes, and must outlive the
+ *        matrices allocated from it.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @struct AllocationStats
+ * @brief a snapshot of the counters of an allocator.
+ */
+struct AllocationStats
+{
+    /**
+     * The number of arrays the matrices asked for.
+     */
+    long requests;
+
+    /**
+     * The number of times the allocator asked the system heap for memory.
+     */
+    long systemAllocations;
+
+    /**
+     * The number of times the allocator gave memory back to the system heap.
+     */
+    long systemFrees;
+
+    /**
+     * The bytes currently handed out to matrices.
+     */
+    long bytesInUse;
+
+    /**
+     * The maximal value bytesInUse reached.
+     */
+    long peakBytesInUse;
+};
+
+/**
+ * @class MatrixAllocator
+ * @brief The allocation policy interface of the Matrix storage, keeps the counters of
+ *        AllocationStats for the deriving policies.
+ */
+class MatrixAllocator
+{
+
+public:
+    MatrixAllocator();
+
+    virtual ~MatrixAllocator() = default;
+
+    MatrixAllocator(const MatrixAllocator& rhs) = delete;
+
+    MatrixAllocator& operator=(const MatrixAllocator& rhs) = delete;
+
+    /**
+     * @brief allocates an uninitialized array aligned to SIMD_ALIGNMENT bytes, of any element
+     *        type.
+     * @param bytes the size of the array in bytes.
+     * @return the array, nullptr if bytes is 0.
+     */
+    virtual void* allocate(long bytes) = 0;
+
+    /**
+     * @brief gives back an array returned by allocate.
+     * @param data the array, may be nullptr.
+     * @param bytes the size that was passed to allocate.
+     */
+    virtual void deallocate(void* data, long bytes) = 0;
+
+    /**
+     * @return the counters of the allocator.
+     */
+    AllocationStats getStats() const;
+
+    /**
+     * @brief zero all the counters, bytesInUse and peakBytesInUse restart from the bytes that are
+     *        currently in use.
+     */
+    void resetStats();
+
+protected:
+    /**
+     * records an allocate call of the given bytes.
+     */
+    void _recordRequest(long bytes);
+
+    /**
+     * records a deallocate call of the given bytes.
+     */
+    void _recordRelease(long bytes);
+
+    /**
+     * records an allocation from the system heap.
+     */
+    void _recordSystemAllocation() { ++_systemAllocations; }
+
+    /**
+     * records a free to the system heap.
+     */
+    void _recordSystemFree() { ++_systemFrees; }
+
+    /**
+     * @return an array of the given bytes, aligned to SIMD_ALIGNMENT, from the system heap.
+     */
+    static void* _systemAllocate(long bytes);
+
+    /**
+     * frees an array returned by _systemAllocate.
+     */
+    static void _systemFree(void* data);
+
+private:
+    std::atomic<long> _requests;
+    std::atomic<long> _systemAllocations;
+    std::atomic<long> _systemFrees;
+    std::atomic<long> _bytesInUse;
+    std::atomic<long> _peakBytesInUse;
+};
+
+/**
+ * @class HeapAllocator
+ * @brief The default policy, every array comes from the system heap and goes back to it.
+ */
+class HeapAllocator : public MatrixAllocator
+{
+
+public:
+    void* allocate(long bytes) override;
+
+    void deallocate(void* data, long bytes) override;
+
+    /**
+     * @return the process wide heap allocator.
+     */
+    static HeapAllocator& getInstance();
+};
+
+/**
+ * @class PoolAllocator
+ * @brief Keeps the freed arrays in free lists keyed by size class and hands them out again, so
+ *        a loop that allocates the same sizes over and over stops touching the system heap
+ *        after its first round. the size classes are 4 per power of two, so an array wastes
+ *        at most a quarter of its size. thread safe, use getThreadInstance for a pool per thread
+ *        without contention.
+ */
+class PoolAllocator : public MatrixAllocator
+{
+
+public:
+    PoolAllocator() = default;
+
+    /**
+     * @brief gives all the cached arrays back to the system heap.
+     */
+    ~PoolAllocator() override;
+
+    void* allocate(long bytes) override;
+
+    void deallocate(void* data, long bytes) override;
+
+    /**
+     * @brief gives all the cached arrays back to the system heap.
+     */
+    void trim();
+
+    /**
+     * @return the pool of the calling thread, destroyed when the thread exits, so matrices
+     *         allocated from it must not outlive the thread.
+     */
+    static PoolAllocator& getThreadInstance();
+
+private:
+    /**
+     * @return the bytes of the size class of an array of the given bytes.
+     */
+    static long _sizeClass(long bytes);
+
+    /**
+     * guards _freeLists.
+     */
+    std::mutex _mutex;
+
+    /**
+     * the cached arrays of each size class.
+     */
+    std::unordered_map<long, std::vector<void*>> _freeLists;
+};
+
+/**
+ * @class FrameArena
+ * @brief A bump allocator for the matrices of one frame, deallocate does nothing and reset frees
+ *        all the arrays at once. the memory chunks are kept across resets, so a steady frame
+ *        loop does no system allocation after its first frame. no matrix allocated from the
+ *        arena may be used after reset.
+ */
+class FrameArena : public MatrixAllocator
+{
+
+public:
+    /**
+     * @param chunkBytes the size of the chunks the arena takes from the system heap, bigger
+     *        arrays get a chunk of their own size.
+     */
+    explicit FrameArena(long chunkBytes = DEFAULT_CHUNK_BYTES);
+
+    /**
+     * @brief gives the chunks back to the system heap.
+     */
+    ~FrameArena() override;
+
+    void* allocate(long bytes) override;
+
+    void deallocate(void* data, long bytes) override;
+
+    /**
+     * @brief frees all the arrays at once, keeps the chunks for the next frame.
+     */
+    void reset();
+
+    /**
+     * @brief frees all the arrays and gives the chunks back to the system heap.
+     */
+    void release();
+
+    /**
+     * The default chunk size, 64MB.
+     */
+    static const long DEFAULT_CHUNK_BYTES = 64L << 20;
+
+private:
+    /**
+     * @struct Chunk
+     * @brief a memory chunk of the arena.
+     */
+    struct Chunk
+    {
+        char* data;
+        long bytes;
+    };
+
+    std::mutex _mutex;
+    long _chunkBytes;
+    std::vector<Chunk> _chunks;
+
+    /**
+     * the chunk the next array is taken from.
+     */
+    size_t _curChunk;
+
+    /**
+     * the used bytes of the current chunk.
+     */
+    long _curOffset;
+
+    /**
+     * the bytes handed out since the last reset.
+     */
+    long _frameBytes;
+};
+
+#endif //SUMMER_EX4_MATRIXALLOCATOR_H
@@ -0,0 +1,344 @@
+#ifndef SUMMER_EX4_MATRIXEXPRESSION_H
+#define SUMMER_EX4_MATRIXEXPRESSION_H
+
+/**
+ * @file MatrixExpression.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief the lazy element-wise expressions of Matrix. operator+, operator/ and the scalar
+ *        operator* return an expression instead of a Matrix, a chain like a + b + c * 2.f is
+ *        evaluated in one pass into one allocation when it is assigned to a Matrix.
+ *        every expression has the value_type of its matrices and computes with their
+ *        ElementTraits, so an expression gives the same values as the eager operations.
+ *        the expressions keep pointers to the data of their matrices, so an expression must not
+ *        outlive them (do not keep one in an 'auto' variable past its matrices).
+ *        included by Matrix.h, not meant to be included directly.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <iostream>
+#include <cstdlib>
+#include <type_traits>
+#include "SimdKernels.h"
+#include "ElementTraits.h"
+
+template <typename T>
+class BasicMatrix;
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @class MatrixExpression
+ * @brief The base of all the expressions, E is the deriving expression that defines
+ *        value_type, Scalar, getRows(), getCols() and evaluate(ind), the value of the
+ *        expression in the given index of the row major data.
+ */
+template <typename E>
+class MatrixExpression
+{
+
+public:
+    /**
+     * @return the deriving expression.
+     */
+    const E& self() const { return static_cast<const E&>(*this); }
+
+    /**
+    *@fn MatrixExpression::operator[](const int& ind) const;
+    *@return the value of the expression in the given index, exit the program if the index not
+    *        valid.
+    */
+    auto operator[](const int& ind) const
+    {
+        if(ind < 0 || ind >= self().getRows() * self().getCols())
+        {
+            std::cerr << INDEX_OUT_OF_RANGE_ERROR << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        return self().evaluate(ind);
+    }
+
+    /**
+    *@fn MatrixExpression::operator()(const int& row, const int& col) const;
+    *@return the value of the expression in the given coordinate, exit the program if one of them
+    *        not valid.
+    */
+    auto operator()(const int& row, const int& col) const
+    {
+        if(row < 0 || col < 0 || self().getRows() <= row || self().getCols() <= col)
+        {
+            std::cerr << INDEX_OUT_OF_RANGE_ERROR << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        return self().evaluate((long) row * self().getCols() + col);
+    }
+};
+
+/**
+ * @class MatrixRef
+ * @brief A leaf of the expressions, refers to the data of a BasicMatrix<T>.
+ */
+template <typename T>
+class MatrixRef : public MatrixExpression<MatrixRef<T>>
+{
+
+public:
+    typedef T value_type;
+    typedef typename ElementTraits<T>::Scalar Scalar;
+
+    /**
+     * @brief refers to the data of the given matrix, defined in Matrix.h.
+     */
+    explicit MatrixRef(const BasicMatrix<T>& mat);
+
+    int getRows() const { return _rows; }
+
+    int getCols() const { return _cols; }
+
+    T evaluate(long ind) const { return _data[ind]; }
+
+    /**
+     * @return the data of the matrix.
+     */
+    const T* getData() const { return _data; }
+
+private:
+    const T* _data;
+    int _rows;
+    int _cols;
+};
+
+/**
+ * @class SumExpression
+ * @brief The element-wise sum of two expressions.
+ */
+template <typename L, typename R>
+class SumExpression : public MatrixExpression<SumExpression<L, R>>
+{
+
+public:
+    typedef typename L::value_type value_type;
+    typedef typename L::Scalar Scalar;
+
+    static_assert(std::is_same<value_type, typename R::value_type>::value,
+                  "the summed expressions must have the same element type");
+
+    /**
+     * @brief exit the program if the expressions dimensions are not the same.
+     */
+    SumExpression(const L& lhs, const R& rhs) : _lhs(lhs), _rhs(rhs)
+    {
+        if(lhs.getRows() != rhs.getRows() || lhs.getCols() != rhs.getCols())
+        {
+            std::cerr << INVALID_DIMENSIONS_ERROR << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int getRows() const { return _lhs.getRows(); }
+
+    int getCols() const { return _lhs.getCols(); }
+
+    value_type evaluate(long ind) const
+    {
+        return ElementTraits<value_type>::add(_lhs.evaluate(ind), _rhs.evaluate(ind));
+    }
+
+    const L& getLhs() const { return _lhs; }
+
+    const R& getRhs() const { return _rhs; }
+
+private:
+    L _lhs;
+    R _rhs;
+};
+
+/**
+ * @class ScaledExpression
+ * @brief An expression multiplied by a scalar.
+ */
+template <typename E>
+class ScaledExpression : public MatrixExpression<ScaledExpression<E>>
+{
+
+public:
+    typedef typename E::value_type value_type;
+    typedef typename E::Scalar Scalar;
+
+    ScaledExpression(const E& expr, Scalar scalar) : _expr(expr), _scalar(scalar) {}
+
+    int getRows() const { return _expr.getRows(); }
+
+    int getCols() const { return _expr.getCols(); }
+
+    value_type evaluate(long ind) const
+    {
+        return ElementTraits<value_type>::multiply(_expr.evaluate(ind), _scalar);
+    }
+
+    const E& getExpression() const { return _expr; }
+
+    Scalar getScalar() const { return _scalar; }
+
+private:
+    E _expr;
+    Scalar _scalar;
+};
+
+/**
+ * @class QuotientExpression
+ * @brief An expression divided by a scalar.
+ */
+template <typename E>
+class QuotientExpression : public MatrixExpression<QuotientExpression<E>>
+{
+
+public:
+    typedef typename E::value_type value_type;
+    typedef typename E::Scalar Scalar;
+
+    /**
+     * @brief exit the program if the scalar is 0.
+     */
+    QuotientExpression(const E& expr, Scalar scalar) : _expr(expr), _scalar(scalar)
+    {
+        if(scalar == 0)
+        {
+            std::cerr << DIVISION_BY_ZERO_ERROR << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int getRows() const { return _expr.getRows(); }
+
+    int getCols() const { return _expr.getCols(); }
+
+    value_type evaluate(long ind) const
+    {
+        return ElementTraits<value_type>::divide(_expr.evaluate(ind), _scalar);
+    }
+
+    const E& getExpression() const { return _expr; }
+
+    Scalar getScalar() const { return _scalar; }
+
+private:
+    E _expr;
+    Scalar _scalar;
+};
+
+// ------------------------------ operators -----------------------------
+
+template <typename L, typename R>
+SumExpression<L, R> operator+(const MatrixExpression<L>& lhs, const MatrixExpression<R>& rhs)
+{
+    return SumExpression<L, R>(lhs.self(), rhs.self());
+}
+
+template <typename E>
+ScaledExpression<E> operator*(const MatrixExpression<E>& expr, const typename E::Scalar& c)
+{
+    return ScaledExpression<E>(expr.self(), c);
+}
+
+template <typename E>
+ScaledExpression<E> operator*(const typename E::Scalar& c, const MatrixExpression<E>& expr)
+{
+    return ScaledExpression<E>(expr.self(), c);
+}
+
+template <typename E>
+QuotientExpression<E> operator/(const MatrixExpression<E>& expr, const typename E::Scalar& c)
+{
+    return QuotientExpression<E>(expr.self(), c);
+}
+
+// ------------------------------ evaluation -----------------------------
+
+/**
+ * @brief writes the values of the expression to result in one pass, result may be the data of
+ *        one of the expression matrices since every index is read before it is written.
+ * @param expr the expression to evaluate.
+ * @param result the array to write to, of the expression size.
+ */
+template <typename E>
+void evaluateExpression(const E& expr, typename E::value_type* result)
+{
+    long size = (long) expr.getRows() * expr.getCols();
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = expr.evaluate(i);
+    }
+}
+
+/**
+ * @brief the sum of two matrices, through the vectorized kernel.
+ */
+inline void evaluateExpression(const SumExpression<MatrixRef<float>, MatrixRef<float>>& expr,
+                               float* result)
+{
+    addArrays(expr.getLhs().getData(), expr.getRhs().getData(), result,
+              (long) expr.getRows() * expr.getCols());
+}
+
+/**
+ * @brief a matrix multiplied by a scalar, through the vectorized kernel.
+ */
+inline void evaluateExpression(const ScaledExpression<MatrixRef<float>>& expr, float* result)
+{
+    multiplyScalar(expr.getExpression().getData(), expr.getScalar(), result,
+                   (long) expr.getRows() * expr.getCols());
+}
+
+/**
+ * @brief a matrix divided by a scalar, through the vectorized kernel.
+ */
+inline void evaluateExpression(const QuotientExpression<MatrixRef<float>>& expr, float* result)
+{
+    divideScalar(expr.getExpression().getData(), expr.getScalar(), result,
+                 (long) expr.getRows() * expr.getCols());
+}
+
+/**
+ * @brief the saturating sum of two uint8 matrices, through the vectorized kernel.
+ */
+inline void evaluateExpression(const SumExpression<MatrixRef<uint8_t>, MatrixRef<uint8_t>>& expr,
+                               uint8_t* result)
+{
+    addArrays(expr.getLhs().getData(), expr.getRhs().getData(), result,
+              (long) expr.getRows() * expr.getCols());
+}
+
+/**
+ * @brief the saturating sum of two int16 matrices, through the vectorized kernel.
+ */
+inline void evaluateExpression(const SumExpression<MatrixRef<int16_t>, MatrixRef<int16_t>>& expr,
+                               int16_t* result)
+{
+    addArrays(expr.getLhs().getData(), expr.getRhs().getData(), result,
+              (long) expr.getRows() * expr.getCols());
+}
+
+/**
+ * @brief a uint8 matrix multiplied by a scalar, through the vectorized kernel.
+ */
+inline void evaluateExpression(const ScaledExpression<MatrixRef<uint8_t>>& expr, uint8_t* result)
+{
+    multiplyScalar(expr.getExpression().getData(), expr.getScalar(), result,
+                   (long) expr.getRows() * expr.getCols());
+}
+
+/**
+ * @brief an int16 matrix multiplied by a scalar, through the vectorized kernel.
+ */
+inline void evaluateExpression(const ScaledExpression<MatrixRef<int16_t>>& expr, int16_t* result)
+{
+    multiplyScalar(expr.getExpression().getData(), expr.getScalar(), result,
+                   (long) expr.getRows() * expr.getCols());
+}
+
+#endif //SUMMER_EX4_MATRIXEXPRESSION_H
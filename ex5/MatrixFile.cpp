@@ -0,0 +1,245 @@
+/**
+ * @file MatrixFile.cpp
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief The binary on disk format of Matrix implementation.
+ */
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MatrixFile.h"
+#include "SimdKernels.h"
+
+// -------------------------- const definitions -------------------------
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// ------------------------------ BinaryChecksum ------------------------------
+
+BinaryChecksum::BinaryChecksum() : _hash(FNV_OFFSET_BASIS), _tail{}, _tailBytes(0)
+{
+}
+
+void BinaryChecksum::update(const void* data, long bytes)
+{
+    const unsigned char* bytesPtr = static_cast<const unsigned char*>(data);
+    long ind = 0;
+    //complete the word the previous update left.
+    while(_tailBytes != 0 && ind < bytes)
+    {
+        _tail[_tailBytes++] = bytesPtr[ind++];
+        if(_tailBytes == 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, _tail, sizeof(word));
+            _hash = (_hash ^ word) * FNV_PRIME;
+            _tailBytes = 0;
+        }
+    }
+    for(; ind + 8 <= bytes; ind += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytesPtr + ind, sizeof(word));
+        _hash = (_hash ^ word) * FNV_PRIME;
+    }
+    for(; ind < bytes; ++ind)
+    {
+        _tail[_tailBytes++] = bytesPtr[ind];
+    }
+}
+
+uint64_t BinaryChecksum::getValue() const
+{
+    if(_tailBytes == 0)
+    {
+        return _hash;
+    }
+    uint64_t word = 0;
+    std::memcpy(&word, _tail, _tailBytes);
+    return (_hash ^ word) * FNV_PRIME;
+}
+
+uint64_t binaryChecksum(const void* data, long bytes)
+{
+    BinaryChecksum checksum;
+    checksum.update(data, bytes);
+    return checksum.getValue();
+}
+
+// ------------------------------ BinaryFileWriter ------------------------------
+
+BinaryFileWriter::BinaryFileWriter(const std::string& path, uint32_t elementType,
+                                   uint32_t elementSize, int rows, int cols) :
+        _file(path, std::ios::binary | std::ios::trunc), _rowsWritten(0)
+{
+    if(rows < 0 || cols < 0)
+    {
+        exitWithError(INVALID_DIMENSIONS_ERROR);
+    }
+    std::memset(&_header, 0, sizeof(_header));
+    std::memcpy(_header.magic, BINARY_MATRIX_MAGIC, sizeof(BINARY_MATRIX_MAGIC));
+    _header.version = BINARY_MATRIX_VERSION;
+    _header.elementType = elementType;
+    _header.elementSize = elementSize;
+    _header.alignment = SIMD_ALIGNMENT;
+    _header.rows = rows;
+    _header.cols = cols;
+    _header.dataOffset = (sizeof(_header) + SIMD_ALIGNMENT - 1) / SIMD_ALIGNMENT * SIMD_ALIGNMENT;
+    _header.dataBytes = (uint64_t) rows * cols * elementSize;
+
+    //the header is written again with the checksum by close.
+    std::vector<char> padding(_header.dataOffset - sizeof(_header), 0);
+    _file.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+    _file.write(padding.data(), (std::streamsize) padding.size());
+    if(!_file)
+    {
+        exitWithError(SAVE_TO_FILE_ERROR);
+    }
+}
+
+void BinaryFileWriter::writeRows(const void* data, int numRows)
+{
+    if(numRows < 0 || numRows > _header.rows - _rowsWritten)
+    {
+        exitWithError(INDEX_OUT_OF_RANGE_ERROR);
+    }
+    long bytes = (long) numRows * _header.cols * _header.elementSize;
+    _checksum.update(data, bytes);
+    _file.write(static_cast<const char*>(data), (std::streamsize) bytes);
+    _rowsWritten += numRows;
+    if(!_file)
+    {
+        exitWithError(SAVE_TO_FILE_ERROR);
+    }
+}
+
+void BinaryFileWriter::close()
+{
+    if(_rowsWritten != _header.rows)
+    {
+        exitWithError(INVALID_DIMENSIONS_ERROR);
+    }
+    _header.checksum = _checksum.getValue();
+    _file.seekp(0);
+    _file.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+    _file.close();
+    if(!_file)
+    {
+        exitWithError(SAVE_TO_FILE_ERROR);
+    }
+}
+
+// ------------------------------ MappedFile ------------------------------
+
+/**
+ * @return true if the header describes a matrix of the given element type that fits in a file
+ *         of fileBytes bytes.
+ */
+static bool _isValidHeader(const BinaryMatrixHeader& header, long fileBytes,
+                           uint32_t elementType, uint32_t elementSize)
+{
+    if(std::memcmp(header.magic, BINARY_MATRIX_MAGIC, sizeof(BINARY_MATRIX_MAGIC)) != 0 ||
+       header.version != BINARY_MATRIX_VERSION || header.elementType != elementType ||
+       header.elementSize != elementSize || header.rows < 0 || header.cols < 0)
+    {
+        return false;
+    }
+    //the mapping starts at a page, so an aligned offset gives aligned coordinates.
+    uint32_t alignment = header.alignment;
+    if(alignment < elementSize || (alignment & (alignment - 1)) != 0 ||
+       header.dataOffset % alignment != 0 || header.dataOffset < sizeof(header))
+    {
+        return false;
+    }
+    //the sizes are checked without overflow, a wrapped sum or product would pass a small file.
+    uint64_t numCoordinates = (uint64_t) header.rows * header.cols;
+    if(numCoordinates > UINT64_MAX / elementSize)
+    {
+        return false;
+    }
+    return header.dataBytes == numCoordinates * elementSize &&
+           header.dataOffset <= (uint64_t) fileBytes &&
+           header.dataBytes <= (uint64_t) fileBytes - header.dataOffset;
+}
+
+MappedFile::MappedFile(const std::string& path, uint32_t elementType, uint32_t elementSize,
+                       bool verify) :
+        _mapping(nullptr), _mappingBytes(0), _header(nullptr)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if(fd < 0 || fstat(fd, &fileStat) != 0)
+    {
+        if(fd >= 0)
+        {
+            close(fd);
+        }
+        exitWithError(LOAD_FROM_FILE_ERROR);
+    }
+    _mappingBytes = (long) fileStat.st_size;
+    if(_mappingBytes < (long) sizeof(BinaryMatrixHeader))
+    {
+        close(fd);
+        exitWithError(INVALID_BINARY_FILE_ERROR);
+    }
+    _mapping = mmap(nullptr, _mappingBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //the mapping keeps the file.
+    if(_mapping == MAP_FAILED)
+    {
+        _mapping = nullptr;
+        exitWithError(LOAD_FROM_FILE_ERROR);
+    }
+    _header = static_cast<const BinaryMatrixHeader*>(_mapping);
+    if(!_isValidHeader(*_header, _mappingBytes, elementType, elementSize))
+    {
+        exitWithError(INVALID_BINARY_FILE_ERROR);
+    }
+    if(verify && !verifyChecksum())
+    {
+        exitWithError(CHECKSUM_ERROR);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if(_mapping != nullptr)
+    {
+        munmap(_mapping, _mappingBytes);
+    }
+}
+
+void* MappedFile::allocate(long bytes)
+{
+    return HeapAllocator::getInstance().allocate(bytes);
+}
+
+void MappedFile::deallocate(void* data, long bytes)
+{
+    if(data == getData())
+    {
+        return;
+    }
+    HeapAllocator::getInstance().deallocate(data, bytes);
+}
+
+const void* MappedFile::getData() const
+{
+    if(_header->dataBytes == 0)
+    {
+        return nullptr;
+    }
+    return static_cast<const char*>(_mapping) + _header->dataOffset;
+}
+
+bool MappedFile::verifyChecksum() const
+{
+    return binaryChecksum(getData(), (long) _header->dataBytes) == _header->checksum;
+}
@@ -0,0 +1,357 @@
+#ifndef SUMMER_EX4_MATRIXFILE_H
+#define SUMMER_EX4_MATRIXFILE_H
+
+/**
+ * @file MatrixFile.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief header file of MatrixFile.cpp, the binary on disk format of Matrix and its memory
+ *        mapped loader. a file is a 64 bytes BinaryMatrixHeader followed by the raw row major
+ *        coordinates, so loading it is a mapping of the file, without parsing or copying.
+ *        the numbers are stored in the byte order of the machine (little endian on x86).
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "Matrix.h"
+
+// -------------------------- const definitions -------------------------
+
+#define SAVE_TO_FILE_ERROR "Error saving to file."
+#define INVALID_BINARY_FILE_ERROR "Invalid binary matrix file."
+#define CHECKSUM_ERROR "Binary matrix file checksum mismatch."
+
+/**
+ * The first bytes of every binary matrix file.
+ */
+#define BINARY_MATRIX_MAGIC "MATRIXB"
+
+/**
+ * The version of the format the writer writes and the loader accepts.
+ */
+const uint32_t BINARY_MATRIX_VERSION = 1;
+
+/**
+ * @enum BinaryElementType
+ * @brief the element type codes of the header.
+ */
+enum BinaryElementType
+{
+    BINARY_FLOAT32 = 1,
+    BINARY_FLOAT64 = 2,
+    BINARY_INT16 = 3,
+    BINARY_UINT8 = 4,
+    BINARY_FLOAT16 = 5
+};
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @struct BinaryMatrixHeader
+ * @brief The header at the start of a binary matrix file.
+ */
+struct BinaryMatrixHeader
+{
+    /**
+     * BINARY_MATRIX_MAGIC, 0 terminated.
+     */
+    char magic[8];
+
+    /**
+     * BINARY_MATRIX_VERSION.
+     */
+    uint32_t version;
+
+    /**
+     * The BinaryElementType of the coordinates.
+     */
+    uint32_t elementType;
+
+    /**
+     * The size of a coordinate in bytes.
+     */
+    uint32_t elementSize;
+
+    /**
+     * The alignment of dataOffset in bytes, a power of two, SIMD_ALIGNMENT by the writer.
+     */
+    uint32_t alignment;
+
+    int32_t rows;
+
+    int32_t cols;
+
+    /**
+     * The position of the first coordinate in the file.
+     */
+    uint64_t dataOffset;
+
+    /**
+     * The size of the coordinates in bytes, rows * cols * elementSize.
+     */
+    uint64_t dataBytes;
+
+    /**
+     * The binaryChecksum of the coordinates.
+     */
+    uint64_t checksum;
+
+    /**
+     * Zeros, for the next versions.
+     */
+    uint8_t reserved[8];
+};
+
+static_assert(sizeof(BinaryMatrixHeader) == 64, "the header is 64 bytes on every compiler");
+
+/**
+ * @struct BinaryElementTraits
+ * @brief the BinaryElementType code of each Matrix element type.
+ */
+template <typename T>
+struct BinaryElementTraits;
+
+template <>
+struct BinaryElementTraits<float>
+{
+    static const uint32_t TYPE = BINARY_FLOAT32;
+};
+
+template <>
+struct BinaryElementTraits<double>
+{
+    static const uint32_t TYPE = BINARY_FLOAT64;
+};
+
+template <>
+struct BinaryElementTraits<int16_t>
+{
+    static const uint32_t TYPE = BINARY_INT16;
+};
+
+template <>
+struct BinaryElementTraits<uint8_t>
+{
+    static const uint32_t TYPE = BINARY_UINT8;
+};
+
+template <>
+struct BinaryElementTraits<Half>
+{
+    static const uint32_t TYPE = BINARY_FLOAT16;
+};
+
+/**
+ * @class BinaryChecksum
+ * @brief The checksum the header stores, FNV-1a over the bytes taken 8 at a time (the last word
+ *        is padded with zeros), so it runs at memory speed. the bytes may be given in pieces of
+ *        any size.
+ */
+class BinaryChecksum
+{
+
+public:
+    BinaryChecksum();
+
+    /**
+     * @brief adds the given bytes after the bytes added so far.
+     */
+    void update(const void* data, long bytes);
+
+    /**
+     * @return the checksum of all the bytes added so far.
+     */
+    uint64_t getValue() const;
+
+private:
+    uint64_t _hash;
+
+    /**
+     * the bytes of the last, incomplete, word.
+     */
+    unsigned char _tail[8];
+
+    int _tailBytes;
+};
+
+/**
+ * @return the BinaryChecksum of the given bytes.
+ */
+uint64_t binaryChecksum(const void* data, long bytes);
+
+/**
+ * @class BinaryFileWriter
+ * @brief Writes a binary matrix file a band of rows at a time, so a matrix bigger than the
+ *        memory can be written as it is computed. the header is completed by close.
+ */
+class BinaryFileWriter
+{
+
+public:
+    /**
+     * @brief creates the file at path, replacing it if it exists, for a rows x cols matrix of
+     *        the given element type. exit the program if the file can not be created.
+     */
+    BinaryFileWriter(const std::string& path, uint32_t elementType, uint32_t elementSize,
+                     int rows, int cols);
+
+    BinaryFileWriter(const BinaryFileWriter& rhs) = delete;
+
+    BinaryFileWriter& operator=(const BinaryFileWriter& rhs) = delete;
+
+    /**
+     * @brief appends numRows rows after the rows written so far, exit the program if they are
+     *        more rows than the matrix has or the file can not be written.
+     * @param data the numRows * cols coordinates, row after row.
+     * @param numRows the number of rows.
+     */
+    void writeRows(const void* data, int numRows);
+
+    /**
+     * @brief writes the checksum to the header and closes the file, exit the program if not all
+     *        the rows were written or the file can not be written.
+     */
+    void close();
+
+private:
+    std::ofstream _file;
+    BinaryMatrixHeader _header;
+    BinaryChecksum _checksum;
+    int _rowsWritten;
+};
+
+/**
+ * @fn saveBinary(const std::string& path, const BasicMatrix<T>& mat);
+ * @brief writes the matrix to path in the binary format, replacing the file if it exists. exit
+ *        the program if the file can not be written.
+ * @param path the path of the file.
+ * @param mat the matrix to write.
+ */
+template <typename T>
+void saveBinary(const std::string& path, const BasicMatrix<T>& mat)
+{
+    BinaryFileWriter writer(path, BinaryElementTraits<T>::TYPE, sizeof(T), mat.getRows(),
+                            mat.getCols());
+    writer.writeRows(mat.getData().data(), mat.getRows());
+    writer.close();
+}
+
+/**
+ * @class MappedFile
+ * @brief A read only memory mapping of a whole binary matrix file. it is the allocator of the
+ *        matrix MappedMatrix builds on the mapped coordinates, the mapping is released in the
+ *        destructor and not by the matrix.
+ */
+class MappedFile : public MatrixAllocator
+{
+
+public:
+    /**
+     * @brief maps the file at path and validates its header against the expected element type,
+     *        exit the program if the file can not be opened or is not a valid binary matrix
+     *        file of that type. nothing but the header is read, unless verify is true.
+     * @param path the path of the file.
+     * @param elementType the expected BinaryElementType.
+     * @param elementSize the expected size of a coordinate.
+     * @param verify true to also compare the checksum, exit the program if it does not match.
+     */
+    MappedFile(const std::string& path, uint32_t elementType, uint32_t elementSize, bool verify);
+
+    /**
+     * @brief unmaps the file.
+     */
+    ~MappedFile() override;
+
+    /**
+     * @brief a mapped matrix never grows, but a matrix built on the mapping may still ask for an
+     *        array, it comes from the heap.
+     */
+    void* allocate(long bytes) override;
+
+    /**
+     * @brief gives the arrays of allocate back to the heap, the mapped coordinates stay mapped
+     *        until the destructor.
+     */
+    void deallocate(void* data, long bytes) override;
+
+    /**
+     * @return the header of the file.
+     */
+    const BinaryMatrixHeader& getHeader() const { return *_header; }
+
+    /**
+     * @return the mapped coordinates, nullptr for an empty matrix.
+     */
+    const void* getData() const;
+
+    /**
+     * @return true if the checksum of the header matches the coordinates, reads the whole file.
+     */
+    bool verifyChecksum() const;
+
+private:
+    void* _mapping;
+    long _mappingBytes;
+    const BinaryMatrixHeader* _header;
+};
+
+/**
+ * @class MappedMatrix
+ * @brief A read only matrix view of a binary matrix file of T, the coordinates are the pages of
+ *        the mapped file, read from the disk by the os when they are first touched. opening a
+ *        file of any size costs the same. the view is valid as long as the MappedMatrix lives,
+ *        a copy of it (Matrix copy(mapped.getMatrix())) is an ordinary matrix. not copyable nor
+ *        movable, the matrix refers to the mapping.
+ */
+template <typename T>
+class MappedMatrix
+{
+
+public:
+    /**
+     * @brief maps the file at path, exit the program if it can not be opened or is not a valid
+     *        binary matrix file of T.
+     * @param path the path of the file.
+     * @param verify true to also compare the checksum (which reads the whole file), exit the
+     *        program if it does not match.
+     */
+    explicit MappedMatrix(const std::string& path, bool verify = false);
+
+    MappedMatrix(const MappedMatrix& rhs) = delete;
+
+    MappedMatrix& operator=(const MappedMatrix& rhs) = delete;
+
+    /**
+     * @return the read only matrix of the file.
+     */
+    const BasicMatrix<T>& getMatrix() const { return _matrix; }
+
+    /**
+     * @return true if the checksum of the header matches the coordinates, reads the whole file.
+     */
+    bool verifyChecksum() const { return _file.verifyChecksum(); }
+
+private:
+    /**
+     * the mapping, declared before _matrix so it is unmapped after the matrix is destroyed.
+     */
+    MappedFile _file;
+
+    BasicMatrix<T> _matrix;
+};
+
+template <typename T>
+MappedMatrix<T>::MappedMatrix(const std::string& path, bool verify) :
+        _file(path, BinaryElementTraits<T>::TYPE, sizeof(T), verify),
+        _matrix(_file.getHeader().rows, _file.getHeader().cols,
+                static_cast<T*>(const_cast<void*>(_file.getData())), _file)
+{
+}
+
+#endif //SUMMER_EX4_MATRIXFILE_H
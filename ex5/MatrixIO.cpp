@@ -0,0 +1,296 @@
+/**
+ * @file MatrixIO.cpp
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief The bulk text codecs of Matrix implementation.
+ */
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <locale>
+#include <string>
+#include <vector>
+#include "MatrixIO.h"
+
+// -------------------------- const definitions -------------------------
+
+/**
+ * The bytes the reader asks the stream buffer for at once.
+ */
+static const long READ_CHUNK_BYTES = 1L << 20;
+
+/**
+ * The bytes the writer formats before it writes them to the stream at once.
+ */
+static const long WRITE_CHUNK_BYTES = 1L << 16;
+
+/**
+ * The longest text of a value in the default format, like "-1.17549e-38" with room to spare.
+ */
+static const int MAX_VALUE_CHARS = 32;
+
+/**
+ * The precision of the default stream format.
+ */
+static const int DEFAULT_PRECISION = 6;
+
+// ------------------------------ reader ------------------------------
+
+/**
+ * @return true for the characters the default locale treats as whitespace.
+ */
+static inline bool _isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * @return true for a decimal digit.
+ */
+static inline bool _isDigit(char c)
+{
+    return '0' <= c && c <= '9';
+}
+
+/**
+ * @brief converts a token out of the range of Scalar the way operator>> does: an underflow
+ *        gives the nearest subnormal or 0, an overflow fails.
+ * @return false if the value is too big.
+ */
+static bool _convertOutOfRange(const char* begin, const char* end, float& value)
+{
+    std::string token(begin, end);
+    value = std::strtof(token.c_str(), nullptr);
+    return value != HUGE_VALF && value != -HUGE_VALF;
+}
+
+static bool _convertOutOfRange(const char* begin, const char* end, double& value)
+{
+    std::string token(begin, end);
+    value = std::strtod(token.c_str(), nullptr);
+    return value != HUGE_VAL && value != -HUGE_VAL;
+}
+
+/**
+ * @brief parses the number that starts at cur like operator>> does: it takes the longest prefix
+ *        of the form [sign] digits [. digits] [e [sign] digits] (the exponent only after a
+ *        mantissa digit), and fails if that prefix is not a whole number.
+ * @param cur the first character of the token, moved past the characters operator>> consumes,
+ *        also when it fails.
+ * @param end the end of the buffer, a whitespace or the end of the input follows the token.
+ * @param value the parsed value.
+ * @return false if operator>> rejects the token.
+ */
+template <typename Scalar>
+static bool _parseScalar(const char*& cur, const char* end, Scalar& value)
+{
+    const char* begin = cur;
+    const char* scan = begin;
+    if(scan != end && (*scan == '+' || *scan == '-'))
+    {
+        ++scan;
+    }
+    bool foundMantissa = false;
+    while(scan != end && _isDigit(*scan))
+    {
+        ++scan;
+        foundMantissa = true;
+    }
+    if(scan != end && *scan == '.')
+    {
+        ++scan;
+        while(scan != end && _isDigit(*scan))
+        {
+            ++scan;
+            foundMantissa = true;
+        }
+    }
+    if(foundMantissa && scan != end && (*scan == 'e' || *scan == 'E'))
+    {
+        ++scan;
+        if(scan != end && (*scan == '+' || *scan == '-'))
+        {
+            ++scan;
+        }
+        while(scan != end && _isDigit(*scan))
+        {
+            ++scan;
+        }
+    }
+    cur = scan;
+
+    const char* number = *begin == '+' ? begin + 1 : begin; //from_chars takes no plus sign.
+    std::from_chars_result result = std::from_chars(number, scan, value);
+    if(result.ec == std::errc::invalid_argument || result.ptr != scan)
+    {
+        return false;
+    }
+    if(result.ec == std::errc::result_out_of_range)
+    {
+        return _convertOutOfRange(number, scan, value);
+    }
+    return true;
+}
+
+/**
+ * @brief the implementation of readScalars for both types.
+ */
+template <typename Scalar>
+static long _readScalars(std::istream& is, Scalar* values, long capacity)
+{
+    std::streambuf* buffer = is.rdbuf();
+    std::vector<char> chunk(READ_CHUNK_BYTES);
+    long filled = 0;
+    long count = 0;
+    bool atEnd = false;
+    while(true)
+    {
+        if(!atEnd)
+        {
+            if(filled == (long) chunk.size())
+            {
+                chunk.resize(chunk.size() * 2); //a single token longer than the chunk.
+            }
+            long wanted = (long) chunk.size() - filled;
+            long got = buffer == nullptr ? 0 : (long) buffer->sgetn(chunk.data() + filled, wanted);
+            filled += got;
+            atEnd = got < wanted;
+        }
+
+        //only whole tokens are parsed, the tail after the last whitespace waits for more input.
+        const char* cur = chunk.data();
+        const char* end = chunk.data() + filled;
+        const char* safeEnd = end;
+        if(!atEnd)
+        {
+            while(safeEnd != cur && !_isSpace(safeEnd[-1]))
+            {
+                --safeEnd;
+            }
+        }
+
+        while(true)
+        {
+            while(cur != safeEnd && _isSpace(*cur))
+            {
+                ++cur;
+            }
+            if(cur == safeEnd)
+            {
+                break;
+            }
+            Scalar value;
+            if(!_parseScalar(cur, safeEnd, value))
+            {
+                is.setstate(std::ios_base::failbit);
+                buffer->pubseekoff(-(std::streamoff) (end - cur), std::ios_base::cur,
+                                   std::ios_base::in);
+                return count;
+            }
+            if(count == capacity)
+            {
+                return capacity + 1;
+            }
+            values[count++] = value;
+        }
+
+        if(atEnd)
+        {
+            is.setstate(std::ios_base::eofbit | std::ios_base::failbit);
+            return count;
+        }
+        long rest = end - safeEnd;
+        std::memmove(chunk.data(), safeEnd, rest);
+        filled = rest;
+    }
+}
+
+long readScalars(std::istream& is, float* values, long capacity)
+{
+    return _readScalars(is, values, capacity);
+}
+
+long readScalars(std::istream& is, double* values, long capacity)
+{
+    return _readScalars(is, values, capacity);
+}
+
+// ------------------------------ writer ------------------------------
+
+bool hasDefaultFormat(const std::ostream& os)
+{
+    return os.flags() == (std::ios_base::skipws | std::ios_base::dec)
+           && os.precision() == DEFAULT_PRECISION && os.width() == 0
+           && os.getloc() == std::locale::classic();
+}
+
+/**
+ * @brief formats value like num_put does, the %g of printf with precision 6 that is the
+ *        general format of to_chars. integers below 10^6 (most pixel values) print all their
+ *        digits in that format, so they take the cheaper integer conversion.
+ * @return the end of the written text.
+ */
+template <typename Scalar>
+static inline char* _formatScalar(char* out, Scalar value)
+{
+    if(value > -1e6 && value < 1e6 && value == (Scalar) (int) value
+       && !(value == 0 && std::signbit(value)))
+    {
+        return std::to_chars(out, out + MAX_VALUE_CHARS, (int) value).ptr;
+    }
+    return std::to_chars(out, out + MAX_VALUE_CHARS, value, std::chars_format::general,
+                         DEFAULT_PRECISION).ptr;
+}
+
+/**
+ * @brief the implementation of writeScalars for both types.
+ */
+template <typename Scalar>
+static void _writeScalars(std::ostream& os, const Scalar* values, int rows, int cols)
+{
+    std::vector<char> chunk(WRITE_CHUNK_BYTES);
+    char* out = chunk.data();
+    char* flushAt = chunk.data() + chunk.size() - MAX_VALUE_CHARS - 1;
+    for(int row = 0; row < rows; ++row)
+    {
+        const Scalar* rowValues = values + (long) row * cols;
+        for(int col = 0; col < cols; ++col)
+        {
+            if(out >= flushAt)
+            {
+                os.write(chunk.data(), out - chunk.data());
+                out = chunk.data();
+            }
+            if(col != 0)
+            {
+                *out++ = ' ';
+            }
+            out = _formatScalar(out, rowValues[col]);
+        }
+        if(row != rows - 1)
+        {
+            //a matrix without columns is only separators, so they are checked too.
+            if(out >= flushAt)
+            {
+                os.write(chunk.data(), out - chunk.data());
+                out = chunk.data();
+            }
+            *out++ = '\n';
+        }
+    }
+    os.write(chunk.data(), out - chunk.data());
+}
+
+void writeScalars(std::ostream& os, const float* values, int rows, int cols)
+{
+    _writeScalars(os, values, rows, cols);
+}
+
+void writeScalars(std::ostream& os, const double* values, int rows, int cols)
+{
+    _writeScalars(os, values, rows, cols);
+}
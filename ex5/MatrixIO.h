@@ -0,0 +1,66 @@
+#ifndef SUMMER_EX4_MATRIXIO_H
+#define SUMMER_EX4_MATRIXIO_H
+
+/**
+ * @file MatrixIO.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief header file of MatrixIO.cpp, the bulk text codecs behind the Matrix stream operators.
+ *        they work on the stream buffer in big chunks instead of one formatted extraction per
+ *        value. included by Matrix.h, not meant to be included directly.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <iostream>
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @brief reads whitespace separated numbers from is into values, with exactly the results of
+ *        'while(is >> value)': the same correctly rounded values, and it stops at the first
+ *        token operator>> rejects (a letter, "inf", a dangling exponent like "1e", or a value
+ *        too big for the type), leaving is in the failed state the loop leaves it in. when it
+ *        stops before the end and the stream is seekable, the stream is moved back to the
+ *        rejected token. assumes the classic "C" locale.
+ * @param is the input stream, read from its current position.
+ * @param values the array to write to.
+ * @param capacity the size of values.
+ * @return the number of values read, capacity + 1 if is has more than capacity values (then
+ *         only the first capacity values are written).
+ */
+long readScalars(std::istream& is, float* values, long capacity);
+
+/**
+ * @brief the double version of readScalars.
+ */
+long readScalars(std::istream& is, double* values, long capacity);
+
+/**
+ * @return true if os formats numbers the default way (no flags but skipws and dec, precision 6,
+ *         no width and the classic locale), the format writeScalars reproduces.
+ */
+bool hasDefaultFormat(const std::ostream& os);
+
+/**
+ * @brief writes the rows x cols values to os, each row in new line, each value in the row
+ *        separated by space, no new line after the last row. the values are formatted by
+ *        std::to_chars into a local buffer that is written in big blocks, the bytes are the ones
+ *        'os << value' writes on a stream with hasDefaultFormat, which the caller checks. unlike
+ *        std::endl it does not flush os after every row.
+ * @param os the output stream to write to.
+ * @param values the values, row after row.
+ * @param rows the number of rows.
+ * @param cols the number of values in a row.
+ */
+void writeScalars(std::ostream& os, const float* values, int rows, int cols);
+
+/**
+ * @brief the double version of writeScalars.
+ */
+void writeScalars(std::ostream& os, const double* values, int rows, int cols);
+
+#endif //SUMMER_EX4_MATRIXIO_H
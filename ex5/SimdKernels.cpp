@@ -0,0 +1,1532 @@
+/**
+ * @file SimdKernels.cpp
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief The element-wise kernels of Matrix, one version per instruction set.
+ */
+
+#include <cmath>
+#include <cstring>
+#include "SimdKernels.h"
+#include "ElementTraits.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+// -------------------------- const definitions -------------------------
+
+/**
+ * tan(22.5 degrees), the bound between the orientations of quantizeOrientations.
+ */
+const float ORIENTATION_BOUND_TANGENT = 0.41421356f;
+
+// ------------------------------ scalar kernels ------------------------------
+
+static void _addArraysScalar(const float* lhs, const float* rhs, float* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = lhs[i] + rhs[i];
+    }
+}
+
+static void _addScalarScalar(const float* src, float scalar, float* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = src[i] + scalar;
+    }
+}
+
+static void _multiplyScalarScalar(const float* src, float scalar, float* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = src[i] * scalar;
+    }
+}
+
+static void _divideScalarScalar(const float* src, float scalar, float* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = src[i] / scalar;
+    }
+}
+
+static void _multiplyAddScalar(const float* src, float scalar, float* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] += src[i] * scalar;
+    }
+}
+
+static void _multiplyRoundScalar(const float* src, float scalar, float* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = std::rint(src[i] * scalar);
+    }
+}
+
+static void _clampArrayScalar(const float* src, float minVal, float maxVal, float* result,
+                              long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        float val = src[i];
+        result[i] = val < minVal ? minVal : (val > maxVal ? maxVal : val);
+    }
+}
+
+static bool _isIntegralScalar(const float* src, float maxAbs, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        if(!(std::fabs(src[i]) <= maxAbs))
+        {
+            return false;
+        }
+        //the bits of an integer survive the round trip through int, the ones of -0 do not.
+        float integral = (float) (int) src[i];
+        uint32_t srcBits;
+        uint32_t integralBits;
+        std::memcpy(&srcBits, src + i, sizeof(srcBits));
+        std::memcpy(&integralBits, &integral, sizeof(integralBits));
+        if(srcBits != integralBits)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _butterfliesScalar(double* lhsReal, double* lhsImag, double* rhsReal,
+                               double* rhsImag, double twiddleReal, double twiddleImag, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        double productReal = rhsReal[i] * twiddleReal - rhsImag[i] * twiddleImag;
+        double productImag = rhsReal[i] * twiddleImag + rhsImag[i] * twiddleReal;
+        rhsReal[i] = lhsReal[i] - productReal;
+        rhsImag[i] = lhsImag[i] - productImag;
+        lhsReal[i] += productReal;
+        lhsImag[i] += productImag;
+    }
+}
+
+/**
+ * the index of a value in a 256 entries table, nan fails the first comparison and gives 0.
+ */
+static inline int _tableIndex(float val)
+{
+    float clamped = val > 0 ? val : 0.f;
+    return (int) (clamped < 255 ? clamped : 255.f);
+}
+
+static void _lookupTableScalar(const float* src, const float* table, float* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = table[_tableIndex(src[i])];
+    }
+}
+
+static void _histogramScalar(const float* src, long* counts, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        ++counts[_tableIndex(src[i])];
+    }
+}
+
+static void _sobelRowScalar(const float* top, const float* mid, const float* bottom,
+                            float* gradX, float* gradY, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        float leftX = (top[i - 1] + bottom[i - 1]) + (mid[i - 1] + mid[i - 1]);
+        float rightX = (top[i + 1] + bottom[i + 1]) + (mid[i + 1] + mid[i + 1]);
+        float centerY = top[i] - bottom[i];
+        gradX[i] = leftX - rightX;
+        gradY[i] = ((top[i - 1] - bottom[i - 1]) + (top[i + 1] - bottom[i + 1])) +
+                   (centerY + centerY);
+    }
+}
+
+/**
+ * the orientations by the bits of the comparisons of quantizeOrientations: 1 if the gradient is
+ * not horizontal, 2 if it is vertical and 4 if the signs of its axes differ.
+ */
+static const uint8_t ORIENTATION_TABLE[8] = {0, 1, 0, 2, 0, 3, 0, 2};
+
+static void _quantizeOrientationsScalar(const float* gradX, const float* gradY, uint8_t* result,
+                                        long size)
+{
+    //the comparisons index ORIENTATION_TABLE instead of branching, the orientations of an image
+    //rarely come in runs.
+    for(long i = 0; i < size; ++i)
+    {
+        float absX = std::fabs(gradX[i]);
+        float absY = std::fabs(gradY[i]);
+        int index = (int) (absY > ORIENTATION_BOUND_TANGENT * absX) |
+                    (int) (absX <= ORIENTATION_BOUND_TANGENT * absY) << 1 |
+                    (int) ((gradX[i] > 0) != (gradY[i] > 0)) << 2;
+        result[i] = ORIENTATION_TABLE[index];
+    }
+}
+
+/**
+ * the integer kernels, also finish the tails of the vectorized integer kernels.
+ */
+template <typename T>
+static void _addArraysIntScalar(const T* lhs, const T* rhs, T* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = ElementTraits<T>::add(lhs[i], rhs[i]);
+    }
+}
+
+template <typename T>
+static void _multiplyScalarIntScalar(const T* src, float scalar, T* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        result[i] = ElementTraits<T>::multiply(src[i], scalar);
+    }
+}
+
+/**
+ * rint(sum / 2^shift) of an integer sum, rounded to nearest even like rintf: adds the half less
+ * one, and one more if the quotient is odd, then the arithmetic shift floors.
+ */
+static inline int _roundShift(int sum, int shift)
+{
+    return (sum + (1 << (shift - 1)) - 1 + ((sum >> shift) & 1)) >> shift;
+}
+
+static void _blurRowU8Scalar(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom,
+                             uint8_t* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        int left = top[i - 1] + 2 * mid[i - 1] + bottom[i - 1];
+        int center = top[i] + 2 * mid[i] + bottom[i];
+        int right = top[i + 1] + 2 * mid[i + 1] + bottom[i + 1];
+        result[i] = (uint8_t) _roundShift(left + 2 * center + right, 4);
+    }
+}
+
+static void _sobelRowU8Scalar(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom,
+                              uint8_t* result, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        int gradX = (top[i - 1] + 2 * mid[i - 1] + bottom[i - 1]) -
+                    (top[i + 1] + 2 * mid[i + 1] + bottom[i + 1]);
+        int gradY = (top[i - 1] - bottom[i - 1]) + 2 * (top[i] - bottom[i]) +
+                    (top[i + 1] - bottom[i + 1]);
+        int sum = _roundShift(gradX, 3) + _roundShift(gradY, 3);
+        result[i] = (uint8_t) (sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+    }
+}
+
+#ifdef SIMD_X86_DISPATCH
+
+/**
+ * The number of the partial histograms of the vectorized histogram kernels, consecutive values
+ * count in different ones, so a run of equal values does not wait for its own last increment.
+ */
+const int HISTOGRAM_COPIES = 4;
+
+/**
+ * adds the partial histograms of the vectorized histogram kernels to counts.
+ */
+static void _addHistograms(const long (*partial)[256], long* counts)
+{
+    for(int copy = 0; copy < HISTOGRAM_COPIES; ++copy)
+    {
+        for(int i = 0; i < 256; ++i)
+        {
+            counts[i] += partial[copy][i];
+        }
+    }
+}
+
+// ------------------------------ sse2 kernels ------------------------------
+
+__attribute__((target("sse2")))
+static void _addArraysSse2(const float* lhs, const float* rhs, float* result, long size)
+{
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        _mm_storeu_ps(result + i, _mm_add_ps(_mm_loadu_ps(lhs + i), _mm_loadu_ps(rhs + i)));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = lhs[i] + rhs[i];
+    }
+}
+
+__attribute__((target("sse2")))
+static void _addScalarSse2(const float* src, float scalar, float* result, long size)
+{
+    __m128 scalarVec = _mm_set1_ps(scalar);
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        _mm_storeu_ps(result + i, _mm_add_ps(_mm_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] + scalar;
+    }
+}
+
+__attribute__((target("sse2")))
+static void _multiplyScalarSse2(const float* src, float scalar, float* result, long size)
+{
+    __m128 scalarVec = _mm_set1_ps(scalar);
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        _mm_storeu_ps(result + i, _mm_mul_ps(_mm_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] * scalar;
+    }
+}
+
+__attribute__((target("sse2")))
+static void _divideScalarSse2(const float* src, float scalar, float* result, long size)
+{
+    __m128 scalarVec = _mm_set1_ps(scalar);
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        _mm_storeu_ps(result + i, _mm_div_ps(_mm_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] / scalar;
+    }
+}
+
+__attribute__((target("sse2")))
+static void _butterfliesSse2(double* lhsReal, double* lhsImag, double* rhsReal, double* rhsImag,
+                             double twiddleReal, double twiddleImag, long size)
+{
+    __m128d twiddleRealVec = _mm_set1_pd(twiddleReal);
+    __m128d twiddleImagVec = _mm_set1_pd(twiddleImag);
+    long i = 0;
+    for(; i + 2 <= size; i += 2)
+    {
+        __m128d rhsRealVec = _mm_loadu_pd(rhsReal + i);
+        __m128d rhsImagVec = _mm_loadu_pd(rhsImag + i);
+        __m128d productReal = _mm_sub_pd(_mm_mul_pd(rhsRealVec, twiddleRealVec),
+                                         _mm_mul_pd(rhsImagVec, twiddleImagVec));
+        __m128d productImag = _mm_add_pd(_mm_mul_pd(rhsRealVec, twiddleImagVec),
+                                         _mm_mul_pd(rhsImagVec, twiddleRealVec));
+        __m128d lhsRealVec = _mm_loadu_pd(lhsReal + i);
+        __m128d lhsImagVec = _mm_loadu_pd(lhsImag + i);
+        _mm_storeu_pd(rhsReal + i, _mm_sub_pd(lhsRealVec, productReal));
+        _mm_storeu_pd(rhsImag + i, _mm_sub_pd(lhsImagVec, productImag));
+        _mm_storeu_pd(lhsReal + i, _mm_add_pd(lhsRealVec, productReal));
+        _mm_storeu_pd(lhsImag + i, _mm_add_pd(lhsImagVec, productImag));
+    }
+    _butterfliesScalar(lhsReal + i, lhsImag + i, rhsReal + i, rhsImag + i, twiddleReal,
+                       twiddleImag, size - i);
+}
+
+__attribute__((target("sse2")))
+static void _multiplyAddSse2(const float* src, float scalar, float* result, long size)
+{
+    __m128 scalarVec = _mm_set1_ps(scalar);
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        __m128 product = _mm_mul_ps(_mm_loadu_ps(src + i), scalarVec);
+        _mm_storeu_ps(result + i, _mm_add_ps(_mm_loadu_ps(result + i), product));
+    }
+    _multiplyAddScalar(src + i, scalar, result + i, size - i);
+}
+
+/**
+ * @brief rounds 4 floats to nearest even like rintf, sse2 has no round instruction. the values
+ *        below 2^23 in magnitude are rounded by adding and subtracting 2^23 and get their sign
+ *        back (so -0.3 rounds to -0), the others (and nan) are integers already.
+ */
+__attribute__((target("sse2")))
+static inline __m128 _roundSse2(__m128 vals)
+{
+    __m128 signMask = _mm_set1_ps(-0.f);
+    __m128 twoPow23 = _mm_set1_ps(8388608.f);
+    __m128 absVals = _mm_andnot_ps(signMask, vals);
+    __m128 rounded = _mm_or_ps(_mm_sub_ps(_mm_add_ps(absVals, twoPow23), twoPow23),
+                               _mm_and_ps(vals, signMask));
+    __m128 isSmall = _mm_cmplt_ps(absVals, twoPow23);
+    return _mm_or_ps(_mm_and_ps(isSmall, rounded), _mm_andnot_ps(isSmall, vals));
+}
+
+__attribute__((target("sse2")))
+static void _multiplyRoundSse2(const float* src, float scalar, float* result, long size)
+{
+    __m128 scalarVec = _mm_set1_ps(scalar);
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        _mm_storeu_ps(result + i, _roundSse2(_mm_mul_ps(_mm_loadu_ps(src + i), scalarVec)));
+    }
+    _multiplyRoundScalar(src + i, scalar, result + i, size - i);
+}
+
+/**
+ * the min and max of the clamp take the value as their second operand, which they return on
+ * nan, and return it on equality too, so nan and -0 pass through like in the scalar clamp.
+ */
+__attribute__((target("sse2")))
+static void _clampArraySse2(const float* src, float minVal, float maxVal, float* result,
+                            long size)
+{
+    __m128 minVec = _mm_set1_ps(minVal);
+    __m128 maxVec = _mm_set1_ps(maxVal);
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        __m128 clamped = _mm_max_ps(minVec, _mm_min_ps(maxVec, _mm_loadu_ps(src + i)));
+        _mm_storeu_ps(result + i, clamped);
+    }
+    _clampArrayScalar(src + i, minVal, maxVal, result + i, size - i);
+}
+
+/**
+ * the lanes out of range (and nan) are zeroed before the conversion to int, and fail anyway.
+ */
+__attribute__((target("sse2")))
+static bool _isIntegralSse2(const float* src, float maxAbs, long size)
+{
+    __m128 signMask = _mm_set1_ps(-0.f);
+    __m128 maxVec = _mm_set1_ps(maxAbs);
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        __m128 vals = _mm_loadu_ps(src + i);
+        __m128 inRange = _mm_cmple_ps(_mm_andnot_ps(signMask, vals), maxVec);
+        __m128 integral = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_and_ps(vals, inRange)));
+        __m128i sameBits = _mm_cmpeq_epi32(_mm_castps_si128(integral), _mm_castps_si128(vals));
+        if(_mm_movemask_ps(_mm_and_ps(inRange, _mm_castsi128_ps(sameBits))) != 0xf)
+        {
+            return false;
+        }
+    }
+    return _isIntegralScalar(src + i, maxAbs, size - i);
+}
+
+/**
+ * sse2 has no gather, the indices are computed 4 at a time and looked up one by one. max and min
+ * take the value as their first operand, so a nan gives the second one, 0.
+ */
+__attribute__((target("sse2")))
+static void _lookupTableSse2(const float* src, const float* table, float* result, long size)
+{
+    __m128 zeroVec = _mm_setzero_ps();
+    __m128 maxIndexVec = _mm_set1_ps(255.f);
+    alignas(16) int32_t indices[4];
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zeroVec), maxIndexVec);
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(clamped));
+        _mm_storeu_ps(result + i, _mm_setr_ps(table[indices[0]], table[indices[1]],
+                                              table[indices[2]], table[indices[3]]));
+    }
+    _lookupTableScalar(src + i, table, result + i, size - i);
+}
+
+/**
+ * the indices are computed 4 at a time like in _lookupTableSse2, each counts in its own partial
+ * histogram.
+ */
+__attribute__((target("sse2")))
+static void _histogramSse2(const float* src, long* counts, long size)
+{
+    __m128 zeroVec = _mm_setzero_ps();
+    __m128 maxIndexVec = _mm_set1_ps(255.f);
+    alignas(16) int32_t indices[4];
+    long partial[HISTOGRAM_COPIES][256] = {};
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zeroVec), maxIndexVec);
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(clamped));
+        ++partial[0][indices[0]];
+        ++partial[1][indices[1]];
+        ++partial[2][indices[2]];
+        ++partial[3][indices[3]];
+    }
+    _addHistograms(partial, counts);
+    _histogramScalar(src + i, counts, size - i);
+}
+
+/**
+ * the three columns around every coordinate are loaded shifted by one, so each row is read once
+ * from the cache per neighborhood and the two gradients share the loads.
+ */
+__attribute__((target("sse2")))
+static void _sobelRowSse2(const float* top, const float* mid, const float* bottom,
+                          float* gradX, float* gradY, long size)
+{
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        __m128 topLeft = _mm_loadu_ps(top + i - 1);
+        __m128 midLeft = _mm_loadu_ps(mid + i - 1);
+        __m128 bottomLeft = _mm_loadu_ps(bottom + i - 1);
+        __m128 topRight = _mm_loadu_ps(top + i + 1);
+        __m128 midRight = _mm_loadu_ps(mid + i + 1);
+        __m128 bottomRight = _mm_loadu_ps(bottom + i + 1);
+        __m128 centerY = _mm_sub_ps(_mm_loadu_ps(top + i), _mm_loadu_ps(bottom + i));
+        __m128 leftX = _mm_add_ps(_mm_add_ps(topLeft, bottomLeft), _mm_add_ps(midLeft, midLeft));
+        __m128 rightX = _mm_add_ps(_mm_add_ps(topRight, bottomRight),
+                                   _mm_add_ps(midRight, midRight));
+        __m128 sidesY = _mm_add_ps(_mm_sub_ps(topLeft, bottomLeft),
+                                   _mm_sub_ps(topRight, bottomRight));
+        _mm_storeu_ps(gradX + i, _mm_sub_ps(leftX, rightX));
+        _mm_storeu_ps(gradY + i, _mm_add_ps(sidesY, _mm_add_ps(centerY, centerY)));
+    }
+    _sobelRowScalar(top + i, mid + i, bottom + i, gradX + i, gradY + i, size - i);
+}
+
+/**
+ * the orientations as 32 bit integers selected by the masks of the comparisons, then packed to
+ * bytes. a diagonal gradient has two non zero axes, so the sign bits tell if their signs differ.
+ */
+__attribute__((target("sse2")))
+static void _quantizeOrientationsSse2(const float* gradX, const float* gradY, uint8_t* result,
+                                      long size)
+{
+    __m128 signMask = _mm_set1_ps(-0.f);
+    __m128 tangentVec = _mm_set1_ps(ORIENTATION_BOUND_TANGENT);
+    __m128i verticalVec = _mm_set1_epi32(2);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m128i orientations[2];
+        for(int half = 0; half < 2; ++half)
+        {
+            __m128 valsX = _mm_loadu_ps(gradX + i + 4 * half);
+            __m128 valsY = _mm_loadu_ps(gradY + i + 4 * half);
+            __m128 absX = _mm_andnot_ps(signMask, valsX);
+            __m128 absY = _mm_andnot_ps(signMask, valsY);
+            __m128i isHorizontal = _mm_castps_si128(
+                    _mm_cmpngt_ps(absY, _mm_mul_ps(tangentVec, absX)));
+            __m128i isVertical = _mm_castps_si128(
+                    _mm_cmple_ps(absX, _mm_mul_ps(tangentVec, absY)));
+            __m128i signsDiffer = _mm_srai_epi32(_mm_castps_si128(_mm_xor_ps(valsX, valsY)), 31);
+            __m128i diagonal = _mm_or_si128(_mm_set1_epi32(1),
+                                            _mm_and_si128(signsDiffer, verticalVec));
+            __m128i notHorizontal = _mm_or_si128(_mm_and_si128(isVertical, verticalVec),
+                                                 _mm_andnot_si128(isVertical, diagonal));
+            orientations[half] = _mm_andnot_si128(isHorizontal, notHorizontal);
+        }
+        __m128i packed = _mm_packs_epi32(orientations[0], orientations[1]);
+        _mm_storel_epi64((__m128i*) (result + i), _mm_packus_epi16(packed, packed));
+    }
+    _quantizeOrientationsScalar(gradX + i, gradY + i, result + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void _addArraysU8Sse2(const uint8_t* lhs, const uint8_t* rhs, uint8_t* result, long size)
+{
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i sum = _mm_adds_epu8(_mm_loadu_si128((const __m128i*) (lhs + i)),
+                                    _mm_loadu_si128((const __m128i*) (rhs + i)));
+        _mm_storeu_si128((__m128i*) (result + i), sum);
+    }
+    _addArraysIntScalar(lhs + i, rhs + i, result + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void _addArraysI16Sse2(const int16_t* lhs, const int16_t* rhs, int16_t* result, long size)
+{
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m128i sum = _mm_adds_epi16(_mm_loadu_si128((const __m128i*) (lhs + i)),
+                                     _mm_loadu_si128((const __m128i*) (rhs + i)));
+        _mm_storeu_si128((__m128i*) (result + i), sum);
+    }
+    _addArraysIntScalar(lhs + i, rhs + i, result + i, size - i);
+}
+
+/**
+ * @brief multiplies 4 int32 by the scalar, clamps to [minVec, maxVec] (nan to minVec, as
+ *        _mm_max_ps returns its second operand on nan) and rounds to nearest even.
+ */
+__attribute__((target("sse2")))
+static inline __m128i _scaleInt32Sse2(__m128i vals, __m128 scalarVec, __m128 minVec,
+                                      __m128 maxVec)
+{
+    __m128 product = _mm_mul_ps(_mm_cvtepi32_ps(vals), scalarVec);
+    return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(product, minVec), maxVec));
+}
+
+__attribute__((target("sse2")))
+static void _multiplyScalarU8Sse2(const uint8_t* src, float scalar, uint8_t* result, long size)
+{
+    __m128 scalarVec = _mm_set1_ps(scalar);
+    __m128 minVec = _mm_set1_ps(0.f);
+    __m128 maxVec = _mm_set1_ps(255.f);
+    __m128i zero = _mm_setzero_si128();
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        __m128i v0 = _scaleInt32Sse2(_mm_unpacklo_epi16(low, zero), scalarVec, minVec, maxVec);
+        __m128i v1 = _scaleInt32Sse2(_mm_unpackhi_epi16(low, zero), scalarVec, minVec, maxVec);
+        __m128i v2 = _scaleInt32Sse2(_mm_unpacklo_epi16(high, zero), scalarVec, minVec, maxVec);
+        __m128i v3 = _scaleInt32Sse2(_mm_unpackhi_epi16(high, zero), scalarVec, minVec, maxVec);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+        _mm_storeu_si128((__m128i*) (result + i), packed);
+    }
+    _multiplyScalarIntScalar(src + i, scalar, result + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void _multiplyScalarI16Sse2(const int16_t* src, float scalar, int16_t* result, long size)
+{
+    __m128 scalarVec = _mm_set1_ps(scalar);
+    __m128 minVec = _mm_set1_ps(-32768.f);
+    __m128 maxVec = _mm_set1_ps(32767.f);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m128i vals = _mm_loadu_si128((const __m128i*) (src + i));
+        //sign extends by placing each value in the high half and shifting it down.
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(vals, vals), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(vals, vals), 16);
+        __m128i packed = _mm_packs_epi32(_scaleInt32Sse2(low, scalarVec, minVec, maxVec),
+                                         _scaleInt32Sse2(high, scalarVec, minVec, maxVec));
+        _mm_storeu_si128((__m128i*) (result + i), packed);
+    }
+    _multiplyScalarIntScalar(src + i, scalar, result + i, size - i);
+}
+
+/**
+ * @return 8 bytes from src widened to 16 bit integers.
+ */
+__attribute__((target("sse2")))
+static inline __m128i _loadWidenSse2(const uint8_t* src)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) src), _mm_setzero_si128());
+}
+
+/**
+ * @return top + 2 * mid + bottom of 8 columns, 16 bit.
+ */
+__attribute__((target("sse2")))
+static inline __m128i _columnSumSse2(const uint8_t* top, const uint8_t* mid,
+                                     const uint8_t* bottom)
+{
+    __m128i midVals = _loadWidenSse2(mid);
+    return _mm_add_epi16(_mm_add_epi16(_loadWidenSse2(top), _loadWidenSse2(bottom)),
+                         _mm_add_epi16(midVals, midVals));
+}
+
+/**
+ * @return top - bottom of 8 columns, 16 bit.
+ */
+__attribute__((target("sse2")))
+static inline __m128i _columnDiffSse2(const uint8_t* top, const uint8_t* bottom)
+{
+    return _mm_sub_epi16(_loadWidenSse2(top), _loadWidenSse2(bottom));
+}
+
+/**
+ * _roundShift of 8 16 bit sums.
+ */
+template <int SHIFT>
+__attribute__((target("sse2")))
+static inline __m128i _roundShiftSse2(__m128i sums)
+{
+    __m128i odd = _mm_and_si128(_mm_srai_epi16(sums, SHIFT), _mm_set1_epi16(1));
+    __m128i biased = _mm_add_epi16(_mm_add_epi16(sums, _mm_set1_epi16((1 << (SHIFT - 1)) - 1)),
+                                   odd);
+    return _mm_srai_epi16(biased, SHIFT);
+}
+
+/**
+ * the 16 bit blur of 8 pixels, every sum is at most 16 * 255.
+ */
+__attribute__((target("sse2")))
+static inline __m128i _blurU8Sse2(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom)
+{
+    __m128i center = _columnSumSse2(top, mid, bottom);
+    __m128i sums = _mm_add_epi16(_mm_add_epi16(_columnSumSse2(top - 1, mid - 1, bottom - 1),
+                                               _columnSumSse2(top + 1, mid + 1, bottom + 1)),
+                                 _mm_add_epi16(center, center));
+    return _roundShiftSse2<4>(sums);
+}
+
+/**
+ * the 16 bit sobel of 8 pixels before the saturation, every gradient is at most 4 * 255.
+ */
+__attribute__((target("sse2")))
+static inline __m128i _sobelU8Sse2(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom)
+{
+    __m128i gradX = _mm_sub_epi16(_columnSumSse2(top - 1, mid - 1, bottom - 1),
+                                  _columnSumSse2(top + 1, mid + 1, bottom + 1));
+    __m128i center = _columnDiffSse2(top, bottom);
+    __m128i gradY = _mm_add_epi16(_mm_add_epi16(_columnDiffSse2(top - 1, bottom - 1),
+                                                _columnDiffSse2(top + 1, bottom + 1)),
+                                  _mm_add_epi16(center, center));
+    return _mm_add_epi16(_roundShiftSse2<3>(gradX), _roundShiftSse2<3>(gradY));
+}
+
+/**
+ * 16 pixels per step, 8 per 16 bit register, twice the 4 of the float path.
+ */
+__attribute__((target("sse2")))
+static void _blurRowU8Sse2(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom,
+                           uint8_t* result, long size)
+{
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i packed = _mm_packus_epi16(_blurU8Sse2(top + i, mid + i, bottom + i),
+                                          _blurU8Sse2(top + i + 8, mid + i + 8, bottom + i + 8));
+        _mm_storeu_si128((__m128i*) (result + i), packed);
+    }
+    _blurRowU8Scalar(top + i, mid + i, bottom + i, result + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void _sobelRowU8Sse2(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom,
+                            uint8_t* result, long size)
+{
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        //the saturation of the pack is the one of the result.
+        __m128i packed = _mm_packus_epi16(_sobelU8Sse2(top + i, mid + i, bottom + i),
+                                          _sobelU8Sse2(top + i + 8, mid + i + 8, bottom + i + 8));
+        _mm_storeu_si128((__m128i*) (result + i), packed);
+    }
+    _sobelRowU8Scalar(top + i, mid + i, bottom + i, result + i, size - i);
+}
+
+// ------------------------------ avx2 kernels ------------------------------
+
+__attribute__((target("avx2")))
+static void _addArraysAvx2(const float* lhs, const float* rhs, float* result, long size)
+{
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        _mm256_storeu_ps(result + i,
+                         _mm256_add_ps(_mm256_loadu_ps(lhs + i), _mm256_loadu_ps(rhs + i)));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = lhs[i] + rhs[i];
+    }
+}
+
+__attribute__((target("avx2")))
+static void _addScalarAvx2(const float* src, float scalar, float* result, long size)
+{
+    __m256 scalarVec = _mm256_set1_ps(scalar);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        _mm256_storeu_ps(result + i, _mm256_add_ps(_mm256_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] + scalar;
+    }
+}
+
+__attribute__((target("avx2")))
+static void _multiplyScalarAvx2(const float* src, float scalar, float* result, long size)
+{
+    __m256 scalarVec = _mm256_set1_ps(scalar);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        _mm256_storeu_ps(result + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] * scalar;
+    }
+}
+
+__attribute__((target("avx2")))
+static void _divideScalarAvx2(const float* src, float scalar, float* result, long size)
+{
+    __m256 scalarVec = _mm256_set1_ps(scalar);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        _mm256_storeu_ps(result + i, _mm256_div_ps(_mm256_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] / scalar;
+    }
+}
+
+__attribute__((target("avx2")))
+static void _butterfliesAvx2(double* lhsReal, double* lhsImag, double* rhsReal, double* rhsImag,
+                             double twiddleReal, double twiddleImag, long size)
+{
+    __m256d twiddleRealVec = _mm256_set1_pd(twiddleReal);
+    __m256d twiddleImagVec = _mm256_set1_pd(twiddleImag);
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        __m256d rhsRealVec = _mm256_loadu_pd(rhsReal + i);
+        __m256d rhsImagVec = _mm256_loadu_pd(rhsImag + i);
+        __m256d productReal = _mm256_sub_pd(_mm256_mul_pd(rhsRealVec, twiddleRealVec),
+                                            _mm256_mul_pd(rhsImagVec, twiddleImagVec));
+        __m256d productImag = _mm256_add_pd(_mm256_mul_pd(rhsRealVec, twiddleImagVec),
+                                            _mm256_mul_pd(rhsImagVec, twiddleRealVec));
+        __m256d lhsRealVec = _mm256_loadu_pd(lhsReal + i);
+        __m256d lhsImagVec = _mm256_loadu_pd(lhsImag + i);
+        _mm256_storeu_pd(rhsReal + i, _mm256_sub_pd(lhsRealVec, productReal));
+        _mm256_storeu_pd(rhsImag + i, _mm256_sub_pd(lhsImagVec, productImag));
+        _mm256_storeu_pd(lhsReal + i, _mm256_add_pd(lhsRealVec, productReal));
+        _mm256_storeu_pd(lhsImag + i, _mm256_add_pd(lhsImagVec, productImag));
+    }
+    //the tail is a tail call gcc emits without clearing the upper halves, the sse code after
+    //dirty upper halves runs many times slower.
+    _mm256_zeroupper();
+    _butterfliesScalar(lhsReal + i, lhsImag + i, rhsReal + i, rhsImag + i, twiddleReal,
+                       twiddleImag, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _multiplyAddAvx2(const float* src, float scalar, float* result, long size)
+{
+    __m256 scalarVec = _mm256_set1_ps(scalar);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 product = _mm256_mul_ps(_mm256_loadu_ps(src + i), scalarVec);
+        _mm256_storeu_ps(result + i, _mm256_add_ps(_mm256_loadu_ps(result + i), product));
+    }
+    _multiplyAddScalar(src + i, scalar, result + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _multiplyRoundAvx2(const float* src, float scalar, float* result, long size)
+{
+    __m256 scalarVec = _mm256_set1_ps(scalar);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 product = _mm256_mul_ps(_mm256_loadu_ps(src + i), scalarVec);
+        _mm256_storeu_ps(result + i, _mm256_round_ps(product, _MM_FROUND_TO_NEAREST_INT |
+                                                              _MM_FROUND_NO_EXC));
+    }
+    _multiplyRoundScalar(src + i, scalar, result + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _clampArrayAvx2(const float* src, float minVal, float maxVal, float* result,
+                            long size)
+{
+    __m256 minVec = _mm256_set1_ps(minVal);
+    __m256 maxVec = _mm256_set1_ps(maxVal);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 clamped = _mm256_max_ps(minVec, _mm256_min_ps(maxVec, _mm256_loadu_ps(src + i)));
+        _mm256_storeu_ps(result + i, clamped);
+    }
+    _clampArrayScalar(src + i, minVal, maxVal, result + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static bool _isIntegralAvx2(const float* src, float maxAbs, long size)
+{
+    __m256 signMask = _mm256_set1_ps(-0.f);
+    __m256 maxVec = _mm256_set1_ps(maxAbs);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 vals = _mm256_loadu_ps(src + i);
+        __m256 inRange = _mm256_cmp_ps(_mm256_andnot_ps(signMask, vals), maxVec, _CMP_LE_OQ);
+        __m256 integral = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_and_ps(vals, inRange)));
+        __m256i sameBits = _mm256_cmpeq_epi32(_mm256_castps_si256(integral),
+                                              _mm256_castps_si256(vals));
+        if(_mm256_movemask_ps(_mm256_and_ps(inRange, _mm256_castsi256_ps(sameBits))) != 0xff)
+        {
+            return false;
+        }
+    }
+    return _isIntegralScalar(src + i, maxAbs, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _lookupTableAvx2(const float* src, const float* table, float* result, long size)
+{
+    __m256 zeroVec = _mm256_setzero_ps();
+    __m256 maxIndexVec = _mm256_set1_ps(255.f);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 clamped = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zeroVec),
+                                       maxIndexVec);
+        _mm256_storeu_ps(result + i,
+                         _mm256_i32gather_ps(table, _mm256_cvttps_epi32(clamped), sizeof(float)));
+    }
+    _lookupTableScalar(src + i, table, result + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _histogramAvx2(const float* src, long* counts, long size)
+{
+    __m256 zeroVec = _mm256_setzero_ps();
+    __m256 maxIndexVec = _mm256_set1_ps(255.f);
+    alignas(32) int32_t indices[8];
+    long partial[HISTOGRAM_COPIES][256] = {};
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 clamped = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zeroVec),
+                                       maxIndexVec);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(indices), _mm256_cvttps_epi32(clamped));
+        ++partial[0][indices[0]];
+        ++partial[1][indices[1]];
+        ++partial[2][indices[2]];
+        ++partial[3][indices[3]];
+        ++partial[0][indices[4]];
+        ++partial[1][indices[5]];
+        ++partial[2][indices[6]];
+        ++partial[3][indices[7]];
+    }
+    _mm256_zeroupper();
+    _addHistograms(partial, counts);
+    _histogramScalar(src + i, counts, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _sobelRowAvx2(const float* top, const float* mid, const float* bottom,
+                          float* gradX, float* gradY, long size)
+{
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 topLeft = _mm256_loadu_ps(top + i - 1);
+        __m256 midLeft = _mm256_loadu_ps(mid + i - 1);
+        __m256 bottomLeft = _mm256_loadu_ps(bottom + i - 1);
+        __m256 topRight = _mm256_loadu_ps(top + i + 1);
+        __m256 midRight = _mm256_loadu_ps(mid + i + 1);
+        __m256 bottomRight = _mm256_loadu_ps(bottom + i + 1);
+        __m256 centerY = _mm256_sub_ps(_mm256_loadu_ps(top + i), _mm256_loadu_ps(bottom + i));
+        __m256 leftX = _mm256_add_ps(_mm256_add_ps(topLeft, bottomLeft),
+                                     _mm256_add_ps(midLeft, midLeft));
+        __m256 rightX = _mm256_add_ps(_mm256_add_ps(topRight, bottomRight),
+                                      _mm256_add_ps(midRight, midRight));
+        __m256 sidesY = _mm256_add_ps(_mm256_sub_ps(topLeft, bottomLeft),
+                                      _mm256_sub_ps(topRight, bottomRight));
+        _mm256_storeu_ps(gradX + i, _mm256_sub_ps(leftX, rightX));
+        _mm256_storeu_ps(gradY + i, _mm256_add_ps(sidesY, _mm256_add_ps(centerY, centerY)));
+    }
+    _mm256_zeroupper();
+    _sobelRowScalar(top + i, mid + i, bottom + i, gradX + i, gradY + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _quantizeOrientationsAvx2(const float* gradX, const float* gradY, uint8_t* result,
+                                      long size)
+{
+    __m256 signMask = _mm256_set1_ps(-0.f);
+    __m256 tangentVec = _mm256_set1_ps(ORIENTATION_BOUND_TANGENT);
+    __m256i verticalVec = _mm256_set1_epi32(2);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 valsX = _mm256_loadu_ps(gradX + i);
+        __m256 valsY = _mm256_loadu_ps(gradY + i);
+        __m256 absX = _mm256_andnot_ps(signMask, valsX);
+        __m256 absY = _mm256_andnot_ps(signMask, valsY);
+        __m256i isHorizontal = _mm256_castps_si256(
+                _mm256_cmp_ps(absY, _mm256_mul_ps(tangentVec, absX), _CMP_NGT_UQ));
+        __m256i isVertical = _mm256_castps_si256(
+                _mm256_cmp_ps(absX, _mm256_mul_ps(tangentVec, absY), _CMP_LE_OQ));
+        __m256i signsDiffer = _mm256_srai_epi32(
+                _mm256_castps_si256(_mm256_xor_ps(valsX, valsY)), 31);
+        __m256i diagonal = _mm256_or_si256(_mm256_set1_epi32(1),
+                                           _mm256_and_si256(signsDiffer, verticalVec));
+        __m256i notHorizontal = _mm256_blendv_epi8(diagonal, verticalVec, isVertical);
+        __m256i orientations = _mm256_andnot_si256(isHorizontal, notHorizontal);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(orientations),
+                                         _mm256_extracti128_si256(orientations, 1));
+        _mm_storel_epi64((__m128i*) (result + i), _mm_packus_epi16(packed, packed));
+    }
+    _mm256_zeroupper();
+    _quantizeOrientationsScalar(gradX + i, gradY + i, result + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _addArraysU8Avx2(const uint8_t* lhs, const uint8_t* rhs, uint8_t* result, long size)
+{
+    long i = 0;
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i sum = _mm256_adds_epu8(_mm256_loadu_si256((const __m256i*) (lhs + i)),
+                                       _mm256_loadu_si256((const __m256i*) (rhs + i)));
+        _mm256_storeu_si256((__m256i*) (result + i), sum);
+    }
+    _addArraysIntScalar(lhs + i, rhs + i, result + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _addArraysI16Avx2(const int16_t* lhs, const int16_t* rhs, int16_t* result, long size)
+{
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m256i sum = _mm256_adds_epi16(_mm256_loadu_si256((const __m256i*) (lhs + i)),
+                                        _mm256_loadu_si256((const __m256i*) (rhs + i)));
+        _mm256_storeu_si256((__m256i*) (result + i), sum);
+    }
+    _addArraysIntScalar(lhs + i, rhs + i, result + i, size - i);
+}
+
+/**
+ * @brief the avx2 version of _scaleInt32Sse2, 8 int32 at a time, packed down to 8 int16.
+ */
+__attribute__((target("avx2")))
+static inline __m128i _scaleInt32Avx2(__m256i vals, __m256 scalarVec, __m256 minVec,
+                                      __m256 maxVec)
+{
+    __m256 product = _mm256_mul_ps(_mm256_cvtepi32_ps(vals), scalarVec);
+    __m256i rounded = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(product, minVec), maxVec));
+    return _mm_packs_epi32(_mm256_castsi256_si128(rounded), _mm256_extracti128_si256(rounded, 1));
+}
+
+__attribute__((target("avx2")))
+static void _multiplyScalarU8Avx2(const uint8_t* src, float scalar, uint8_t* result, long size)
+{
+    __m256 scalarVec = _mm256_set1_ps(scalar);
+    __m256 minVec = _mm256_set1_ps(0.f);
+    __m256 maxVec = _mm256_set1_ps(255.f);
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m256i v0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (src + i)));
+        __m256i v1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (src + i + 8)));
+        __m128i packed = _mm_packus_epi16(_scaleInt32Avx2(v0, scalarVec, minVec, maxVec),
+                                          _scaleInt32Avx2(v1, scalarVec, minVec, maxVec));
+        _mm_storeu_si128((__m128i*) (result + i), packed);
+    }
+    _multiplyScalarIntScalar(src + i, scalar, result + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _multiplyScalarI16Avx2(const int16_t* src, float scalar, int16_t* result, long size)
+{
+    __m256 scalarVec = _mm256_set1_ps(scalar);
+    __m256 minVec = _mm256_set1_ps(-32768.f);
+    __m256 maxVec = _mm256_set1_ps(32767.f);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256i vals = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src + i)));
+        _mm_storeu_si128((__m128i*) (result + i),
+                         _scaleInt32Avx2(vals, scalarVec, minVec, maxVec));
+    }
+    _multiplyScalarIntScalar(src + i, scalar, result + i, size - i);
+}
+
+/**
+ * @return 16 bytes from src widened to 16 bit integers.
+ */
+__attribute__((target("avx2")))
+static inline __m256i _loadWidenAvx2(const uint8_t* src)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) src));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i _columnSumAvx2(const uint8_t* top, const uint8_t* mid,
+                                     const uint8_t* bottom)
+{
+    __m256i midVals = _loadWidenAvx2(mid);
+    return _mm256_add_epi16(_mm256_add_epi16(_loadWidenAvx2(top), _loadWidenAvx2(bottom)),
+                            _mm256_add_epi16(midVals, midVals));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i _columnDiffAvx2(const uint8_t* top, const uint8_t* bottom)
+{
+    return _mm256_sub_epi16(_loadWidenAvx2(top), _loadWidenAvx2(bottom));
+}
+
+template <int SHIFT>
+__attribute__((target("avx2")))
+static inline __m256i _roundShiftAvx2(__m256i sums)
+{
+    __m256i odd = _mm256_and_si256(_mm256_srai_epi16(sums, SHIFT), _mm256_set1_epi16(1));
+    __m256i biased = _mm256_add_epi16(
+            _mm256_add_epi16(sums, _mm256_set1_epi16((1 << (SHIFT - 1)) - 1)), odd);
+    return _mm256_srai_epi16(biased, SHIFT);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i _blurU8Avx2(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom)
+{
+    __m256i center = _columnSumAvx2(top, mid, bottom);
+    __m256i sums = _mm256_add_epi16(
+            _mm256_add_epi16(_columnSumAvx2(top - 1, mid - 1, bottom - 1),
+                             _columnSumAvx2(top + 1, mid + 1, bottom + 1)),
+            _mm256_add_epi16(center, center));
+    return _roundShiftAvx2<4>(sums);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i _sobelU8Avx2(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom)
+{
+    __m256i gradX = _mm256_sub_epi16(_columnSumAvx2(top - 1, mid - 1, bottom - 1),
+                                     _columnSumAvx2(top + 1, mid + 1, bottom + 1));
+    __m256i center = _columnDiffAvx2(top, bottom);
+    __m256i gradY = _mm256_add_epi16(_mm256_add_epi16(_columnDiffAvx2(top - 1, bottom - 1),
+                                                      _columnDiffAvx2(top + 1, bottom + 1)),
+                                     _mm256_add_epi16(center, center));
+    return _mm256_add_epi16(_roundShiftAvx2<3>(gradX), _roundShiftAvx2<3>(gradY));
+}
+
+/**
+ * 32 pixels per step, the pack works on the 128 bit lanes, so its quarters are put back in order.
+ */
+__attribute__((target("avx2")))
+static void _blurRowU8Avx2(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom,
+                           uint8_t* result, long size)
+{
+    long i = 0;
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i packed = _mm256_packus_epi16(
+                _blurU8Avx2(top + i, mid + i, bottom + i),
+                _blurU8Avx2(top + i + 16, mid + i + 16, bottom + i + 16));
+        _mm256_storeu_si256((__m256i*) (result + i), _mm256_permute4x64_epi64(packed, 0xd8));
+    }
+    _mm256_zeroupper();
+    _blurRowU8Scalar(top + i, mid + i, bottom + i, result + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void _sobelRowU8Avx2(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom,
+                            uint8_t* result, long size)
+{
+    long i = 0;
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i packed = _mm256_packus_epi16(
+                _sobelU8Avx2(top + i, mid + i, bottom + i),
+                _sobelU8Avx2(top + i + 16, mid + i + 16, bottom + i + 16));
+        _mm256_storeu_si256((__m256i*) (result + i), _mm256_permute4x64_epi64(packed, 0xd8));
+    }
+    _mm256_zeroupper();
+    _sobelRowU8Scalar(top + i, mid + i, bottom + i, result + i, size - i);
+}
+
+// ------------------------------ avx512f kernels ------------------------------
+
+__attribute__((target("avx512f")))
+static void _addArraysAvx512(const float* lhs, const float* rhs, float* result, long size)
+{
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        _mm512_storeu_ps(result + i,
+                         _mm512_add_ps(_mm512_loadu_ps(lhs + i), _mm512_loadu_ps(rhs + i)));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = lhs[i] + rhs[i];
+    }
+}
+
+__attribute__((target("avx512f")))
+static void _addScalarAvx512(const float* src, float scalar, float* result, long size)
+{
+    __m512 scalarVec = _mm512_set1_ps(scalar);
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        _mm512_storeu_ps(result + i, _mm512_add_ps(_mm512_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] + scalar;
+    }
+}
+
+__attribute__((target("avx512f")))
+static void _multiplyScalarAvx512(const float* src, float scalar, float* result, long size)
+{
+    __m512 scalarVec = _mm512_set1_ps(scalar);
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        _mm512_storeu_ps(result + i, _mm512_mul_ps(_mm512_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] * scalar;
+    }
+}
+
+__attribute__((target("avx512f")))
+static void _divideScalarAvx512(const float* src, float scalar, float* result, long size)
+{
+    __m512 scalarVec = _mm512_set1_ps(scalar);
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        _mm512_storeu_ps(result + i, _mm512_div_ps(_mm512_loadu_ps(src + i), scalarVec));
+    }
+    for(; i < size; ++i)
+    {
+        result[i] = src[i] / scalar;
+    }
+}
+
+__attribute__((target("avx512f")))
+static void _butterfliesAvx512(double* lhsReal, double* lhsImag, double* rhsReal, double* rhsImag,
+                               double twiddleReal, double twiddleImag, long size)
+{
+    __m512d twiddleRealVec = _mm512_set1_pd(twiddleReal);
+    __m512d twiddleImagVec = _mm512_set1_pd(twiddleImag);
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m512d rhsRealVec = _mm512_loadu_pd(rhsReal + i);
+        __m512d rhsImagVec = _mm512_loadu_pd(rhsImag + i);
+        __m512d productReal = _mm512_sub_pd(_mm512_mul_pd(rhsRealVec, twiddleRealVec),
+                                            _mm512_mul_pd(rhsImagVec, twiddleImagVec));
+        __m512d productImag = _mm512_add_pd(_mm512_mul_pd(rhsRealVec, twiddleImagVec),
+                                            _mm512_mul_pd(rhsImagVec, twiddleRealVec));
+        __m512d lhsRealVec = _mm512_loadu_pd(lhsReal + i);
+        __m512d lhsImagVec = _mm512_loadu_pd(lhsImag + i);
+        _mm512_storeu_pd(rhsReal + i, _mm512_sub_pd(lhsRealVec, productReal));
+        _mm512_storeu_pd(rhsImag + i, _mm512_sub_pd(lhsImagVec, productImag));
+        _mm512_storeu_pd(lhsReal + i, _mm512_add_pd(lhsRealVec, productReal));
+        _mm512_storeu_pd(lhsImag + i, _mm512_add_pd(lhsImagVec, productImag));
+    }
+    //the tail is a tail call gcc emits without clearing the upper halves, the sse code after
+    //dirty upper halves runs many times slower.
+    _mm256_zeroupper();
+    _butterfliesScalar(lhsReal + i, lhsImag + i, rhsReal + i, rhsImag + i, twiddleReal,
+                       twiddleImag, size - i);
+}
+
+__attribute__((target("avx512f")))
+static void _lookupTableAvx512(const float* src, const float* table, float* result, long size)
+{
+    //gcc 12 warns on the undefined source of the unmasked max, min, conversion and gather, the
+    //same instructions with all the lanes masked in take a defined one.
+    __mmask16 allLanes = 0xFFFF;
+    __m512 zeroVec = _mm512_setzero_ps();
+    __m512 maxIndexVec = _mm512_set1_ps(255.f);
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m512 clamped = _mm512_maskz_min_ps(allLanes,
+                                             _mm512_maskz_max_ps(allLanes, _mm512_loadu_ps(src + i),
+                                                                 zeroVec),
+                                             maxIndexVec);
+        __m512i indices = _mm512_maskz_cvttps_epi32(allLanes, clamped);
+        _mm512_storeu_ps(result + i, _mm512_mask_i32gather_ps(zeroVec, allLanes, indices, table,
+                                                              sizeof(float)));
+    }
+    _mm256_zeroupper();
+    _lookupTableScalar(src + i, table, result + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+static void _multiplyAddAvx512(const float* src, float scalar, float* result, long size)
+{
+    __m512 scalarVec = _mm512_set1_ps(scalar);
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m512 product = _mm512_mul_ps(_mm512_loadu_ps(src + i), scalarVec);
+        _mm512_storeu_ps(result + i, _mm512_add_ps(_mm512_loadu_ps(result + i), product));
+    }
+    _multiplyAddScalar(src + i, scalar, result + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+static void _multiplyRoundAvx512(const float* src, float scalar, float* result, long size)
+{
+    __m512 scalarVec = _mm512_set1_ps(scalar);
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m512 product = _mm512_mul_ps(_mm512_loadu_ps(src + i), scalarVec);
+        //the masked form, the unmasked one starts from an undefined vector gcc warns about.
+        _mm512_storeu_ps(result + i, _mm512_mask_roundscale_ps(product, 0xffff, product,
+                                                               _MM_FROUND_TO_NEAREST_INT |
+                                                               _MM_FROUND_NO_EXC));
+    }
+    _multiplyRoundScalar(src + i, scalar, result + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+static void _sobelRowAvx512(const float* top, const float* mid, const float* bottom,
+                            float* gradX, float* gradY, long size)
+{
+    long i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m512 topLeft = _mm512_loadu_ps(top + i - 1);
+        __m512 midLeft = _mm512_loadu_ps(mid + i - 1);
+        __m512 bottomLeft = _mm512_loadu_ps(bottom + i - 1);
+        __m512 topRight = _mm512_loadu_ps(top + i + 1);
+        __m512 midRight = _mm512_loadu_ps(mid + i + 1);
+        __m512 bottomRight = _mm512_loadu_ps(bottom + i + 1);
+        __m512 centerY = _mm512_sub_ps(_mm512_loadu_ps(top + i), _mm512_loadu_ps(bottom + i));
+        __m512 leftX = _mm512_add_ps(_mm512_add_ps(topLeft, bottomLeft),
+                                     _mm512_add_ps(midLeft, midLeft));
+        __m512 rightX = _mm512_add_ps(_mm512_add_ps(topRight, bottomRight),
+                                      _mm512_add_ps(midRight, midRight));
+        __m512 sidesY = _mm512_add_ps(_mm512_sub_ps(topLeft, bottomLeft),
+                                      _mm512_sub_ps(topRight, bottomRight));
+        _mm512_storeu_ps(gradX + i, _mm512_sub_ps(leftX, rightX));
+        _mm512_storeu_ps(gradY + i, _mm512_add_ps(sidesY, _mm512_add_ps(centerY, centerY)));
+    }
+    _mm256_zeroupper();
+    _sobelRowScalar(top + i, mid + i, bottom + i, gradX + i, gradY + i, size - i);
+}
+
+#endif
+
+// ------------------------------ dispatch ------------------------------
+
+/**
+ * @struct KernelTable
+ * @brief the versions of the kernels of one instruction set.
+ */
+struct KernelTable
+{
+    SimdLevel level;
+    void (*addArrays)(const float*, const float*, float*, long);
+    void (*addScalar)(const float*, float, float*, long);
+    void (*multiplyScalar)(const float*, float, float*, long);
+    void (*divideScalar)(const float*, float, float*, long);
+    void (*multiplyAdd)(const float*, float, float*, long);
+    void (*multiplyRound)(const float*, float, float*, long);
+    void (*clampArray)(const float*, float, float, float*, long);
+    bool (*isIntegral)(const float*, float, long);
+    void (*butterflies)(double*, double*, double*, double*, double, double, long);
+    void (*lookupTable)(const float*, const float*, float*, long);
+    void (*histogram)(const float*, long*, long);
+    void (*sobelRow)(const float*, const float*, const float*, float*, float*, long);
+    void (*quantizeOrientations)(const float*, const float*, uint8_t*, long);
+    void (*addArraysU8)(const uint8_t*, const uint8_t*, uint8_t*, long);
+    void (*addArraysI16)(const int16_t*, const int16_t*, int16_t*, long);
+    void (*multiplyScalarU8)(const uint8_t*, float, uint8_t*, long);
+    void (*multiplyScalarI16)(const int16_t*, float, int16_t*, long);
+    void (*blurRowU8)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, long);
+    void (*sobelRowU8)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, long);
+};
+
+/**
+ * @return the kernels of the given instruction set.
+ */
+static KernelTable _tableFor(SimdLevel level)
+{
+#ifdef SIMD_X86_DISPATCH
+    switch(level)
+    {
+        case SIMD_AVX512:
+            //the integer kernels would need avx512bw, avx512f implies avx2.
+            return {SIMD_AVX512, _addArraysAvx512, _addScalarAvx512, _multiplyScalarAvx512,
+                    _divideScalarAvx512, _multiplyAddAvx512, _multiplyRoundAvx512,
+                    _clampArrayAvx2, _isIntegralAvx2, _butterfliesAvx512, _lookupTableAvx512,
+                    _histogramAvx2, _sobelRowAvx512, _quantizeOrientationsAvx2, _addArraysU8Avx2,
+                    _addArraysI16Avx2, _multiplyScalarU8Avx2, _multiplyScalarI16Avx2,
+                    _blurRowU8Avx2, _sobelRowU8Avx2};
+        case SIMD_AVX2:
+            return {SIMD_AVX2, _addArraysAvx2, _addScalarAvx2, _multiplyScalarAvx2,
+                    _divideScalarAvx2, _multiplyAddAvx2, _multiplyRoundAvx2,
+                    _clampArrayAvx2, _isIntegralAvx2, _butterfliesAvx2, _lookupTableAvx2,
+                    _histogramAvx2, _sobelRowAvx2, _quantizeOrientationsAvx2, _addArraysU8Avx2,
+                    _addArraysI16Avx2, _multiplyScalarU8Avx2, _multiplyScalarI16Avx2,
+                    _blurRowU8Avx2, _sobelRowU8Avx2};
+        case SIMD_SSE2:
+            return {SIMD_SSE2, _addArraysSse2, _addScalarSse2, _multiplyScalarSse2,
+                    _divideScalarSse2, _multiplyAddSse2, _multiplyRoundSse2,
+                    _clampArraySse2, _isIntegralSse2, _butterfliesSse2, _lookupTableSse2,
+                    _histogramSse2, _sobelRowSse2, _quantizeOrientationsSse2, _addArraysU8Sse2,
+                    _addArraysI16Sse2, _multiplyScalarU8Sse2, _multiplyScalarI16Sse2,
+                    _blurRowU8Sse2, _sobelRowU8Sse2};
+        default:
+            break;
+    }
+#endif
+    (void) level;
+    return {SIMD_SCALAR, _addArraysScalar, _addScalarScalar, _multiplyScalarScalar,
+            _divideScalarScalar, _multiplyAddScalar, _multiplyRoundScalar,
+            _clampArrayScalar, _isIntegralScalar, _butterfliesScalar, _lookupTableScalar,
+            _histogramScalar, _sobelRowScalar, _quantizeOrientationsScalar,
+            _addArraysIntScalar<uint8_t>, _addArraysIntScalar<int16_t>,
+            _multiplyScalarIntScalar<uint8_t>, _multiplyScalarIntScalar<int16_t>,
+            _blurRowU8Scalar, _sobelRowU8Scalar};
+}
+
+/**
+ * @return the kernels in use, the best ones of the running cpu until setSimdLevel is called.
+ */
+static KernelTable& _kernels()
+{
+    static KernelTable table = _tableFor(detectSimdLevel());
+    return table;
+}
+
+SimdLevel detectSimdLevel()
+{
+#ifdef SIMD_X86_DISPATCH
+    if(__builtin_cpu_supports("avx512f"))
+    {
+        return SIMD_AVX512;
+    }
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return SIMD_AVX2;
+    }
+    if(__builtin_cpu_supports("sse2"))
+    {
+        return SIMD_SSE2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+SimdLevel getSimdLevel()
+{
+    return _kernels().level;
+}
+
+void setSimdLevel(SimdLevel level)
+{
+    SimdLevel supported = detectSimdLevel();
+    _kernels() = _tableFor(level < supported ? level : supported);
+}
+
+void addArrays(const float* lhs, const float* rhs, float* result, long size)
+{
+    _kernels().addArrays(lhs, rhs, result, size);
+}
+
+void addScalar(const float* src, float scalar, float* result, long size)
+{
+    _kernels().addScalar(src, scalar, result, size);
+}
+
+void multiplyScalar(const float* src, float scalar, float* result, long size)
+{
+    _kernels().multiplyScalar(src, scalar, result, size);
+}
+
+void divideScalar(const float* src, float scalar, float* result, long size)
+{
+    _kernels().divideScalar(src, scalar, result, size);
+}
+
+void multiplyAdd(const float* src, float scalar, float* result, long size)
+{
+    _kernels().multiplyAdd(src, scalar, result, size);
+}
+
+void multiplyRound(const float* src, float scalar, float* result, long size)
+{
+    _kernels().multiplyRound(src, scalar, result, size);
+}
+
+void clampArray(const float* src, float minVal, float maxVal, float* result, long size)
+{
+    _kernels().clampArray(src, minVal, maxVal, result, size);
+}
+
+bool isIntegral(const float* src, float maxAbs, long size)
+{
+    return _kernels().isIntegral(src, maxAbs, size);
+}
+
+void butterflies(double* lhsReal, double* lhsImag, double* rhsReal, double* rhsImag,
+                 double twiddleReal, double twiddleImag, long size)
+{
+    _kernels().butterflies(lhsReal, lhsImag, rhsReal, rhsImag, twiddleReal, twiddleImag, size);
+}
+
+void lookupTable(const float* src, const float* table, float* result, long size)
+{
+    _kernels().lookupTable(src, table, result, size);
+}
+
+void histogram(const float* src, long* counts, long size)
+{
+    _kernels().histogram(src, counts, size);
+}
+
+void sobelRow(const float* top, const float* mid, const float* bottom, float* gradX,
+              float* gradY, long size)
+{
+    _kernels().sobelRow(top, mid, bottom, gradX, gradY, size);
+}
+
+void quantizeOrientations(const float* gradX, const float* gradY, uint8_t* result, long size)
+{
+    _kernels().quantizeOrientations(gradX, gradY, result, size);
+}
+
+void addArrays(const uint8_t* lhs, const uint8_t* rhs, uint8_t* result, long size)
+{
+    _kernels().addArraysU8(lhs, rhs, result, size);
+}
+
+void addArrays(const int16_t* lhs, const int16_t* rhs, int16_t* result, long size)
+{
+    _kernels().addArraysI16(lhs, rhs, result, size);
+}
+
+void multiplyScalar(const uint8_t* src, float scalar, uint8_t* result, long size)
+{
+    _kernels().multiplyScalarU8(src, scalar, result, size);
+}
+
+void multiplyScalar(const int16_t* src, float scalar, int16_t* result, long size)
+{
+    _kernels().multiplyScalarI16(src, scalar, result, size);
+}
+
+void blurRow(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom, uint8_t* result,
+             long size)
+{
+    _kernels().blurRowU8(top, mid, bottom, result, size);
+}
+
+void sobelRow(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom, uint8_t* result,
+              long size)
+{
+    _kernels().sobelRowU8(top, mid, bottom, result, size);
+}
@@ -0,0 +1,182 @@
+#ifndef SUMMER_EX4_SIMDKERNELS_H
+#define SUMMER_EX4_SIMDKERNELS_H
+
+/**
+ * @file SimdKernels.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief header file of SimdKernels.cpp, the vectorized element-wise kernels of Matrix. the
+ *        instruction set is picked at runtime by the cpu features, all of them give bit identical
+ *        results.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <cstdint>
+
+// -------------------------- const definitions -------------------------
+
+/**
+ * The alignment in bytes of the Matrix storage, a whole cache line so the vector loads never
+ * split cache lines.
+ */
+const int SIMD_ALIGNMENT = 64;
+
+/**
+ * @enum SimdLevel
+ * @brief the instruction sets the kernels have versions for, from the weakest.
+ */
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @return the instruction set the kernels currently use.
+ */
+SimdLevel getSimdLevel();
+
+/**
+ * @brief limit the kernels to the given instruction set, or to the best one the cpu supports if
+ *        it is weaker. meant for tests and benchmarks.
+ * @param level the strongest instruction set to use.
+ */
+void setSimdLevel(SimdLevel level);
+
+/**
+ * @return the strongest instruction set the running cpu supports.
+ */
+SimdLevel detectSimdLevel();
+
+/**
+ * @brief result[i] = lhs[i] + rhs[i], result may be one of the sources.
+ */
+void addArrays(const float* lhs, const float* rhs, float* result, long size);
+
+/**
+ * @brief result[i] = src[i] + scalar, result may be src.
+ */
+void addScalar(const float* src, float scalar, float* result, long size);
+
+/**
+ * @brief result[i] = src[i] * scalar, result may be src.
+ */
+void multiplyScalar(const float* src, float scalar, float* result, long size);
+
+/**
+ * @brief result[i] = src[i] / scalar, result may be src. a true division, not a multiplication
+ *        by the reciprocal, so the results match the scalar division.
+ */
+void divideScalar(const float* src, float scalar, float* result, long size);
+
+/**
+ * @brief result[i] += src[i] * scalar, the product and the sum are rounded separately (no fused
+ *        multiply-add) in every version.
+ */
+void multiplyAdd(const float* src, float scalar, float* result, long size);
+
+/**
+ * @brief result[i] = rint(src[i] * scalar), rounded to nearest even like rintf (so -0.3 rounds
+ *        to -0), result may be src.
+ */
+void multiplyRound(const float* src, float scalar, float* result, long size);
+
+/**
+ * @brief the radix 2 fft butterflies of two rows of complex values given as real and imaginary
+ *        parts: lhs[i], rhs[i] = lhs[i] + rhs[i] * twiddle, lhs[i] - rhs[i] * twiddle.
+ */
+void butterflies(double* lhsReal, double* lhsImag, double* rhsReal, double* rhsImag,
+                 double twiddleReal, double twiddleImag, long size);
+
+/**
+ * @brief result[i] = src[i] < minVal ? minVal : (src[i] > maxVal ? maxVal : src[i]), so nan and
+ *        -0 stay as they are, result may be src.
+ */
+void clampArray(const float* src, float minVal, float maxVal, float* result, long size);
+
+/**
+ * @brief result[i] = table[the integral part of src[i]], with src[i] first clamped to [0, 255]
+ *        and nan taken as 0, result may be src.
+ * @param table 256 values.
+ */
+void lookupTable(const float* src, const float* table, float* result, long size);
+
+/**
+ * @brief counts[i] += the number of the values of src whose lookupTable index is i.
+ * @param counts 256 counters.
+ */
+void histogram(const float* src, long* counts, long size);
+
+/**
+ * @brief the sobel gradients of a row from the row above it and the row below it, with the
+ *        integer weights (1, 2, 1) x (1, 0, -1): with x(j) = (top[j] + bottom[j]) + (mid[j] +
+ *        mid[j]) and y(j) = top[j] - bottom[j], gradX[i] = x(i - 1) - x(i + 1) and
+ *        gradY[i] = (y(i - 1) + y(i + 1)) + (y(i) + y(i)). reads the rows from index -1 to size.
+ */
+void sobelRow(const float* top, const float* mid, const float* bottom, float* gradX,
+              float* gradY, long size);
+
+/**
+ * @brief result[i] = the nearest of 0, 45, 90 and 135 degrees to the angle of the gradient
+ *        (gradX[i], gradY[i]) modulo 180, as 0 to 3: 0 if |gradY[i]| is not above
+ *        tan(22.5) * |gradX[i]| (so for a zero gradient or a nan), 2 if |gradX[i]| is at most
+ *        tan(22.5) * |gradY[i]|, otherwise 1 if gradX[i] and gradY[i] have the same sign and 3 if
+ *        they do not.
+ */
+void quantizeOrientations(const float* gradX, const float* gradY, uint8_t* result, long size);
+
+/**
+ * @return true if every src[i] is an integer of absolute value at most maxAbs (which is below
+ *         2^31) and not -0.
+ */
+bool isIntegral(const float* src, float maxAbs, long size);
+
+/**
+ * @brief result[i] = lhs[i] + rhs[i] saturated to [0, 255], result may be one of the sources.
+ */
+void addArrays(const uint8_t* lhs, const uint8_t* rhs, uint8_t* result, long size);
+
+/**
+ * @brief result[i] = lhs[i] + rhs[i] saturated to [-32768, 32767], result may be one of the
+ *        sources.
+ */
+void addArrays(const int16_t* lhs, const int16_t* rhs, int16_t* result, long size);
+
+/**
+ * @brief result[i] = src[i] * scalar computed in float, rounded to nearest even and saturated
+ *        to [0, 255] (nan to 0), result may be src.
+ */
+void multiplyScalar(const uint8_t* src, float scalar, uint8_t* result, long size);
+
+/**
+ * @brief result[i] = src[i] * scalar computed in float, rounded to nearest even and saturated
+ *        to [-32768, 32767] (nan to -32768), result may be src.
+ */
+void multiplyScalar(const int16_t* src, float scalar, int16_t* result, long size);
+
+/**
+ * @brief the blur of a row of an 8 bit image from the row above it and the row below it:
+ *        result[i] = rint(sum / 16) of the sum of the 3 x 3 neighborhood of i with the weights
+ *        (1, 2, 1) x (1, 2, 1), rounded to nearest even like the float path. computed in 16 bit
+ *        integers, every sum fits. reads the rows from index -1 to size.
+ */
+void blurRow(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom, uint8_t* result,
+             long size);
+
+/**
+ * @brief the sobel of a row of an 8 bit image: result[i] = rint(gradX[i] / 8) + rint(gradY[i] / 8)
+ *        saturated to [0, 255], with the gradients of the float sobelRow, rounded to nearest even
+ *        like the float path. computed in 16 bit integers. reads the rows from index -1 to size.
+ */
+void sobelRow(const uint8_t* top, const uint8_t* mid, const uint8_t* bottom, uint8_t* result,
+              long size);
+
+#endif //SUMMER_EX4_SIMDKERNELS_H
@@ -0,0 +1,101 @@
+#ifndef SUMMER_EX4_SPAN_H
+#define SUMMER_EX4_SPAN_H
+
+/**
+ * @file Span.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief a std::span like view of contiguous elements, and the access check of the unchecked
+ *        Matrix accessors. defining MATRIX_CHECKED_ACCESS at compile time (for debug builds)
+ *        turns the checks on, without it the unchecked accessors and the views do not check at
+ *        all. included by Matrix.h, not meant to be included directly.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <iostream>
+#include <cstdlib>
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @brief the access check of the unchecked accessors, exit the program if the access is not
+ *        valid and MATRIX_CHECKED_ACCESS is defined, does nothing otherwise.
+ * @param isValid true if the access is valid.
+ */
+inline void checkAccess(bool isValid)
+{
+#ifdef MATRIX_CHECKED_ACCESS
+    if(!isValid)
+    {
+        std::cerr << INDEX_OUT_OF_RANGE_ERROR << std::endl;
+        exit(EXIT_FAILURE);
+    }
+#else
+    (void) isValid;
+#endif
+}
+
+/**
+ * @class Span
+ * @brief A non owning view of size contiguous elements of type T, a matrix row or a whole
+ *        matrix buffer. the view must not outlive the matrix it views.
+ */
+template <typename T>
+class Span
+{
+
+public:
+    /**
+     * @brief an empty view.
+     */
+    Span() : _data(nullptr), _size(0) {}
+
+    /**
+     * @brief a view of the size elements from data.
+     */
+    Span(T* data, long size) : _data(data), _size(size) {}
+
+    /**
+     * @brief a read only view from a writable one.
+     */
+    template <typename U>
+    Span(const Span<U>& rhs) : _data(rhs.data()), _size(rhs.size()) {}
+
+    T* data() const { return _data; }
+
+    long size() const { return _size; }
+
+    bool empty() const { return _size == 0; }
+
+    T* begin() const { return _data; }
+
+    T* end() const { return _data + _size; }
+
+    /**
+     * @return the element in the given index, checked only with MATRIX_CHECKED_ACCESS.
+     */
+    T& operator[](long ind) const
+    {
+        checkAccess(0 <= ind && ind < _size);
+        return _data[ind];
+    }
+
+    /**
+     * @return a view of count elements from offset, checked only with MATRIX_CHECKED_ACCESS.
+     */
+    Span subspan(long offset, long count) const
+    {
+        checkAccess(0 <= offset && 0 <= count && offset + count <= _size);
+        return Span(_data + offset, count);
+    }
+
+private:
+    T* _data;
+    long _size;
+};
+
+#endif //SUMMER_EX4_SPAN_H
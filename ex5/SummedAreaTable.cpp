@@ -0,0 +1,192 @@
+/**
+ * @file SummedAreaTable.cpp
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief The integral image implementation.
+ */
+
+#include <algorithm>
+#include "SummedAreaTable.h"
+#include "ThreadPool.h"
+
+// -------------------------- const definitions -------------------------
+
+/**
+ * The number of rows of a task of the window queries.
+ */
+const int WINDOW_BAND_ROWS = 64;
+
+// ------------------------------ functions -----------------------------
+
+SummedAreaTable::SummedAreaTable(const Matrix& image) : _sums(image.getRows() + 1,
+                                                              image.getCols() + 1),
+                                                        _squareSums(image.getRows() + 1,
+                                                                    image.getCols() + 1)
+{
+    build(image);
+}
+
+/**
+ * adds the row of the table above to every row of [firstRow, endRow) of the table.
+ */
+static void _addRowToRows(BasicMatrix<double>& table, const double* above, int firstRow,
+                          int endRow)
+{
+    for(int row = firstRow; row < endRow; ++row)
+    {
+        double* sums = table.rowPtr(row);
+        for(int col = 0; col < table.getCols(); ++col)
+        {
+            sums[col] += above[col];
+        }
+    }
+}
+
+void SummedAreaTable::build(const Matrix& image)
+{
+    int rows = image.getRows();
+    int cols = image.getCols();
+    if(rows != getRows() || cols != getCols())
+    {
+        _sums = BasicMatrix<double>(rows + 1, cols + 1);
+        _squareSums = BasicMatrix<double>(rows + 1, cols + 1);
+    }
+    if(rows == 0)
+    {
+        return;
+    }
+    ThreadPool& pool = ThreadPool::getInstance();
+    int bandRows = (rows + pool.getNumThreads() - 1) / pool.getNumThreads();
+    int numBands = (rows + bandRows - 1) / bandRows;
+    auto bandEnd = [rows, bandRows](int band) { return std::min(rows, (band + 1) * bandRows); };
+
+    //every band from 0, its first row adds the row 0 of the tables, that is 0.
+    pool.parallelFor(numBands, [&](int band)
+    {
+        for(int row = band * bandRows; row < bandEnd(band); ++row)
+        {
+            const float* src = image.rowPtr(row);
+            int above = row == band * bandRows ? 0 : row;
+            const double* sumsAbove = _sums.rowPtr(above);
+            const double* squareSumsAbove = _squareSums.rowPtr(above);
+            double* sums = _sums.rowPtr(row + 1);
+            double* squareSums = _squareSums.rowPtr(row + 1);
+            double sum = 0;
+            double squareSum = 0;
+            for(int col = 0; col < cols; ++col)
+            {
+                sum += src[col];
+                squareSum += (double) src[col] * src[col];
+                sums[col + 1] = sumsAbove[col + 1] + sum;
+                squareSums[col + 1] = squareSumsAbove[col + 1] + squareSum;
+            }
+        }
+    });
+    if(numBands == 1)
+    {
+        return;
+    }
+
+    //the last rows of the bands, in order, then the other rows of every band from the last row
+    //of the band before it.
+    for(int band = 1; band < numBands - 1; ++band)
+    {
+        _addRowToRows(_sums, _sums.rowPtr(band * bandRows), bandEnd(band), bandEnd(band) + 1);
+        _addRowToRows(_squareSums, _squareSums.rowPtr(band * bandRows), bandEnd(band),
+                      bandEnd(band) + 1);
+    }
+    pool.parallelFor(numBands - 1, [&](int bandIndex)
+    {
+        int band = bandIndex + 1;
+        int endRow = band == numBands - 1 ? bandEnd(band) + 1 : bandEnd(band);
+        _addRowToRows(_sums, _sums.rowPtr(band * bandRows), band * bandRows + 1, endRow);
+        _addRowToRows(_squareSums, _squareSums.rowPtr(band * bandRows), band * bandRows + 1,
+                      endRow);
+    });
+}
+
+double SummedAreaTable::sum(int firstRow, int firstCol, int endRow, int endCol) const
+{
+    firstRow = std::min(std::max(firstRow, 0), getRows());
+    firstCol = std::min(std::max(firstCol, 0), getCols());
+    endRow = std::min(std::max(endRow, firstRow), getRows());
+    endCol = std::min(std::max(endCol, firstCol), getCols());
+    return _sums(endRow, endCol) - _sums(endRow, firstCol) - _sums(firstRow, endCol) +
+           _sums(firstRow, firstCol);
+}
+
+double SummedAreaTable::squareSum(int firstRow, int firstCol, int endRow, int endCol) const
+{
+    firstRow = std::min(std::max(firstRow, 0), getRows());
+    firstCol = std::min(std::max(firstCol, 0), getCols());
+    endRow = std::min(std::max(endRow, firstRow), getRows());
+    endCol = std::min(std::max(endCol, firstCol), getCols());
+    return _squareSums(endRow, endCol) - _squareSums(endRow, firstCol) -
+           _squareSums(firstRow, endCol) + _squareSums(firstRow, firstCol);
+}
+
+template <typename WindowValue>
+Matrix SummedAreaTable::_mapWindows(int radius, WindowValue windowValue) const
+{
+    if(radius < 0)
+    {
+        exitWithError(INVALID_DIMENSIONS_ERROR);
+    }
+    int rows = getRows();
+    int cols = getCols();
+    Matrix result(rows, cols);
+    ThreadPool::getInstance().parallelFor((rows + WINDOW_BAND_ROWS - 1) / WINDOW_BAND_ROWS,
+                                          [&](int band)
+    {
+        int endRow = std::min(rows, (band + 1) * WINDOW_BAND_ROWS);
+        for(int row = band * WINDOW_BAND_ROWS; row < endRow; ++row)
+        {
+            int top = std::max(0, row - radius);
+            int bottom = (int) std::min((long) rows, (long) row + radius + 1);
+            const double* topSums = _sums.rowPtr(top);
+            const double* bottomSums = _sums.rowPtr(bottom);
+            const double* topSquareSums = _squareSums.rowPtr(top);
+            const double* bottomSquareSums = _squareSums.rowPtr(bottom);
+            float* dst = result.rowPtr(row);
+            for(int col = 0; col < cols; ++col)
+            {
+                int left = std::max(0, col - radius);
+                int right = (int) std::min((long) cols, (long) col + radius + 1);
+                double sum = bottomSums[right] - bottomSums[left] - topSums[right] + topSums[left];
+                double squareSum = bottomSquareSums[right] - bottomSquareSums[left] -
+                                   topSquareSums[right] + topSquareSums[left];
+                dst[col] = (float) windowValue(sum, squareSum,
+                                               (double) (bottom - top) * (right - left));
+            }
+        }
+    });
+    return result;
+}
+
+Matrix SummedAreaTable::boxFilter(int radius) const
+{
+    double windowSize = ((double) 2 * radius + 1) * ((double) 2 * radius + 1);
+    return _mapWindows(radius, [windowSize](double sum, double, double)
+    {
+        return sum / windowSize;
+    });
+}
+
+Matrix SummedAreaTable::localMean(int radius) const
+{
+    return _mapWindows(radius, [](double sum, double, double size)
+    {
+        return sum / size;
+    });
+}
+
+Matrix SummedAreaTable::localVariance(int radius) const
+{
+    return _mapWindows(radius, [](double sum, double squareSum, double size)
+    {
+        double mean = sum / size;
+        return std::max(0., squareSum / size - mean * mean);
+    });
+}
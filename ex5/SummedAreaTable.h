@@ -0,0 +1,123 @@
+#ifndef SUMMER_EX4_SUMMEDAREATABLE_H
+#define SUMMER_EX4_SUMMEDAREATABLE_H
+
+/**
+ * @file SummedAreaTable.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief header file of SummedAreaTable.cpp, the integral image of a frame. it is built once in
+ *        a parallel pass, then the sum of any rectangle costs 4 reads, so box filters, local
+ *        means and local variances of any radius cost O(1) per coordinate, and the same table
+ *        answers all the queries on the frame.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include "Matrix.h"
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @class SummedAreaTable
+ * @brief The sums and the sums of squares of the coordinates of an image above and left of
+ *        every coordinate, in double, so the sums of an image of integers are exact. the image
+ *        must be finite, a nan or inf spreads over the sums of the windows after it.
+ */
+class SummedAreaTable
+{
+
+public:
+    /**
+     * @brief The class constructor - builds the tables of the image, see build.
+     * @param image the image.
+     */
+    explicit SummedAreaTable(const Matrix& image);
+
+    /**
+     * @fn SummedAreaTable::build(const Matrix& image);
+     * @brief builds the tables of a new image, like a new frame of a video, the memory of the
+     *        tables is reused if its dimensions are the ones of the previous image. the rows are
+     *        split to a band per thread of the pool, each band is summed in one pass from its
+     *        own first row, and then the last row of the bands before it is added to it.
+     * @param image the image.
+     */
+    void build(const Matrix& image);
+
+    /**
+    *@fn SummedAreaTable::getRows()const
+    *@return the number of rows of the image.
+    */
+    int getRows() const { return _sums.getRows() - 1; }
+
+    /**
+    *@fn SummedAreaTable::getCols()const
+    *@return the number of columns of the image.
+    */
+    int getCols() const { return _sums.getCols() - 1; }
+
+    /**
+     * @fn SummedAreaTable::sum(int firstRow, int firstCol, int endRow, int endCol)const;
+     * @return the sum of the coordinates of the rows [firstRow, endRow) and the columns
+     *         [firstCol, endCol) of the image, the part of the rectangle outside the image counts
+     *         as 0.
+     */
+    double sum(int firstRow, int firstCol, int endRow, int endCol) const;
+
+    /**
+     * @fn SummedAreaTable::squareSum(int firstRow, int firstCol, int endRow, int endCol)const;
+     * @return the sum of the squares of the coordinates of the rectangle, see sum.
+     */
+    double squareSum(int firstRow, int firstCol, int endRow, int endCol) const;
+
+    /**
+     * @fn SummedAreaTable::boxFilter(int radius)const;
+     * @brief the sum of the (2 * radius + 1) x (2 * radius + 1) window around every coordinate
+     *        over the size of the window, with the coordinates outside the image as 0, like
+     *        convolve with boxKernel(radius). exit the program if radius is negative.
+     * @return the filtered image, not rounded.
+     */
+    Matrix boxFilter(int radius) const;
+
+    /**
+     * @fn SummedAreaTable::localMean(int radius)const;
+     * @brief the mean of the coordinates of the window around every coordinate that are inside
+     *        the image, see boxFilter.
+     */
+    Matrix localMean(int radius) const;
+
+    /**
+     * @fn SummedAreaTable::localVariance(int radius)const;
+     * @brief the variance of the coordinates of the window around every coordinate that are
+     *        inside the image, see localMean.
+     */
+    Matrix localVariance(int radius) const;
+
+private:
+
+    /**
+    *@memberof SummedAreaTable::_sums
+    *@brief _sums(row, col) is the sum of the image coordinates above row and left of col, the
+    *       first row and column are 0.
+    */
+    BasicMatrix<double> _sums;
+
+    /**
+    *@memberof SummedAreaTable::_squareSums
+    *@brief the sums of the squares of the image coordinates, like _sums.
+    */
+    BasicMatrix<double> _squareSums;
+
+    /**
+     * @fn SummedAreaTable::_mapWindows(int radius, WindowValue windowValue)const;
+     * @brief result(row, col) = windowValue(sum, squareSum, size) of the window around (row, col)
+     *        clipped to the image, size is the number of its coordinates. on the threads of the
+     *        pool, a band of rows per task. exit the program if radius is negative.
+     */
+    template <typename WindowValue>
+    Matrix _mapWindows(int radius, WindowValue windowValue) const;
+};
+
+#endif //SUMMER_EX4_SUMMEDAREATABLE_H
@@ -7,6 +7,8 @@
 *******************************************************************************/
 
 #include "TestMatrix.h"
+//the filters are a source file included by their driver, see Filters.cpp.
+#include "Filters.cpp"
 using namespace std;
 
 extern "C" void exit(int status) {
@@ -172,6 +174,112 @@ void TestMatrix::testOperatorAssignment()
     cout << "Passed test operator=" << endl;
 }
 
+void TestMatrix::testMoveSemantics()
+{
+    //a 4K frame, every buffer copy would show in the allocation count.
+    int ROWS = 2160, COLS = 3840;
+    Matrix frame(ROWS, COLS);
+    frame(1, 2) = 3;
+
+    Matrix::resetAllocationCount();
+    Matrix moved(std::move(frame));
+    assert(Matrix::getAllocationCount() == 0 && "Failed: move constructor allocated");
+    assert(moved(1, 2) == 3 && moved.getRows() == ROWS && moved.getCols() == COLS);
+    assert(frame.getRows() == 0 && frame.getCols() == 0 && "Failed: moved from matrix not empty");
+
+    Matrix other(2, 2);
+    Matrix::resetAllocationCount();
+    other = std::move(moved);
+    swap(other, moved);
+    std::swap(other, moved);
+    assert(Matrix::getAllocationCount() == 0 && "Failed: move assignment or swap allocated");
+    assert(other(1, 2) == 3 && other.getRows() == ROWS);
+
+    //a chain of operations allocates only the buffers it returns.
+    Matrix::resetAllocationCount();
+    Matrix result = (other + other) * 0.5f / 2.f;
+    assert(Matrix::getAllocationCount() == 1 && "Failed: expression chain made temporaries");
+    result = result + other;
+    result += other * 2.f;
+    result *= 3.f;
+    assert(Matrix::getAllocationCount() == 1 && "Failed: in place operations allocated");
+
+    Matrix vec(COLS, 1);
+    Matrix::resetAllocationCount();
+    Matrix product = other * vec;
+    product *= Matrix(1, 1);
+    assert(Matrix::getAllocationCount() == 3 && "Failed: matrix multiplication copied a buffer");
+
+    //a filter chain on the frame allocates its three results, no kernels or copies.
+    Matrix::resetAllocationCount();
+    Matrix filtered = quantization(sobel(blur(other)), 16);
+    assert(Matrix::getAllocationCount() == 3 && "Failed: filter chain made redundant copies");
+    assert(filtered.getRows() == ROWS && filtered.getCols() == COLS);
+
+    cout << "Passed testMoveSemantics" << endl;
+}
+
+void TestMatrix::testAllocators()
+{
+    int ROWS = 480, COLS = 640;
+    Matrix frame(ROWS, COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        frame[i] = i % 256;
+    }
+
+    //a frame loop on a pool, only the first frame touches the system heap.
+    PoolAllocator pool;
+    Matrix::setDefaultAllocator(&pool);
+    for(int i = 0; i < 5; ++i)
+    {
+        if(i == 1)
+        {
+            pool.resetStats();
+        }
+        Matrix scaled = frame * 0.5f;
+        Matrix sum = scaled + frame;
+        Matrix copied(sum);
+        copied += scaled;
+        assert(&copied.getAllocator() == &pool);
+    }
+    AllocationStats poolStats = pool.getStats();
+    assert(poolStats.requests == 12 && "Failed: testAllocators pool requests");
+    assert(poolStats.systemAllocations == 0 && "Failed: testAllocators steady pool allocated");
+    assert(poolStats.bytesInUse == 0);
+    Matrix::setDefaultAllocator(nullptr);
+    assert(&Matrix(1, 1).getAllocator() == &Matrix::getDefaultAllocator());
+
+    //a per frame arena, freed at once.
+    FrameArena arena(1L << 20);
+    for(int i = 0; i < 5; ++i)
+    {
+        if(i == 1)
+        {
+            arena.resetStats();
+        }
+        {
+            Matrix scaled(ROWS, COLS, arena);
+            scaled = frame * 2.f;
+            Matrix small(3, 3, arena);
+            small(2, 2) = 1;
+            assert(scaled[7] == frame[7] * 2.f && small(2, 2) == 1);
+        }
+        arena.reset();
+    }
+    AllocationStats arenaStats = arena.getStats();
+    assert(arenaStats.requests == 8 && "Failed: testAllocators arena requests");
+    assert(arenaStats.systemAllocations == 0 && "Failed: testAllocators steady arena allocated");
+    assert(arenaStats.bytesInUse == 0);
+
+    //moving keeps the allocator.
+    Matrix fromPool(2, 2, pool);
+    Matrix moved(std::move(fromPool));
+    assert(&moved.getAllocator() == &pool);
+
+    cout << "Passed testAllocators" << endl;
+}
+
 // getters
 
 void TestMatrix::testGetters()
@@ -493,6 +601,41 @@ void TestMatrix::testInvalidOperatorParenthesis4()
             "not colsed the program" << endl;
 }
 
+void TestMatrix::testUncheckedAccess()
+{
+    int ROWS = 3, COLS = 4;
+    Matrix mat(ROWS, COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        mat.uncheckedAt((long) i) = i * 1.5f;
+    }
+    const Matrix& constMat = mat;
+
+    assert(mat.uncheckedAt(2, 1) == mat(2, 1) && constMat.uncheckedAt(1, 3) == 10.5f);
+    assert(mat.rowPtr(2)[3] == mat(2, 3) && constMat.rowPtr(1) == &mat(1, 0));
+
+    Span<const float> row = constMat.getRow(1);
+    assert(row.size() == COLS && row[0] == 6 && row.end() - row.begin() == COLS);
+    assert(row.subspan(1, 2).size() == 2 && row.subspan(1, 2)[1] == 9);
+
+    Span<float> row2 = mat.getRow(2);
+    for(float& val : row2)
+    {
+        val = -1;
+    }
+    assert(mat(2, 0) == -1 && mat(2, 3) == -1 && mat(1, 3) == 10.5f);
+
+    float sum = 0;
+    for(float val : constMat.getData())
+    {
+        sum += val;
+    }
+    assert(sum == 0 + 1.5f + 3 + 4.5f + 6 + 7.5f + 9 + 10.5f - 4 &&
+           constMat.getData().size() == 12);
+
+    cout << "Passed testUncheckedAccess" << endl;
+}
+
 //test Addition
 
 void TestMatrix::testAddition()
@@ -772,6 +915,137 @@ void TestMatrix::testInvalidMultiplications2()
             "matrices with not valid dimension not closed the program" << endl;
 }
 
+void TestMatrix::testBigMultiplication()
+{
+    //big enough for the blocked kernel, with edges that do not fit the kernel tiles.
+    int ROWS = 131, INNER = 300, COLS = 77;
+    Matrix mat1(ROWS, INNER);
+    Matrix mat2(INNER, COLS);
+    for(int i = 0; i < ROWS * INNER; ++i)
+    {
+        mat1[i] = i % 7 - 3;
+    }
+    for(int i = 0; i < INNER * COLS; ++i)
+    {
+        mat2[i] = i % 5 * 0.5;
+    }
+
+    Matrix res = mat1 * mat2;
+    assert(res.getRows() == ROWS && res.getCols() == COLS);
+    for(int row = 0; row < ROWS; ++row)
+    {
+        for(int col = 0; col < COLS; ++col)
+        {
+            float expected = 0;
+            for(int k = 0; k < INNER; ++k)
+            {
+                expected += mat1(row, k) * mat2(k, col);
+            }
+            //all the products and sums are exact, so the order does not matter.
+            assert(res(row, col) == expected && "Failed: testBigMultiplication wrong value");
+        }
+    }
+
+    cout << "Passed testBigMultiplication" << endl;
+}
+
+void TestMatrix::testDeterministicMultiplication()
+{
+    //few result tiles and a long depth, the case that splits the depth between threads.
+    int ROWS = 40, INNER = 6000, COLS = 50;
+    Matrix mat1(ROWS, INNER);
+    Matrix mat2(INNER, COLS);
+    for(int i = 0; i < ROWS * INNER; ++i)
+    {
+        mat1[i] = (i % 1000) * 0.001f - 0.5f;
+    }
+    for(int i = 0; i < INNER * COLS; ++i)
+    {
+        mat2[i] = (i % 997) * 0.003f - 1.f;
+    }
+
+    //an odd last row block, whose tiles are small when there are many threads.
+    int ODD_ROWS = 97, ODD_INNER = 256, ODD_COLS = 1024;
+    Matrix oddMat1(ODD_ROWS, ODD_INNER);
+    Matrix oddMat2(ODD_INNER, ODD_COLS);
+    for(int i = 0; i < ODD_ROWS * ODD_INNER; ++i)
+    {
+        oddMat1[i] = (i % 1009) * 0.0013f - 0.6f;
+    }
+    for(int i = 0; i < ODD_INNER * ODD_COLS; ++i)
+    {
+        oddMat2[i] = (i % 983) * 0.0029f - 1.3f;
+    }
+
+    int poolThreads = ThreadPool::getInstance().getNumThreads();
+    bool wasDeterministic = Matrix::isDeterministic();
+    Matrix::setDeterministic(true);
+    ThreadPool::setNumThreads(1);
+    Matrix expected = mat1 * mat2;
+    Matrix oddExpected = oddMat1 * oddMat2;
+    int threads[] = {2, 3, 8, 32};
+    for(int numThreads : threads)
+    {
+        ThreadPool::setNumThreads(numThreads);
+        Matrix product = mat1 * mat2;
+        assert(std::memcmp(product.rowPtr(0), expected.rowPtr(0),
+                           (long) ROWS * COLS * sizeof(float)) == 0 &&
+               "Failed: deterministic product depends on threads");
+        Matrix oddProduct = oddMat1 * oddMat2;
+        assert(std::memcmp(oddProduct.rowPtr(0), oddExpected.rowPtr(0),
+                           (long) ODD_ROWS * ODD_COLS * sizeof(float)) == 0 &&
+               "Failed: deterministic product of an odd row block depends on threads");
+    }
+    Matrix::setDeterministic(wasDeterministic);
+    ThreadPool::setNumThreads(poolThreads);
+
+    cout << "Passed testDeterministicMultiplication" << endl;
+}
+
+void TestMatrix::testLimitedParallelFor()
+{
+    int NUM_TASKS = 64;
+    int poolThreads = ThreadPool::getInstance().getNumThreads();
+    ThreadPool::setNumThreads(4);
+    ThreadPool& pool = ThreadPool::getInstance();
+
+    int limits[] = {1, 2, 3, 4, 8};
+    for(int maxThreads : limits)
+    {
+        std::mutex mutex;
+        std::set<std::thread::id> threadIds;
+        std::vector<int> runs(NUM_TASKS, 0);
+        pool.parallelFor(NUM_TASKS, [&](int task)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threadIds.insert(std::this_thread::get_id());
+            ++runs[task];
+        }, maxThreads);
+        for(int i = 0; i < NUM_TASKS; ++i)
+        {
+            assert(runs[i] == 1 && "Failed: limited parallelFor task did not run once");
+        }
+        assert((int) threadIds.size() <= maxThreads && "Failed: parallelFor used too many threads");
+        if(maxThreads == 1)
+        {
+            assert(threadIds.count(std::this_thread::get_id()) == 1
+                   && "Failed: parallelFor of one thread did not run on the caller");
+        }
+    }
+
+    try
+    {
+        pool.parallelFor(NUM_TASKS, [](int) {}, 0);
+        assert(false && "Failed: parallelFor accepted no threads");
+    }
+    catch(int e)
+    {
+    }
+    ThreadPool::setNumThreads(poolThreads);
+
+    cout << "Passed testLimitedParallelFor" << endl;
+}
+
 //test Division
 
 void TestMatrix::testDivision()
@@ -873,6 +1147,280 @@ void TestMatrix::testInvalidDivision2()
     cout << "Failed: in testInvalidDivision2, mat /= 0 not closed the program" << endl;
 }
 
+void TestMatrix::testSimdLevels()
+{
+    //odd size so every kernel runs its scalar tail too.
+    int ROWS = 37, COLS = 29, SIZE = ROWS * COLS;
+    Matrix mat1(ROWS, COLS);
+    Matrix mat2(ROWS, COLS);
+    for(int i = 0; i < SIZE; ++i)
+    {
+        mat1[i] = i * 0.37f - 100;
+        mat2[i] = 1.f / (i + 1);
+    }
+
+    //a table lookup clamps to the table, nan takes the first entry.
+    float table[256];
+    for(int i = 0; i < 256; ++i)
+    {
+        table[i] = i * 2.f + 1;
+    }
+    float lookupSrc[] = {-5.f, 0.f, 0.5f, 17.9f, 254.f, 255.5f, 300.f, NAN, -0.f, 1e10f, 128.f,
+                         3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f};
+    float lookupExpected[] = {1.f, 1.f, 1.f, 35.f, 509.f, 511.f, 511.f, 1.f, 1.f, 511.f, 257.f,
+                              7.f, 9.f, 11.f, 13.f, 15.f, 17.f, 19.f, 21.f};
+    const int LOOKUP_SIZE = sizeof(lookupSrc) / sizeof(float);
+    long expectedCounts[256] = {};
+    for(int i = 0; i < LOOKUP_SIZE; ++i)
+    {
+        ++expectedCounts[(int) (lookupExpected[i] - 1) / 2];
+    }
+
+    //a zero or nan gradient is horizontal, the diagonals by the signs of the axes.
+    float gradX[] = {0.f, 5.f, 0.f, 3.f, -3.f, 3.f, 1.f, NAN, -4.f, 2.f, 0.4f, -1.f, 1.f, -7.f,
+                     10.f, 3.f, -5.f};
+    float gradY[] = {0.f, 1.f, -6.f, 3.f, 3.f, -3.f, 2.5f, 1.f, -4.f, 0.82f, 1.f, -0.4f, 0.f,
+                     9.f, -10.f, 7.f, NAN};
+    uint8_t orientationsExpected[] = {0, 0, 2, 1, 3, 3, 2, 0, 1, 0, 2, 0, 0, 3, 3, 1, 0};
+    const int ORIENTATIONS_SIZE = sizeof(orientationsExpected);
+
+    SimdLevel bestLevel = detectSimdLevel();
+    setSimdLevel(SIMD_SCALAR);
+    Matrix gradXExpected(1, COLS - 2);
+    Matrix gradYExpected(1, COLS - 2);
+    sobelRow(mat1.rowPtr(0) + 1, mat1.rowPtr(1) + 1, mat1.rowPtr(2) + 1, gradXExpected.rowPtr(0),
+             gradYExpected.rowPtr(0), COLS - 2);
+    Matrix expectedSum = mat1 + mat2;
+    Matrix expectedMult = 1.5f * mat1;
+    Matrix expectedDiv = mat1 / 0.3f;
+    Matrix expectedSelf(mat1);
+    ((expectedSelf += mat2) *= 0.7f) /= 3.f;
+    expectedSelf += 2.5f;
+
+    SimdLevel levels[] = {SIMD_SSE2, SIMD_AVX2, SIMD_AVX512};
+    for(SimdLevel level : levels)
+    {
+        setSimdLevel(level);
+        assert(mat1 + mat2 == expectedSum && "Failed: testSimdLevels operator+");
+        assert(1.5f * mat1 == expectedMult && "Failed: testSimdLevels float*matrix");
+        assert(mat1 / 0.3f == expectedDiv && "Failed: testSimdLevels operator/");
+        Matrix self(mat1);
+        ((self += mat2) *= 0.7f) /= 3.f;
+        self += 2.5f;
+        assert(self == expectedSelf && "Failed: testSimdLevels self operators");
+        float lookupResult[LOOKUP_SIZE];
+        lookupTable(lookupSrc, table, lookupResult, LOOKUP_SIZE);
+        assert(std::memcmp(lookupResult, lookupExpected, sizeof(lookupResult)) == 0 &&
+               "Failed: testSimdLevels lookupTable");
+        long counts[256] = {};
+        histogram(lookupSrc, counts, LOOKUP_SIZE);
+        assert(std::memcmp(counts, expectedCounts, sizeof(counts)) == 0 &&
+               "Failed: testSimdLevels histogram");
+        Matrix gradXResult(1, COLS - 2);
+        Matrix gradYResult(1, COLS - 2);
+        sobelRow(mat1.rowPtr(0) + 1, mat1.rowPtr(1) + 1, mat1.rowPtr(2) + 1,
+                 gradXResult.rowPtr(0), gradYResult.rowPtr(0), COLS - 2);
+        assert(gradXResult == gradXExpected && gradYResult == gradYExpected &&
+               "Failed: testSimdLevels sobelRow");
+        uint8_t orientations[ORIENTATIONS_SIZE];
+        quantizeOrientations(gradX, gradY, orientations, ORIENTATIONS_SIZE);
+        assert(std::memcmp(orientations, orientationsExpected, ORIENTATIONS_SIZE) == 0 &&
+               "Failed: testSimdLevels quantizeOrientations");
+    }
+    setSimdLevel(bestLevel);
+
+    //the scalar is a float, not truncated to an int.
+    assert((0.5f * mat1)[2] == mat1[2] * 0.5f && "Failed: float*matrix truncated the scalar");
+    assert((mat1 / 0.5f)[2] == mat1[2] * 2 && "Failed: division by 0.5 failed");
+
+    cout << "Passed testSimdLevels" << endl;
+}
+
+void TestMatrix::testExpressions()
+{
+    int ROWS = 5, COLS = 7, SIZE = ROWS * COLS;
+    Matrix a(ROWS, COLS);
+    Matrix b(ROWS, COLS);
+    Matrix c(ROWS, COLS);
+    for(int i = 0; i < SIZE; ++i)
+    {
+        a[i] = i * 0.5f;
+        b[i] = i * 1.25f - 3;
+        c[i] = 100.f / (i + 1);
+    }
+
+    Matrix res = a + b + c * 2.f;
+    assert(res.getRows() == ROWS && res.getCols() == COLS);
+    for(int i = 0; i < SIZE; ++i)
+    {
+        float expected = a[i] + b[i];
+        expected = expected + c[i] * 2.f;
+        assert(res[i] == expected && "Failed: testExpressions a + b + c * 2");
+    }
+
+    Matrix fused = (a + b) / 4.f + 3 * c;
+    for(int i = 0; i < SIZE; ++i)
+    {
+        float expected = (a[i] + b[i]) / 4.f;
+        expected = expected + c[i] * 3;
+        assert(fused[i] == expected && "Failed: testExpressions (a + b) / 4 + 3 * c");
+    }
+
+    //the assigned matrix appears in the expression.
+    Matrix aliased(a);
+    aliased = b + aliased * 2.f;
+    aliased += aliased / 2.f + c;
+    for(int i = 0; i < SIZE; ++i)
+    {
+        float expected = b[i] + a[i] * 2.f;
+        expected = expected + (expected / 2.f + c[i]);
+        assert(aliased[i] == expected && "Failed: testExpressions aliasing");
+    }
+
+    //assignment to a matrix of another size, and the matrix multiplication of an expression.
+    Matrix other;
+    other = a * 2.f;
+    assert(other.getRows() == ROWS && other.getCols() == COLS && other[3] == a[3] * 2.f);
+    Matrix vec(COLS, 1);
+    vec[0] = 1;
+    Matrix firstCol = (a + b) * vec;
+    assert(firstCol.getRows() == ROWS && firstCol(1, 0) == a(1, 0) + b(1, 0));
+    assert((a + b) == (b + a) && (a * 2.f)(1, 1) == a(1, 1) * 2.f);
+
+    cout << "Passed testExpressions" << endl;
+}
+
+void TestMatrix::testElementTypes()
+{
+    //uint8 saturates and rounds to nearest even, the vectorized and the scalar kernels agree.
+    int SIZE = 37;
+    BasicMatrix<uint8_t> img(1, SIZE);
+    BasicMatrix<uint8_t> other(1, SIZE);
+    for(int i = 0; i < SIZE; ++i)
+    {
+        img[i] = (uint8_t) (i * 7);
+        other[i] = (uint8_t) (250 - i);
+    }
+    for(SimdLevel level : {SIMD_SCALAR, SIMD_AVX512})
+    {
+        setSimdLevel(level);
+        BasicMatrix<uint8_t> sum = img + other;
+        BasicMatrix<uint8_t> scaled = img * 1.5f;
+        for(int i = 0; i < SIZE; ++i)
+        {
+            assert(sum[i] == std::min(255, i * 7 + 250 - i) && "Failed: uint8 saturating sum");
+            assert(scaled[i] == (uint8_t) std::min(255.f, std::rint(i * 7 * 1.5f))
+                   && "Failed: uint8 scaling");
+        }
+    }
+    setSimdLevel(detectSimdLevel());
+    BasicMatrix<uint8_t> halves(1, 2);
+    halves[0] = 1;
+    halves[1] = 3;
+    halves *= 0.5f; //0.5 and 1.5 round to the even 0 and 2.
+    assert(halves[0] == 0 && halves[1] == 2 && "Failed: uint8 ties to even");
+    halves *= -1.f;
+    assert(halves[1] == 0 && "Failed: uint8 saturates negatives to 0");
+
+    //int16 saturates at both ends, and the product sums in 64 bits before it saturates.
+    BasicMatrix<int16_t> shorts(2, 2);
+    shorts[0] = 30000;
+    shorts[1] = -30000;
+    shorts[2] = 1;
+    shorts[3] = 2;
+    BasicMatrix<int16_t> doubled = shorts + shorts;
+    assert(doubled[0] == 32767 && doubled[1] == -32768 && doubled[3] == 4);
+    BasicMatrix<int16_t> product = shorts * shorts;
+    assert(product(0, 0) == 32767 && product(0, 1) == -32768 && "Failed: int16 product saturates");
+    assert(product(1, 0) == 30002 && product(1, 1) == -29996 && "Failed: int16 product");
+    BasicMatrix<int16_t> row(1, 2);
+    BasicMatrix<int16_t> col(2, 1);
+    row[0] = 20000;
+    row[1] = 20000;
+    col[0] = 2;
+    col[1] = -1;
+    assert((row * col)[0] == 20000 && "Failed: int16 product saturated a partial sum");
+
+    //double keeps the precision float loses.
+    BasicMatrix<double> precise(1, 1);
+    precise[0] = 1e-10;
+    precise += 1.;
+    assert(precise[0] != 1. && precise[0] - 1. < 1.1e-10 && "Failed: double precision");
+    BasicMatrix<double> squared = precise * precise;
+    assert(squared[0] == precise[0] * precise[0]);
+
+    //half stores 11 significant bits and rounds to nearest even.
+    BasicMatrix<Half> halfMat(1, 3);
+    halfMat[0] = 2049.f; //between 2048 and 2050, the tie goes to the even 2048.
+    halfMat[1] = 65519.f;
+    halfMat[2] = 1e-8f;
+    assert((float) halfMat[0] == 2048.f && (float) halfMat[1] == 65504.f);
+    assert((float) halfMat[2] == 0.f && Half(1e-7f).getBits() == 2);
+    assert((float) Half(70000.f) == INFINITY && (float) Half(-0.f) == 0.f);
+    halfMat *= 2.f;
+    assert((float) halfMat[0] == 4096.f && (float) halfMat[1] == INFINITY);
+    halfMat[1] = 0.5f;
+    BasicMatrix<Half> identity(3, 3);
+    for(int i = 0; i < 3; ++i)
+    {
+        identity(i, i) = 1.f;
+    }
+    assert((halfMat * identity) == halfMat && "Failed: half product");
+
+    //the stream operators read and write numbers, not characters.
+    stringstream stream;
+    stream << img * 1.f;
+    BasicMatrix<uint8_t> parsed(1, SIZE);
+    stream >> parsed;
+    assert(parsed == img && "Failed: uint8 stream round trip");
+
+    cout << "Passed testElementTypes" << endl;
+}
+
+void TestMatrix::testFixedMatrix()
+{
+    //the whole arithmetic runs at compile time.
+    constexpr FixedMatrix<2, 3> lhs(1, 2, 3, 4, 5, 6);
+    constexpr FixedMatrix<3, 2> rhs = lhs.transpose();
+    constexpr FixedMatrix<2, 2> product = lhs * rhs;
+    static_assert(product == FixedMatrix<2, 2>(14, 32, 32, 77), "Failed: constexpr product");
+    static_assert(FixedMatrix<3, 3>::identity() * rhs == rhs, "Failed: constexpr identity");
+    static_assert((lhs + lhs)(1, 2) == 12.f && (2.f * lhs / 4.f)[1] == 1.f,
+                  "Failed: constexpr element-wise operations");
+    static_assert(sizeof(FixedMatrix<3, 3>) == 9 * sizeof(float), "Failed: FixedMatrix size");
+
+    //the conversions from and to Matrix.
+    Matrix dynamic = lhs.toMatrix();
+    assert(dynamic.getRows() == 2 && dynamic.getCols() == 3 && dynamic(1, 0) == 4.f);
+    assert((FixedMatrix<2, 3>::fromMatrix(dynamic) == lhs) && "Failed: FixedMatrix round trip");
+    Matrix fromProduct = lhs * rhs.toMatrix();
+    assert((FixedMatrix<2, 2>::fromMatrix(fromProduct) == product)
+           && "Failed: FixedMatrix * Matrix");
+    try
+    {
+        FixedMatrix<3, 3>::fromMatrix(dynamic);
+        assert(false && "Failed: fromMatrix accepted wrong dimensions");
+    }
+    catch(int e)
+    {
+    }
+
+    //a color transform of pixels stored one per column.
+    constexpr FixedMatrix<3, 3> swapRedBlue(0, 0, 1,
+                                            0, 1, 0,
+                                            1, 0, 0);
+    Matrix pixels(3, 4);
+    for(int i = 0; i < 12; ++i)
+    {
+        pixels[i] = (float) i;
+    }
+    Matrix swapped = swapRedBlue * pixels;
+    assert(swapped(0, 1) == pixels(2, 1) && swapped(2, 3) == pixels(0, 3)
+           && swapped(1, 2) == pixels(1, 2) && "Failed: FixedMatrix color transform");
+
+    cout << "Passed testFixedMatrix" << endl;
+}
+
 //test equality operations == !=
 
 void TestMatrix::testEqualityOp()
@@ -1032,8 +1580,1152 @@ void TestMatrix::testInvalidInStream()
             "closed the program" << endl;
 }
 
+void TestMatrix::testBufferedOutStream()
+{
+    //the buffered writer writes the bytes of the per value 'os << value'.
+    int ROWS = 70, COLS = 1000;
+    Matrix mat(ROWS, COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        mat[i] = (i % 7 == 0) ? (float) (i % 300) : (i - 35000) * 1.37e-3f * (float) (i % 11);
+    }
+    mat[1] = -0.f;
+    mat[2] = 1e-45f;
+    mat[3] = 999999.5f;
+    mat[4] = INFINITY;
+    mat[5] = 123456789.f;
+    stringstream expected;
+    for(int row = 0; row < ROWS; ++row)
+    {
+        for(int col = 0; col < COLS; ++col)
+        {
+            expected << (col == 0 ? "" : " ") << mat(row, col);
+        }
+        if(row != ROWS - 1)
+        {
+            expected << endl;
+        }
+    }
+    stringstream written;
+    written << mat;
+    assert(written.str() == expected.str() && "Failed: buffered writer bytes");
+
+    //a stream with its own format keeps it.
+    stringstream precise;
+    precise.precision(9);
+    precise << mat;
+    stringstream value;
+    value.precision(9);
+    value << mat[7];
+    assert(precise.str().find(value.str()) != string::npos && "Failed: writer ignored precision");
+
+    //the other element types print numbers.
+    BasicMatrix<uint8_t> img(2, 2);
+    img[0] = 255;
+    img[3] = 7;
+    stringstream imgStream;
+    imgStream << img;
+    assert(imgStream.str() == "255 0\n0 7" && "Failed: uint8 writer");
+
+    //a matrix without columns is a line per row, more than a chunk of them.
+    Matrix empty(70000, 0);
+    stringstream emptyStream;
+    emptyStream << empty;
+    assert(emptyStream.str() == string(69999, '\n') && "Failed: writer without columns");
+
+    cout << "Passed testBufferedOutStream" << endl;
+}
+
+void TestMatrix::testBulkInStream()
+{
+    //the bulk reader stops where 'is >> value' stops, and leaves the rest of the stream there.
+    stringstream stream("+1.5 -2e1\n.25\t7 1e abc");
+    Matrix mat(2, 3);
+    stream >> mat;
+    assert(mat[0] == 1.5f && mat[1] == -20.f && mat[2] == .25f && mat[3] == 7.f);
+    assert(mat[4] == 0.f && stream.fail() && !stream.eof() && "Failed: bulk reader rejected 1e");
+    stream.clear();
+    string rest;
+    stream >> rest;
+    assert(rest == "abc" && "Failed: bulk reader stream position");
+
+    stringstream underflow("1e-50 1e-40 3.4e39 5");
+    Matrix small(1, 4);
+    underflow >> small;
+    assert(small[0] == 0.f && small[1] == 1e-40f && small[2] == 0.f && underflow.fail());
+
+    //more values than the matrix exits the program.
+    stringstream tooMany("1 2 3");
+    Matrix pair(1, 2);
+    try
+    {
+        tooMany >> pair;
+        assert(false && "Failed: bulk reader read more values than the matrix");
+    }
+    catch(int e)
+    {
+    }
+
+    //a big input crosses the chunks of the reader.
+    int ROWS = 300, COLS = 1000;
+    stringstream bigStream;
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        bigStream << i * 0.37f << (i % COLS == COLS - 1 ? "\n" : " ");
+    }
+    Matrix big(ROWS, COLS);
+    bigStream >> big;
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        stringstream expected;
+        expected << i * 0.37f;
+        float expectedVal;
+        expected >> expectedVal;
+        assert(big[i] == expectedVal && "Failed: bulk reader big input");
+    }
+    assert(bigStream.eof());
+
+    cout << "Passed testBulkInStream" << endl;
+}
+
+void TestMatrix::testBinaryFile()
+{
+    //a saved matrix maps back bit identical, without any allocation.
+    const char* path = "binaryMatrix.bin";
+    Matrix mat(37, 53);
+    for(int i = 0; i < 37 * 53; ++i)
+    {
+        mat[i] = (i - 900) * 0.731f;
+    }
+    mat[5] = -0.f;
+    saveBinary(path, mat);
+    Matrix::resetAllocationCount();
+    {
+        MappedMatrix<float> mapped(path, true);
+        const Matrix& view = mapped.getMatrix();
+        assert(Matrix::getAllocationCount() == 0 && "Failed: mapped matrix allocated");
+        assert(view == mat && std::signbit(view[5]) && "Failed: mapped matrix values");
+        assert((uintptr_t) view.rowPtr(0) % SIMD_ALIGNMENT == 0 && "Failed: mapped alignment");
+        assert(mapped.verifyChecksum());
+        Matrix copy(view);
+        copy += 1.f;
+        assert(copy(2, 3) == mat(2, 3) + 1.f && "Failed: copy of a mapped matrix");
+    }
+
+    BasicMatrix<uint8_t> img(3, 5);
+    img[14] = 200;
+    saveBinary(path, img);
+    {
+        MappedMatrix<uint8_t> mappedImg(path);
+        assert(mappedImg.getMatrix() == img && "Failed: mapped uint8 matrix");
+    }
+
+    //a file written band after band has the checksum of the whole matrix.
+    {
+        BinaryFileWriter writer(path, BINARY_UINT8, 1, 3, 5);
+        writer.writeRows(img.rowPtr(0), 1);
+        writer.writeRows(img.rowPtr(1), 2);
+        writer.close();
+        MappedMatrix<uint8_t> mappedImg(path, true);
+        assert(mappedImg.getMatrix() == img && "Failed: band written file");
+    }
+
+    //another element type is rejected.
+    try
+    {
+        MappedMatrix<float> wrongType(path);
+        assert(false && "Failed: mapped a uint8 file as float");
+    }
+    catch(int e)
+    {
+    }
+
+    //a corrupted coordinate fails the checksum.
+    saveBinary(path, mat);
+    {
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(64 + 4 * 100);
+        file.put('x');
+    }
+    {
+        MappedMatrix<float> corrupted(path);
+        assert(!corrupted.verifyChecksum() && "Failed: checksum missed a corruption");
+    }
+    try
+    {
+        MappedMatrix<float> verified(path, true);
+        assert(false && "Failed: mapped a corrupted file with verify");
+    }
+    catch(int e)
+    {
+    }
+
+    //a data offset that wraps the file size around is rejected, not mapped past the file.
+    Matrix small(4, 4);
+    saveBinary(path, small);
+    {
+        fstream file(path, ios::in | ios::out | ios::binary);
+        BinaryMatrixHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        header.dataOffset = UINT64_MAX - header.alignment + 1;
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    try
+    {
+        MappedMatrix<float> wrapped(path);
+        assert(false && "Failed: mapped a file with a wrapping data offset");
+    }
+    catch(int e)
+    {
+    }
+
+    //a text file is not a binary matrix file.
+    try
+    {
+        MappedMatrix<float> text(INFILE1);
+        assert(false && "Failed: mapped a text file");
+    }
+    catch(int e)
+    {
+    }
+    std::remove(path);
+
+    cout << "Passed testBinaryFile" << endl;
+}
+
+void TestMatrix::testSeparableConvolution()
+{
+    constexpr FixedMatrix<3, 3> blurKernel(1.f / 16, 2.f / 16, 1.f / 16, 2.f / 16, 4.f / 16,
+                                           2.f / 16, 1.f / 16, 2.f / 16, 1.f / 16);
+    constexpr SeparableKernel<3, 3> separable = findSeparable(blurKernel);
+    static_assert(separable.isExact && separable.scale == 1.f / 16, "Failed: blur not separable");
+    assert(!findSeparable(FixedMatrix<3, 3>(1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f)).isExact
+           && "Failed: a rank 2 kernel is separable");
+
+    //the separable result is the direct one bit for bit, at every simd level.
+    int ROWS = 23, COLS = 37;
+    Matrix image(ROWS, COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        image[i] = (float) ((i * 7919) % 511 - 255);
+    }
+    Matrix expected(ROWS, COLS);
+    for(int row = 0; row < ROWS; ++row)
+    {
+        for(int col = 0; col < COLS; ++col)
+        {
+            float sum = 0;
+            for(int i = 0; i < 3; ++i)
+            {
+                for(int j = 0; j < 3; ++j)
+                {
+                    int imageRow = row + i - 1, imageCol = col + j - 1;
+                    if(0 <= imageRow && imageRow < ROWS && 0 <= imageCol && imageCol < COLS)
+                    {
+                        sum += blurKernel(i, j) * image(imageRow, imageCol);
+                    }
+                }
+            }
+            expected(row, col) = std::rint(sum);
+        }
+    }
+    SimdLevel bestLevel = detectSimdLevel();
+    SimdLevel levels[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512};
+    for(SimdLevel level : levels)
+    {
+        setSimdLevel(level);
+        Matrix result(ROWS, COLS);
+        assert(exactConvolution(result.getData(), image, separable, 0, ROWS) &&
+               "Failed: integer image not exact");
+        assert(result == expected && "Failed: separable convolution");
+
+        //a band of rows reads the rows around it.
+        Matrix band(5, COLS);
+        assert(exactConvolution(band.getData(), image, separable, 10, 5));
+        assert(std::memcmp(band.rowPtr(0), expected.rowPtr(10), 5 * COLS * sizeof(float)) == 0 &&
+               "Failed: separable convolution band");
+    }
+    setSimdLevel(bestLevel);
+
+    //a fraction or a -0 falls back to the caller, the result is untouched.
+    Matrix result(ROWS, COLS);
+    image[ROWS * COLS - 1] = 0.5f;
+    assert(!exactConvolution(result.getData(), image, separable, 0, ROWS) &&
+           "Failed: fraction on the exact path");
+    assert(exactConvolution(result.getData(), image, separable, 0, ROWS - 2) &&
+           "Failed: fraction outside the band");
+    image[ROWS * COLS - 1] = -0.f;
+    assert(!exactConvolution(result.getData(), image, separable, 0, ROWS) &&
+           "Failed: -0 on the exact path");
+
+    cout << "Passed testSeparableConvolution" << endl;
+}
+
+void TestMatrix::testConvolutionEngine()
+{
+    int ROWS = 45, COLS = 38;
+    Matrix image(ROWS, COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        image[i] = (float) ((i * 7919) % 256);
+    }
+
+    //the three methods agree up to the float rounding, on kernels of any odd dimensions.
+    int kernelDims[][2] = {{1, 1}, {3, 5}, {7, 1}, {9, 9}, {21, 15}};
+    for(auto& dims : kernelDims)
+    {
+        Matrix kernel(dims[0], dims[1]);
+        for(int i = 0; i < dims[0] * dims[1]; ++i)
+        {
+            kernel[i] = (float) ((i * 37) % 11 - 5) / 16;
+        }
+        Matrix direct = convolve(image, kernel, CONVOLUTION_DIRECT);
+        Matrix fft = convolve(image, kernel, CONVOLUTION_FFT);
+        for(int row = 0; row < ROWS; ++row)
+        {
+            for(int col = 0; col < COLS; ++col)
+            {
+                float expected = 0;
+                for(int i = 0; i < dims[0]; ++i)
+                {
+                    for(int j = 0; j < dims[1]; ++j)
+                    {
+                        int imageRow = row + i - dims[0] / 2, imageCol = col + j - dims[1] / 2;
+                        if(0 <= imageRow && imageRow < ROWS && 0 <= imageCol && imageCol < COLS)
+                        {
+                            expected += kernel(i, j) * image(imageRow, imageCol);
+                        }
+                    }
+                }
+                assert(std::fabs(direct(row, col) - expected) < 0.01f &&
+                       "Failed: direct convolution");
+                assert(std::fabs(fft(row, col) - expected) < 0.01f && "Failed: fft convolution");
+            }
+        }
+    }
+
+    Matrix gaussian = gaussianKernel(7, 2.5f);
+    std::vector<float> colWeights;
+    std::vector<float> rowWeights;
+    float sum = 0;
+    for(float val : gaussian.getData())
+    {
+        sum += val;
+    }
+    assert(gaussian.getRows() == 15 && std::fabs(sum - 1) < 1e-5f && "Failed: gaussian kernel");
+    assert(findSeparable(gaussian, colWeights, rowWeights) && colWeights.size() == 15 &&
+           "Failed: gaussian kernel not separable");
+    Matrix direct = convolve(image, gaussian, CONVOLUTION_DIRECT);
+    Matrix separable = convolve(image, gaussian, CONVOLUTION_SEPARABLE);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        assert(std::fabs(direct[i] - separable[i]) < 0.001f && "Failed: separable convolution");
+    }
+    Matrix box = boxKernel(2);
+    assert(box.getRows() == 5 && box(4, 4) == 1.f / 25 && "Failed: box kernel");
+    assert(std::fabs(convolve(image, box)(20, 20) - convolve(image, box, CONVOLUTION_FFT)(20, 20))
+           < 0.001f && "Failed: box kernel convolution");
+
+    //the cost model: a small kernel that is not separable runs directly, a separable one in
+    //passes and a big one that is not separable by fft.
+    Matrix laplacian = FixedMatrix<3, 3>(0.f, 1.f, 0.f, 1.f, -4.f, 1.f, 0.f, 1.f, 0.f).toMatrix();
+    Matrix big(31, 31);
+    for(int i = 0; i < 31 * 31; ++i)
+    {
+        big[i] = (float) (i % 7);
+    }
+    assert(chooseConvolutionMethod(1000, 1000, laplacian) == CONVOLUTION_DIRECT &&
+           "Failed: a 3x3 kernel not direct");
+    assert(chooseConvolutionMethod(1000, 1000, boxKernel(1)) == CONVOLUTION_SEPARABLE &&
+           "Failed: a 3x3 box kernel not separable");
+    assert(chooseConvolutionMethod(1000, 1000, gaussianKernel(15, 5)) == CONVOLUTION_SEPARABLE &&
+           "Failed: a big gaussian kernel not separable");
+    assert(chooseConvolutionMethod(1000, 1000, big) == CONVOLUTION_FFT &&
+           "Failed: a big kernel not by fft");
+    assert(!findSeparable(big, colWeights, rowWeights) && "Failed: a rank 7 kernel separable");
+
+    //an even kernel, and a kernel that is not separable on the separable method.
+    try
+    {
+        convolve(image, Matrix(2, 3));
+        assert(false && "Failed: convolution with an even kernel");
+    }
+    catch(int e)
+    {
+    }
+    try
+    {
+        convolve(image, big, CONVOLUTION_SEPARABLE);
+        assert(false && "Failed: separable convolution of a kernel that is not separable");
+    }
+    catch(int e)
+    {
+    }
+
+    //the filter of a kernel is rounded and clamped to the colors, the 3 x 3 blur is blur.
+    assert(convolutionFilter(image, BLUR_CONVOLUTION_MAT.toMatrix()) == blur(image) &&
+           "Failed: convolutionFilter of the blur kernel");
+    assert(gaussianBlur(image, 0) == image && "Failed: gaussianBlur of radius 0");
+    Matrix scale(1, 1);
+    scale(0, 0) = 2.f;
+    Matrix doubled = convolutionFilter(image, scale);
+    scale(0, 0) = 0.25f;
+    Matrix quarter = convolutionFilter(image, scale);
+    scale(0, 0) = -1.f;
+    Matrix negated = convolutionFilter(image, scale);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        assert(doubled[i] == std::min(2.f * image[i], 255.f) && "Failed: convolutionFilter clamp");
+        assert(quarter[i] == std::nearbyint(0.25f * image[i]) &&
+               "Failed: convolutionFilter round");
+        assert(negated[i] == 0.f && "Failed: convolutionFilter clamp below 0");
+    }
+
+    cout << "Passed testConvolutionEngine" << endl;
+}
+
+void TestMatrix::testSummedAreaTable()
+{
+    //more rows than a band and more columns than a block of the passes.
+    int ROWS = 70, COLS = 530;
+    Matrix image(ROWS, COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        image[i] = (float) ((i * 7919) % 256);
+    }
+    SummedAreaTable table(image);
+    assert(table.getRows() == ROWS && table.getCols() == COLS && "Failed: table dimensions");
+
+    //the sums of rectangles, partly outside the image too.
+    int rects[][4] = {{0, 0, ROWS, COLS}, {3, 5, 4, 6}, {10, 500, 69, 530}, {-5, -5, 2, 3},
+                      {60, 520, 100, 600}, {7, 7, 7, 9}};
+    for(auto& rect : rects)
+    {
+        double expected = 0;
+        double expectedSquares = 0;
+        for(int row = std::max(rect[0], 0); row < std::min(rect[2], ROWS); ++row)
+        {
+            for(int col = std::max(rect[1], 0); col < std::min(rect[3], COLS); ++col)
+            {
+                expected += image(row, col);
+                expectedSquares += (double) image(row, col) * image(row, col);
+            }
+        }
+        assert(table.sum(rect[0], rect[1], rect[2], rect[3]) == expected &&
+               "Failed: summed area table sum");
+        assert(table.squareSum(rect[0], rect[1], rect[2], rect[3]) == expectedSquares &&
+               "Failed: summed area table square sum");
+    }
+
+    //the box filter is the box kernel convolution, the mean and variance of the clipped window.
+    int radiuses[] = {0, 1, 4, 40};
+    for(int radius : radiuses)
+    {
+        Matrix box = table.boxFilter(radius);
+        Matrix direct = convolve(image, boxKernel(radius), CONVOLUTION_SEPARABLE);
+        Matrix mean = table.localMean(radius);
+        Matrix variance = table.localVariance(radius);
+        for(int i = 0; i < ROWS * COLS; i += 37)
+        {
+            int row = i / COLS, col = i % COLS;
+            int firstRow = row - radius, firstCol = col - radius;
+            int endRow = row + radius + 1, endCol = col + radius + 1;
+            double size = (double) (std::min(endRow, ROWS) - std::max(firstRow, 0)) *
+                          (std::min(endCol, COLS) - std::max(firstCol, 0));
+            double expectedMean = table.sum(firstRow, firstCol, endRow, endCol) / size;
+            double expectedVariance = table.squareSum(firstRow, firstCol, endRow, endCol) / size -
+                                      expectedMean * expectedMean;
+            assert(std::fabs(box[i] - direct[i]) < 0.01f && "Failed: box filter");
+            assert(std::fabs(mean[i] - expectedMean) < 0.001 && "Failed: local mean");
+            assert(std::fabs(variance[i] - expectedVariance) < 0.01 && "Failed: local variance");
+        }
+    }
+    Matrix flat(5, 5);
+    flat += 3.f;
+    assert(SummedAreaTable(flat).localVariance(2)(2, 2) == 0.f && "Failed: flat variance");
+
+    //the box blur of the table is the filter of the box kernel, rounded and clamped alike.
+    for(int radius : {0, 1, 2, 5})
+    {
+        assert(boxBlur(image, radius) == convolutionFilter(image, boxKernel(radius)) &&
+               "Failed: boxBlur");
+    }
+
+    try
+    {
+        table.boxFilter(-1);
+        assert(false && "Failed: box filter with a negative radius");
+    }
+    catch(int e)
+    {
+    }
+
+    cout << "Passed testSummedAreaTable" << endl;
+}
+
+/**
+ * asserts that fixedPointConvolution gives, at every simd level, the clamped float path result
+ * of the same image.
+ */
+static void _checkFixedPoint(const BasicMatrix<uint8_t>& image, FixedPointFilter filter,
+                             const char* failure)
+{
+    static const float SMOOTH[] = {1.f, 2.f, 1.f};
+    static const float DIFF[] = {1.f, 0.f, -1.f};
+    int rows = image.getRows(), cols = image.getCols();
+    Matrix floatImage(rows, cols);
+    for(long i = 0; i < (long) rows * cols; ++i)
+    {
+        floatImage[i] = image[i];
+    }
+    Matrix expected(rows, cols);
+    if(filter == FIXED_POINT_BLUR)
+    {
+        separableConvolution(expected.getData(), floatImage, SMOOTH, 3, SMOOTH, 3, 1.f / 16, 0,
+                             rows);
+    }
+    else
+    {
+        Matrix gradY(rows, cols);
+        separableConvolution(expected.getData(), floatImage, SMOOTH, 3, DIFF, 3, 1.f / 8, 0, rows);
+        separableConvolution(gradY.getData(), floatImage, DIFF, 3, SMOOTH, 3, 1.f / 8, 0, rows);
+        addArrays(expected.rowPtr(0), gradY.rowPtr(0), expected.rowPtr(0), (long) rows * cols);
+    }
+    clampArray(expected.rowPtr(0), 0.f, 255.f, expected.rowPtr(0), (long) rows * cols);
+
+    SimdLevel bestLevel = detectSimdLevel();
+    SimdLevel levels[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512};
+    for(SimdLevel level : levels)
+    {
+        setSimdLevel(level);
+        BasicMatrix<uint8_t> result(rows, cols);
+        fixedPointConvolution(result.getData(), image, filter, 0, rows);
+        for(long i = 0; i < (long) rows * cols; ++i)
+        {
+            assert(result[i] == expected[i] && failure);
+        }
+    }
+    setSimdLevel(bestLevel);
+}
+
+/**
+ * sets the 3 x 3 block of image around (1, col) to the columns (top, mid, bottom).
+ */
+static void _setBlock(BasicMatrix<uint8_t>& image, int col, const int (*columns)[3])
+{
+    for(int j = 0; j < 3; ++j)
+    {
+        for(int i = 0; i < 3; ++i)
+        {
+            image(i, col - 1 + j) = (uint8_t) columns[j][i];
+        }
+    }
+}
+
+/**
+ * sets column to a (top, mid, bottom) of 8 bit values with top + 2 * mid + bottom = x and
+ * top - bottom = y.
+ * @return false if there is none.
+ */
+static bool _sobelColumn(int x, int y, int* column)
+{
+    if(std::abs(y) > 255 || x < std::abs(y) || x > 1020 - std::abs(y) || (x - y) % 2 != 0)
+    {
+        return false;
+    }
+    int mid = std::max(0, (x - 510 + std::abs(y) + 1) / 2);
+    int sum = x - 2 * mid;
+    column[0] = (sum + y) / 2;
+    column[1] = mid;
+    column[2] = (sum - y) / 2;
+    return true;
+}
+
+void TestMatrix::testFixedPointConvolution()
+{
+    //every sum of the blur, a block per sum filled from the heaviest weight.
+    const int MAX_BLUR_SUM = 16 * 255;
+    BasicMatrix<uint8_t> blurImage(3, 3 * (MAX_BLUR_SUM + 1));
+    for(int sum = 0; sum <= MAX_BLUR_SUM; ++sum)
+    {
+        static const int WEIGHTS[3][3] = {{1, 2, 1}, {2, 4, 2}, {1, 2, 1}};
+        static const int ORDER[9][2] = {{1, 1}, {0, 1}, {1, 0}, {1, 2}, {2, 1}, {0, 0}, {0, 2},
+                                        {2, 0}, {2, 2}};
+        int columns[3][3] = {};
+        int rest = sum;
+        for(const int* tap : ORDER)
+        {
+            int weight = WEIGHTS[tap[0]][tap[1]];
+            columns[tap[1]][tap[0]] = std::min(255, rest / weight);
+            rest -= weight * columns[tap[1]][tap[0]];
+        }
+        assert(rest == 0);
+        _setBlock(blurImage, 3 * sum + 1, columns);
+    }
+    _checkFixedPoint(blurImage, FIXED_POINT_BLUR, "Failed: fixed point blur sums");
+
+    //every pair of sobel gradients an 8 bit block has (both have the parity of the sum of the side
+    //columns), an image per axis X gradient. the axis Y gradient is split to the center column
+    //and then evenly to the side ones, and the axis X one to the side its sign points to.
+    const int MAX_GRADIENT = 4 * 255;
+    const long REACHABLE_PAIRS = 1822741;
+    long numPairs = 0;
+    for(int gradX = -MAX_GRADIENT; gradX <= MAX_GRADIENT; ++gradX)
+    {
+        BasicMatrix<uint8_t> sobelImage(3, 3 * (2 * MAX_GRADIENT + 1));
+        for(int gradY = -MAX_GRADIENT; gradY <= MAX_GRADIENT; ++gradY)
+        {
+            int centerY = std::max(-255, std::min(255, gradY / 2));
+            int leftY = (gradY - 2 * centerY) / 2;
+            int rightY = gradY - 2 * centerY - leftY;
+            int rightX = gradX >= 0 ? std::abs(rightY) : std::abs(leftY) - gradX;
+            int columns[3][3];
+            if(!_sobelColumn(rightX + gradX, leftY, columns[0]) ||
+               !_sobelColumn(std::abs(centerY), centerY, columns[1]) ||
+               !_sobelColumn(rightX, rightY, columns[2]))
+            {
+                continue;
+            }
+            _setBlock(sobelImage, 3 * (gradY + MAX_GRADIENT) + 1, columns);
+            ++numPairs;
+        }
+        _checkFixedPoint(sobelImage, FIXED_POINT_SOBEL, "Failed: fixed point sobel gradients");
+    }
+    assert(numPairs == REACHABLE_PAIRS && "Failed: sobel gradient pairs");
+
+    //every 8 bit value at every tap, over a background of every 8 bit value.
+    for(int tap = 0; tap < 9; ++tap)
+    {
+        for(int background = 0; background < 256; background += 51)
+        {
+            BasicMatrix<uint8_t> image(3, 3 * 256);
+            for(int value = 0; value < 256; ++value)
+            {
+                int columns[3][3] = {{background, background, background},
+                                     {background, background, background},
+                                     {background, background, background}};
+                columns[tap % 3][tap / 3] = value;
+                _setBlock(image, 3 * value + 1, columns);
+            }
+            _checkFixedPoint(image, FIXED_POINT_BLUR, "Failed: fixed point blur taps");
+            _checkFixedPoint(image, FIXED_POINT_SOBEL, "Failed: fixed point sobel taps");
+        }
+    }
+
+    //a band of rows reads the image rows around it, and ends at an odd width.
+    int ROWS = 19, COLS = 53;
+    BasicMatrix<uint8_t> image(ROWS, COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        image[i] = (uint8_t) (i * 7919 % 256);
+    }
+    FixedPointFilter filters[] = {FIXED_POINT_BLUR, FIXED_POINT_SOBEL};
+    for(FixedPointFilter filter : filters)
+    {
+        BasicMatrix<uint8_t> whole(ROWS, COLS);
+        fixedPointConvolution(whole.getData(), image, filter, 0, ROWS);
+        BasicMatrix<uint8_t> band(5, COLS);
+        fixedPointConvolution(band.getData(), image, filter, 7, 5);
+        assert(std::memcmp(band.rowPtr(0), whole.rowPtr(7), 5 * COLS) == 0 &&
+               "Failed: fixed point band");
+    }
+    _checkFixedPoint(image, FIXED_POINT_BLUR, "Failed: fixed point blur image");
+    _checkFixedPoint(image, FIXED_POINT_SOBEL, "Failed: fixed point sobel image");
+
+    cout << "Passed testFixedPointConvolution" << endl;
+}
+
+void TestMatrix::testTiledMatrix()
+{
+    //more than a tile on both axes and cut tiles on the edges.
+    int ROWS = 150, COLS = 200, RHS_COLS = 90;
+    Matrix lhs(ROWS, COLS);
+    Matrix rhs(COLS, RHS_COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        lhs[i] = (float) ((i * 7919) % 1013) / 97.f - 5.f;
+    }
+    for(int i = 0; i < COLS * RHS_COLS; ++i)
+    {
+        rhs[i] = (float) ((i * 104729) % 877) / 31.f - 14.f;
+    }
+    TiledMatrix tiledLhs(lhs);
+    TiledMatrix tiledRhs(rhs);
+    assert(tiledLhs.getRows() == ROWS && tiledLhs.getCols() == COLS &&
+           tiledLhs.getTileRows() == 3 && tiledLhs.getTileCols() == 4 &&
+           "Failed: tiled dimensions");
+    assert(tiledLhs.toMatrix() == lhs && "Failed: tiled conversion");
+    assert(tiledLhs(149, 199) == lhs(149, 199) && tiledLhs(70, 3) == lhs(70, 3) &&
+           "Failed: tiled coordinate");
+    assert(tiledLhs.tilePtr(2, 3)[(149 % TILE_SIZE) * TILE_SIZE + 199 % TILE_SIZE] ==
+           lhs(149, 199) && tiledLhs.tilePtr(2, 3)[TILE_SIZE * TILE_SIZE - 1] == 0 &&
+           "Failed: tile layout");
+
+    //the product packs the tiles like the row major one, so it is the same bit for bit.
+    Matrix product = lhs * rhs;
+    TiledMatrix tiledProduct = tiledLhs * tiledRhs;
+    assert(std::memcmp(tiledProduct.toMatrix().rowPtr(0), product.rowPtr(0),
+                       (long) ROWS * RHS_COLS * sizeof(float)) == 0 && "Failed: tiled product");
+    TiledMatrix smallProduct = TiledMatrix(Matrix(3, 70)) * TiledMatrix(Matrix(70, 5));
+    assert(smallProduct == TiledMatrix(3, 5) && "Failed: small tiled product");
+
+    TiledMatrix transposed = tiledLhs.transpose();
+    assert(transposed.getRows() == COLS && transposed.getCols() == ROWS &&
+           "Failed: tiled transpose dimensions");
+    for(int row = 0; row < ROWS; ++row)
+    {
+        for(int col = 0; col < COLS; ++col)
+        {
+            assert(transposed(col, row) == lhs(row, col) && "Failed: tiled transpose");
+        }
+    }
+    assert(transposed.transpose() == tiledLhs && "Failed: tiled transpose twice");
+
+    //the convolution of every method is the row major one, a kernel wider than a tile too.
+    Matrix kernels[] = {gaussianKernel(2, 1.f), gaussianKernel(40, 9.f), Matrix(3, 5)};
+    kernels[2](0, 1) = 1.f;
+    kernels[2](1, 2) = 0.5f;
+    kernels[2](2, 4) = -2.f;
+    ConvolutionMethod methods[] = {CONVOLUTION_DIRECT, CONVOLUTION_SEPARABLE, CONVOLUTION_FFT,
+                                   CONVOLUTION_AUTO};
+    for(const Matrix& kernel : kernels)
+    {
+        for(ConvolutionMethod method : methods)
+        {
+            if(method == CONVOLUTION_SEPARABLE && &kernel == &kernels[2])
+            {
+                continue;
+            }
+            Matrix expected = convolve(lhs, kernel, method);
+            assert(std::memcmp(convolve(tiledLhs, kernel, method).toMatrix().rowPtr(0),
+                               expected.rowPtr(0), (long) ROWS * COLS * sizeof(float)) == 0 &&
+                   "Failed: tiled convolution");
+        }
+    }
+
+    TiledMatrix empty(0, 5);
+    assert(empty.getTileRows() == 0 && empty.toMatrix().getCols() == 5 &&
+           "Failed: empty tiled matrix");
+    assert(convolve(empty, kernels[0]) == empty && "Failed: empty tiled convolution");
+
+    cout << "Passed testTiledMatrix" << endl;
+}
+
 //test vectorize
 
+/**
+ * runs a streaming filter on the image through a reader and a writer of matrices, asserts the
+ * reader is asked for every row once and in order, and the writer gets the rows in order.
+ * @param stream stream(reader, writer) runs the filter.
+ * @return the result the writer got.
+ */
+static Matrix _runStream(const Matrix& image,
+                         const std::function<void(const RowBandReader&,
+                                                  const RowBandWriter&)>& stream)
+{
+    int cols = image.getCols();
+    Matrix result(image.getRows(), cols);
+    int nextReadRow = 0, nextWrittenRow = 0;
+    stream([&image, cols, &nextReadRow](int firstRow, Span<float> rows)
+           {
+               assert(firstRow == nextReadRow && rows.size() % cols == 0 &&
+                      "Failed: stream reader rows not in order");
+               std::copy(image.rowPtr(firstRow), image.rowPtr(firstRow) + rows.size(),
+                         rows.begin());
+               nextReadRow += (int) (rows.size() / cols);
+           },
+           [&result, cols, &nextWrittenRow](int firstRow, Span<const float> rows)
+           {
+               assert(firstRow == nextWrittenRow && "Failed: stream writer rows not in order");
+               std::copy(rows.begin(), rows.end(), result.rowPtr(firstRow));
+               nextWrittenRow += (int) (rows.size() / cols);
+           });
+    assert(nextReadRow == image.getRows() && nextWrittenRow == image.getRows() &&
+           "Failed: stream missed rows");
+    return result;
+}
+
+void TestMatrix::testFilterStreams()
+{
+    //a row, a column and an image with seams between the bands.
+    Matrix images[] = {Matrix(1, 40), Matrix(40, 1), Matrix(33, 40)};
+    for(Matrix& image : images)
+    {
+        Span<float> values = image.getData();
+        for(long i = 0; i < values.size(); ++i)
+        {
+            values[i] = (float) ((i * 7919) % 256);
+        }
+        int rows = image.getRows(), cols = image.getCols();
+        for(int bandRows : {1, 2, 7, rows + 5})
+        {
+            Matrix blurred = _runStream(image, [rows, cols, bandRows](const RowBandReader& reader,
+                                                                     const RowBandWriter& writer)
+            {
+                blurStream(rows, cols, reader, writer, bandRows);
+            });
+            assert(blurred == blur(image) && "Failed: blurStream");
+            Matrix edges = _runStream(image, [rows, cols, bandRows](const RowBandReader& reader,
+                                                                   const RowBandWriter& writer)
+            {
+                sobelStream(rows, cols, reader, writer, bandRows);
+            });
+            assert(edges == sobel(image) && "Failed: sobelStream");
+            Matrix quantized = _runStream(image, [rows, cols, bandRows](const RowBandReader& reader,
+                                                                       const RowBandWriter& writer)
+            {
+                quantizationStream(rows, cols, reader, writer, 5, bandRows);
+            });
+            assert(quantized == quantization(image, 5) && "Failed: quantizationStream");
+        }
+    }
+
+    cout << "Passed testFilterStreams" << endl;
+}
+
+void TestMatrix::testFilterPipeline()
+{
+    //a row is 64KB, so a chunk is a row and a task a strip of 16 of them.
+    int ROWS = 300, COLS = 16384;
+    Matrix image(ROWS, COLS);
+    Span<float> values = image.getData();
+    for(long i = 0; i < values.size(); ++i)
+    {
+        values[i] = (float) ((i * 7919) % 256);
+    }
+
+    Matrix fused = FilterPipeline().addBlur().addSobel().addQuantization(4).apply(image, 1);
+    assert(fused == quantization(sobel(blur(image)), 4) && "Failed: pipeline of the chain");
+
+    //a quantization stage first or between the convolutions has no halo of its own.
+    Matrix quantizedFirst = FilterPipeline().addQuantization(8).addBlur().addSobel().apply(image);
+    assert(quantizedFirst == sobel(blur(quantization(image, 8))) &&
+           "Failed: pipeline quantization first");
+    Matrix quantizedMiddle = FilterPipeline().addBlur().addQuantization(16).addSobel().apply(image);
+    assert(quantizedMiddle == sobel(quantization(blur(image), 16)) &&
+           "Failed: pipeline quantization in the middle");
+
+    //the strips on many threads are the ones on one.
+    int poolThreads = ThreadPool::getInstance().getNumThreads();
+    ThreadPool::setNumThreads(8);
+    Matrix manyThreads = FilterPipeline().addBlur().addSobel().addQuantization(4).apply(image);
+    assert(manyThreads == fused && "Failed: pipeline on many threads");
+    ThreadPool::setNumThreads(poolThreads);
+
+    Matrix pixel(1, 1);
+    pixel(0, 0) = 200.f;
+    Matrix fusedPixel = FilterPipeline().addBlur().addSobel().addQuantization(4).apply(pixel);
+    assert(fusedPixel == quantization(sobel(blur(pixel)), 4) && "Failed: pipeline of a pixel");
+
+    Matrix copied = FilterPipeline().apply(pixel);
+    assert(copied == pixel && FilterPipeline().getNumStages() == 0 &&
+           "Failed: pipeline without stages");
+
+    cout << "Passed testFilterPipeline" << endl;
+}
+
+void TestMatrix::testFilterBatch()
+{
+    //images of different dimensions, the last ones wide enough for several chunks.
+    const int NUM_IMAGES = 20;
+    std::vector<Matrix> images;
+    for(int index = 0; index < NUM_IMAGES; ++index)
+    {
+        images.emplace_back(1 + index * 7, 1 + (index % 5) * 1000);
+        Span<float> values = images.back().getData();
+        for(long i = 0; i < values.size(); ++i)
+        {
+            values[i] = (float) ((i * 7919 + index) % 256);
+        }
+    }
+    FilterPipeline pipeline = FilterPipeline().addBlur().addSobel().addQuantization(4);
+
+    //fewer images than threads run one at a time on all of them, more run an image per task.
+    int poolThreads = ThreadPool::getInstance().getNumThreads();
+    ThreadPool::setNumThreads(8);
+    for(int numImages : {3, NUM_IMAGES})
+    {
+        Span<const Matrix> batch(images.data(), numImages);
+        std::vector<Matrix> chained = pipeline.applyBatch(batch);
+        std::vector<Matrix> blurred = blurBatch(batch);
+        std::vector<Matrix> edges = sobelBatch(batch);
+        std::vector<Matrix> quantized = quantizationBatch(batch, 16);
+        assert(chained.size() == (size_t) numImages && blurred.size() == (size_t) numImages &&
+               edges.size() == (size_t) numImages && quantized.size() == (size_t) numImages &&
+               "Failed: batch size");
+        for(int index = 0; index < numImages; ++index)
+        {
+            assert(chained[index] == quantization(sobel(blur(images[index])), 4) &&
+                   "Failed: applyBatch");
+            assert(blurred[index] == blur(images[index]) && "Failed: blurBatch");
+            assert(edges[index] == sobel(images[index]) && "Failed: sobelBatch");
+            assert(quantized[index] == quantization(images[index], 16) &&
+                   "Failed: quantizationBatch");
+        }
+    }
+    ThreadPool::setNumThreads(poolThreads);
+
+    Span<const Matrix> noImages;
+    assert(blurBatch(noImages).empty() && quantizationBatch(noImages, 4).empty() &&
+           pipeline.applyBatch(noImages).empty() && "Failed: empty batch");
+
+    //the results of a batch come from the arena, one request each.
+    FrameArena arena;
+    Span<const Matrix> batch(images.data(), NUM_IMAGES);
+    std::vector<Matrix> fromArena = sobelBatch(batch, ALL_THREADS, arena);
+    assert(arena.getStats().requests == NUM_IMAGES && "Failed: batch arena requests");
+    for(int index = 0; index < NUM_IMAGES; ++index)
+    {
+        assert(&fromArena[index].getAllocator() == &arena && "Failed: batch allocator");
+        assert(fromArena[index] == sobel(images[index]) && "Failed: batch in an arena");
+    }
+
+    cout << "Passed testFilterBatch" << endl;
+}
+
+void TestMatrix::testInPlaceFilters()
+{
+    //a row is 64KB, so the in place filters run strips of 16 rows on the threads.
+    int ROWS = 300, COLS = 16384;
+    Matrix image(ROWS, COLS);
+    Span<float> values = image.getData();
+    for(long i = 0; i < values.size(); ++i)
+    {
+        values[i] = (float) ((i * 7919) % 256);
+    }
+
+    int poolThreads = ThreadPool::getInstance().getNumThreads();
+    ThreadPool::setNumThreads(8);
+    Matrix blurred = image;
+    blurInPlace(blurred);
+    assert(blurred == blur(image) && "Failed: blurInPlace");
+    Matrix edges = image;
+    sobelInPlace(edges);
+    assert(edges == sobel(image) && "Failed: sobelInPlace");
+    Matrix quantized = image;
+    quantizationInPlace(quantized, 16);
+    assert(quantized == quantization(image, 16) && "Failed: quantizationInPlace");
+
+    //every row reads the original rows around it, also across the chunks and the strips.
+    Matrix summed = image;
+    _convolutionInPlace(summed, ALL_THREADS, [](Span<float> result, const Matrix& input,
+                                                int firstRow, int numRows)
+    {
+        for(int row = 0; row < numRows; ++row)
+        {
+            for(int col = 0; col < input.getCols(); ++col)
+            {
+                result[(long) row * input.getCols() + col] = input(firstRow + row - 1, col) +
+                                                             input(firstRow + row, col) +
+                                                             input(firstRow + row + 1, col);
+            }
+        }
+    });
+    for(int row = 0; row < ROWS; ++row)
+    {
+        for(int col = 0; col < COLS; col += 97)
+        {
+            float sum = image(row, col) + (row > 0 ? image(row - 1, col) : 0.f) +
+                        (row < ROWS - 1 ? image(row + 1, col) : 0.f);
+            assert(summed(row, col) == sum && "Failed: _convolutionInPlace");
+        }
+    }
+
+    Matrix result(ROWS, COLS);
+    blur(image, result);
+    assert(result == blurred && "Failed: blur into a result");
+    sobel(image, result);
+    assert(result == edges && "Failed: sobel into a result");
+    quantization(image, 16, result);
+    assert(result == quantized && "Failed: quantization into a result");
+    ThreadPool::setNumThreads(poolThreads);
+
+    //the window of a thread is kept, so a frame loop allocates nothing after its first frame.
+    for(int frame = 0; frame < 3; ++frame)
+    {
+        if(frame == 1)
+        {
+            Matrix::resetAllocationCount();
+        }
+        blur(image, result, 1);
+        sobelInPlace(result, 1);
+        quantizationInPlace(result, 4, 1);
+        blurInPlace(result, 1);
+        sobel(image, result, 1);
+    }
+    assert(Matrix::getAllocationCount() == 0 && "Failed: repeated in place filters allocated");
+
+    Matrix pixel(1, 1);
+    pixel(0, 0) = 200.f;
+    Matrix blurredPixel = pixel;
+    blurInPlace(blurredPixel);
+    assert(blurredPixel == blur(pixel) && "Failed: blurInPlace of a pixel");
+
+    cout << "Passed testInPlaceFilters" << endl;
+}
+
+void TestMatrix::testAdaptiveQuantization()
+{
+    //the median cut splits 0 10 | 20 100 at the median pixel, k-means moves 20 to the mean 10.
+    Matrix spread(1, 4);
+    spread[1] = 10.f;
+    spread[2] = 20.f;
+    spread[3] = 100.f;
+    Matrix medianCut = adaptiveQuantization(spread, 2, MEDIAN_CUT_QUANTIZATION);
+    assert(medianCut[0] == 5.f && medianCut[1] == 5.f && medianCut[2] == 60.f &&
+           medianCut[3] == 60.f && "Failed: median cut levels");
+    Matrix kmeans = adaptiveQuantization(spread, 2, KMEANS_QUANTIZATION);
+    assert(kmeans[0] == 10.f && kmeans[1] == 10.f && kmeans[2] == 10.f && kmeans[3] == 100.f &&
+           "Failed: k-means levels");
+
+    //as many levels as colors keep them, fewer merge the nearest.
+    Matrix threeColors(3, 4);
+    const float COLORS[] = {10.f, 50.f, 200.f};
+    const int COLOR_PIXELS[] = {4, 3, 5};
+    for(int i = 0, color = 0; color < 3; ++color)
+    {
+        for(int pixel = 0; pixel < COLOR_PIXELS[color]; ++pixel, ++i)
+        {
+            threeColors[(i * 5) % 12] = COLORS[color];
+        }
+    }
+    assert(adaptiveQuantization(threeColors, 3, MEDIAN_CUT_QUANTIZATION) == threeColors &&
+           adaptiveQuantization(threeColors, 3, KMEANS_QUANTIZATION) == threeColors &&
+           "Failed: adaptive quantization with a level per color");
+    Matrix twoLevels = adaptiveQuantization(threeColors, 2);
+    for(int i = 0; i < 12; ++i)
+    {
+        //(4 * 10 + 3 * 50) / 7 rounded.
+        assert(twoLevels[i] == (threeColors[i] == 200.f ? 200.f : 27.f) &&
+               "Failed: k-means of two levels");
+    }
+
+    //every color of 0 to 255 on a bigger image.
+    int ROWS = 37, COLS = 53;
+    Matrix image(ROWS, COLS);
+    for(int i = 0; i < ROWS * COLS; ++i)
+    {
+        image[i] = (float) ((i * 7919) % 256);
+    }
+    for(int levels : {1, 3, 16})
+    {
+        assert(adaptiveQuantization(image, levels, UNIFORM_QUANTIZATION) ==
+               quantization(image, levels) && "Failed: uniform adaptive quantization");
+    }
+    for(QuantizationMethod method : {MEDIAN_CUT_QUANTIZATION, KMEANS_QUANTIZATION})
+    {
+        for(int levels : {1, NUMBER_OF_COLORS})
+        {
+            Matrix quantized = adaptiveQuantization(image, levels, method);
+            std::set<float> distinct(quantized.getData().begin(), quantized.getData().end());
+            assert((int) distinct.size() == levels && "Failed: adaptive quantization levels");
+        }
+        Matrix constant(ROWS, COLS);
+        constant += 77.f;
+        assert(adaptiveQuantization(constant, 4, method) == constant &&
+               "Failed: adaptive quantization of a constant image");
+    }
+
+    //into a result, and into the image itself.
+    Matrix expected = adaptiveQuantization(image, 5, MEDIAN_CUT_QUANTIZATION);
+    Matrix result(ROWS, COLS);
+    adaptiveQuantization(image, 5, result, MEDIAN_CUT_QUANTIZATION);
+    assert(result == expected && "Failed: adaptive quantization into a result");
+    Matrix inPlace = image;
+    adaptiveQuantization(inPlace, 5, inPlace, MEDIAN_CUT_QUANTIZATION);
+    assert(inPlace == expected && "Failed: adaptive quantization in place");
+
+    cout << "Passed testAdaptiveQuantization" << endl;
+}
+
+void TestMatrix::testSobelGradient()
+{
+    //the integer sobel weights of the axis of the columns, the axis of the rows is the transpose.
+    const float SOBEL_X[3][3] = {{1.f, 0.f, -1.f}, {2.f, 0.f, -2.f}, {1.f, 0.f, -1.f}};
+    const float TANGENT = 0.41421356f;
+    int poolThreads = ThreadPool::getInstance().getNumThreads();
+    ThreadPool::setNumThreads(4);
+    int dims[][2] = {{1, 37}, {29, 1}, {33, 40}};
+    for(auto& dim : dims)
+    {
+        int rows = dim[0], cols = dim[1];
+        //values beyond the colors, so the magnitudes are clamped on both sides.
+        Matrix image(rows, cols);
+        for(int i = 0; i < rows * cols; ++i)
+        {
+            image[i] = (float) ((i * 7919) % 1500) - 300.f;
+        }
+        for(int numThreads : {1, ALL_THREADS})
+        {
+            Matrix magnitudeL1(rows, cols), magnitudeL2(rows, cols);
+            BasicMatrix<uint8_t> orientation(rows, cols);
+            sobelGradient(image, &magnitudeL1, &orientation, L1_NORM, numThreads);
+            sobelGradient(image, &magnitudeL2, nullptr, L2_NORM, numThreads);
+            BasicMatrix<uint8_t> orientationOnly(rows, cols);
+            sobelGradient(image, nullptr, &orientationOnly, L2_NORM, numThreads);
+            assert(orientationOnly == orientation && "Failed: sobelGradient orientation only");
+            for(int row = 0; row < rows; ++row)
+            {
+                for(int col = 0; col < cols; ++col)
+                {
+                    //the rows and columns outside the image are 0.
+                    float gradX = 0.f, gradY = 0.f;
+                    for(int i = 0; i < 3; ++i)
+                    {
+                        for(int j = 0; j < 3; ++j)
+                        {
+                            int imageRow = row + i - 1, imageCol = col + j - 1;
+                            if(0 <= imageRow && imageRow < rows && 0 <= imageCol &&
+                               imageCol < cols)
+                            {
+                                gradX += image(imageRow, imageCol) * SOBEL_X[i][j];
+                                gradY += image(imageRow, imageCol) * SOBEL_X[j][i];
+                            }
+                        }
+                    }
+                    float l1 = std::rint((std::fabs(gradX) + std::fabs(gradY)) / 8.f);
+                    float l2 = std::rint(std::sqrt(gradX * gradX + gradY * gradY) / 8.f);
+                    assert(magnitudeL1(row, col) == std::min(std::max(l1, 0.f), 255.f) &&
+                           "Failed: sobelGradient L1 magnitude");
+                    assert(magnitudeL2(row, col) == std::min(std::max(l2, 0.f), 255.f) &&
+                           "Failed: sobelGradient L2 magnitude");
+
+                    int expected = ORIENTATION_0;
+                    if(std::fabs(gradY) > TANGENT * std::fabs(gradX))
+                    {
+                        expected = std::fabs(gradX) <= TANGENT * std::fabs(gradY) ?
+                                   ORIENTATION_90 : (gradX > 0) == (gradY > 0) ?
+                                   ORIENTATION_45 : ORIENTATION_135;
+                    }
+                    assert(orientation(row, col) == expected &&
+                           "Failed: sobelGradient orientation");
+                }
+            }
+        }
+    }
+    ThreadPool::setNumThreads(poolThreads);
+
+    //a zero gradient is ORIENTATION_0, a flat image has no magnitude inside.
+    Matrix flat(5, 6);
+    flat += 100.f;
+    Matrix magnitude(5, 6);
+    BasicMatrix<uint8_t> orientation(5, 6);
+    orientation[0] = 9;
+    sobelGradient(flat, &magnitude, &orientation);
+    for(int row = 1; row < 4; ++row)
+    {
+        for(int col = 1; col < 5; ++col)
+        {
+            assert(magnitude(row, col) == 0.f && orientation(row, col) == ORIENTATION_0 &&
+                   "Failed: sobelGradient of a zero gradient");
+        }
+    }
+    assert(orientation[0] != 9 && "Failed: sobelGradient orientation not written");
+
+    cout << "Passed testSobelGradient" << endl;
+}
+
 void TestMatrix::testVectorize()
 {
     Matrix m(2,3);
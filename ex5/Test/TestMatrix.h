@@ -21,9 +21,21 @@
 #define EXPECTEDOS1 "expectedOS1.txt"
 
 #include "Matrix.h"
+#include "FixedMatrix.h"
+#include "MatrixFile.h"
+#include "Convolution.h"
+#include "ThreadPool.h"
+#include "SimdKernels.h"
+#include "SummedAreaTable.h"
+#include "TiledMatrix.h"
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
 
 using std::ifstream;
 
@@ -44,6 +56,10 @@ public:
 
     void testOperatorAssignment();
 
+    void testMoveSemantics();
+
+    void testAllocators();
+
     void testGetters();
 
     void testOperatorBrackets();
@@ -62,6 +78,8 @@ public:
     void testInvalidOperatorParenthesis3();
     void testInvalidOperatorParenthesis4();
 
+    void testUncheckedAccess();
+
     void testAddition();
     void testSelfAddition();
 
@@ -74,12 +92,24 @@ public:
     void testInvalidMultiplications1();
     void testInvalidMultiplications2();
 
+    void testBigMultiplication();
+    void testDeterministicMultiplication();
+    void testLimitedParallelFor();
+
     void testDivision();
     void testSelfDivision();
 
     void testInvalidDivision1();
     void testInvalidDivision2();
 
+    void testSimdLevels();
+
+    void testExpressions();
+
+    void testElementTypes();
+
+    void testFixedMatrix();
+
     void testEqualityOp();
     void testNonEqualityOp();
 
@@ -88,9 +118,37 @@ public:
 
     void testOutStream();
 
+    void testBufferedOutStream();
+
     void testInStream();
     void testInvalidInStream();
 
+    void testBulkInStream();
+
+    void testBinaryFile();
+
+    void testSeparableConvolution();
+
+    void testConvolutionEngine();
+
+    void testSummedAreaTable();
+
+    void testFixedPointConvolution();
+
+    void testTiledMatrix();
+
+    void testFilterStreams();
+
+    void testFilterPipeline();
+
+    void testFilterBatch();
+
+    void testInPlaceFilters();
+
+    void testAdaptiveQuantization();
+
+    void testSobelGradient();
+
 
 private:
 
@@ -0,0 +1,170 @@
+/**
+ * @file ThreadPool.cpp
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief The class ThreadPool implementation.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <memory>
+#include "ThreadPool.h"
+#include "Matrix.h"
+
+/**
+ * True on a thread while it runs tasks of some pool, nested parallelFor calls run serially.
+ */
+static thread_local bool gInsideTask = false;
+
+/**
+ * The global pool, created on first use.
+ */
+static std::unique_ptr<ThreadPool> gInstance;
+
+/**
+ * Guards gInstance.
+ */
+static std::mutex gInstanceMutex;
+
+ThreadPool::ThreadPool(int numThreads) : _task(nullptr), _numTasks(0), _nextTask(0),
+                                         _freeSlots(0), _activeWorkers(0), _generation(0),
+                                         _stop(false)
+{
+    if(numThreads <= 0)
+    {
+        std::cerr << INVALID_NUM_THREADS_ERROR << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 1; i < numThreads; ++i)
+    {
+        _workers.emplace_back(&ThreadPool::_workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wakeUp.notify_all();
+    for(std::thread& worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int numTasks, const std::function<void(int)>& task)
+{
+    parallelFor(numTasks, task, getNumThreads());
+}
+
+void ThreadPool::parallelFor(int numTasks, const std::function<void(int)>& task, int maxThreads)
+{
+    if(maxThreads <= 0)
+    {
+        exitWithError(INVALID_NUM_THREADS_ERROR);
+    }
+    if(numTasks <= 0)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> jobLock(_jobMutex, std::try_to_lock);
+    if(_workers.empty() || numTasks == 1 || maxThreads == 1 || gInsideTask ||
+       !jobLock.owns_lock())
+    {
+        for(int i = 0; i < numTasks; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _numTasks = numTasks;
+        _nextTask = 0;
+        _freeSlots = std::min(maxThreads, numTasks) - 1;
+        _activeWorkers = (int) _workers.size();
+        ++_generation;
+    }
+    _wakeUp.notify_all();
+
+    _runTasks();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _jobDone.wait(lock, [this] { return _activeWorkers == 0; });
+    _task = nullptr;
+}
+
+ThreadPool& ThreadPool::getInstance()
+{
+    std::lock_guard<std::mutex> lock(gInstanceMutex);
+    if(!gInstance)
+    {
+        gInstance.reset(new ThreadPool(_defaultNumThreads()));
+    }
+    return *gInstance;
+}
+
+void ThreadPool::setNumThreads(int numThreads)
+{
+    std::lock_guard<std::mutex> lock(gInstanceMutex);
+    gInstance.reset();
+    gInstance.reset(new ThreadPool(numThreads));
+}
+
+void ThreadPool::_workerLoop()
+{
+    long seenGeneration = 0;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeUp.wait(lock, [&] { return _stop || _generation != seenGeneration; });
+            if(_stop)
+            {
+                return;
+            }
+            seenGeneration = _generation;
+        }
+
+        //the workers beyond the threads of the job skip it.
+        if(_freeSlots-- > 0)
+        {
+            _runTasks();
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(--_activeWorkers == 0)
+        {
+            _jobDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::_runTasks()
+{
+    gInsideTask = true;
+    for(int i = _nextTask++; i < _numTasks; i = _nextTask++)
+    {
+        (*_task)(i);
+    }
+    gInsideTask = false;
+}
+
+int ThreadPool::_defaultNumThreads()
+{
+    const char* envVal = std::getenv(NUM_THREADS_ENV_VAR);
+    if(envVal != nullptr && std::atoi(envVal) > 0)
+    {
+        return std::atoi(envVal);
+    }
+    int hardwareThreads = (int) std::thread::hardware_concurrency();
+    return hardwareThreads > 0 ? hardwareThreads : 1;
+}
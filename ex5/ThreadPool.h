@@ -0,0 +1,194 @@
+#ifndef SUMMER_EX4_THREADPOOL_H
+#define SUMMER_EX4_THREADPOOL_H
+
+/**
+ * @file ThreadPool.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief header file of ThreadPool.cpp
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// -------------------------- const definitions -------------------------
+
+/**
+ * The environment variable that sets the number of threads of the global pool.
+ */
+#define NUM_THREADS_ENV_VAR "MATRIX_NUM_THREADS"
+
+#define INVALID_NUM_THREADS_ERROR "Invalid number of threads"
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @class ThreadPool
+ * @brief A persistent pool of worker threads that run the tasks of parallelFor, the calling
+ *        thread takes part in the work so a pool of n threads owns n - 1 workers.
+ */
+class ThreadPool
+{
+
+public:
+    /**
+     * @brief The class constructor - starts numThreads - 1 workers that wait for tasks, exit the
+     *        program if numThreads is not positive.
+     * @param numThreads: the number of threads that run the tasks, including the caller.
+     */
+    explicit ThreadPool(int numThreads);
+
+    /**
+     * @brief The class destructor - stops and joins the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool& rhs) = delete;
+
+    ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+    /**
+    *@fn ThreadPool::getNumThreads()const
+    *@brief return the number of threads that run the tasks, including the caller.
+    */
+    int getNumThreads() const { return (int) _workers.size() + 1; }
+
+    /**
+     * @fn ThreadPool::parallelFor(int numTasks, const std::function<void(int)>& task);
+     * @brief calls task(i) for every 0 <= i < numTasks on the pool threads and returns when all
+     *        the calls are done. nested calls from inside a task, and calls while another thread
+     *        already runs a parallelFor, run the tasks serially on the calling thread.
+     * @param numTasks the number of tasks.
+     * @param task the task to run, gets the task index.
+     */
+    void parallelFor(int numTasks, const std::function<void(int)>& task);
+
+    /**
+     * @fn ThreadPool::parallelFor(int numTasks, const std::function<void(int)>& task,
+     *                             int maxThreads);
+     * @brief like parallelFor, on at most maxThreads threads of the pool (including the caller),
+     *        so a call can use a part of the pool. the threads take the tasks one at a time from
+     *        a shared counter, so a thread that finishes its tasks early takes the tasks the
+     *        others have not started, uneven tasks keep all the threads busy.
+     * @param numTasks the number of tasks.
+     * @param task the task to run, gets the task index.
+     * @param maxThreads the number of threads to use, 1 runs the tasks on the caller, more than
+     *        getNumThreads() uses the whole pool. exit the program if it is not positive.
+     */
+    void parallelFor(int numTasks, const std::function<void(int)>& task, int maxThreads);
+
+    /**
+     * @fn ThreadPool::getInstance();
+     * @return the global pool. its size is set by setNumThreads, otherwise by the
+     *         NUM_THREADS_ENV_VAR environment variable, otherwise by the hardware concurrency.
+     */
+    static ThreadPool& getInstance();
+
+    /**
+     * @fn ThreadPool::setNumThreads(int numThreads);
+     * @brief replace the global pool with a pool of numThreads threads, must not be called while
+     *        the global pool runs tasks. exit the program if numThreads is not positive.
+     * @param numThreads: the number of threads of the global pool, including the caller.
+     */
+    static void setNumThreads(int numThreads);
+
+private:
+
+    /**
+    *@memberof ThreadPool::_workers
+    *@brief the worker threads.
+    */
+    std::vector<std::thread> _workers;
+
+    /**
+    *@memberof ThreadPool::_mutex
+    *@brief guards the members below.
+    */
+    std::mutex _mutex;
+
+    /**
+    *@memberof ThreadPool::_wakeUp
+    *@brief notified when a new job is posted or the pool stops.
+    */
+    std::condition_variable _wakeUp;
+
+    /**
+    *@memberof ThreadPool::_jobDone
+    *@brief notified when the last worker leaves the current job.
+    */
+    std::condition_variable _jobDone;
+
+    /**
+    *@memberof ThreadPool::_jobMutex
+    *@brief held by the thread that runs the current job, one job at a time.
+    */
+    std::mutex _jobMutex;
+
+    /**
+    *@memberof ThreadPool::_task
+    *@brief the task of the current job.
+    */
+    const std::function<void(int)>* _task;
+
+    /**
+    *@memberof ThreadPool::_numTasks
+    *@brief the number of tasks in the current job.
+    */
+    int _numTasks;
+
+    /**
+    *@memberof ThreadPool::_nextTask
+    *@brief the index of the next task to take.
+    */
+    std::atomic<int> _nextTask;
+
+    /**
+    *@memberof ThreadPool::_freeSlots
+    *@brief the number of workers that may still join the current job.
+    */
+    std::atomic<int> _freeSlots;
+
+    /**
+    *@memberof ThreadPool::_activeWorkers
+    *@brief the number of workers that have not finished the current job yet.
+    */
+    int _activeWorkers;
+
+    /**
+    *@memberof ThreadPool::_generation
+    *@brief incremented on every posted job, lets the workers notice a new job.
+    */
+    long _generation;
+
+    /**
+    *@memberof ThreadPool::_stop
+    *@brief set by the destructor to stop the workers.
+    */
+    bool _stop;
+
+    /**
+     * the loop of a worker thread, waits for jobs and runs their tasks.
+     */
+    void _workerLoop();
+
+    /**
+     * takes and runs tasks of the current job until there are no more.
+     */
+    void _runTasks();
+
+    /**
+     * @return the global pool size when setNumThreads was never called.
+     */
+    static int _defaultNumThreads();
+};
+
+#endif //SUMMER_EX4_THREADPOOL_H
@@ -0,0 +1,118 @@
+/**
+ * @file TiledMatrix.cpp
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief The tile layout implementation.
+ */
+
+#include <algorithm>
+#include "TiledMatrix.h"
+#include "ThreadPool.h"
+
+// -------------------------- const definitions -------------------------
+
+/**
+ * The number of coordinates of a tile.
+ */
+const int TILE_AREA = TILE_SIZE * TILE_SIZE;
+
+// ------------------------------ functions -----------------------------
+
+int TiledMatrix::_numTiles(int rows, int cols)
+{
+    if(rows < 0 || cols < 0)
+    {
+        exitWithError(INVALID_DIMENSIONS_ERROR);
+    }
+    return ((rows + TILE_SIZE - 1) / TILE_SIZE) * ((cols + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+TiledMatrix::TiledMatrix(int rows, int cols) : _rows(rows), _cols(cols),
+                                               _tiles(_numTiles(rows, cols), TILE_AREA)
+{
+}
+
+TiledMatrix::TiledMatrix(const Matrix& matrix) : TiledMatrix(matrix.getRows(), matrix.getCols())
+{
+    ThreadPool::getInstance().parallelFor(getTileRows(), [&](int tileRow)
+    {
+        int endRow = std::min(_rows, (tileRow + 1) * TILE_SIZE);
+        for(int row = tileRow * TILE_SIZE; row < endRow; ++row)
+        {
+            const float* src = matrix.rowPtr(row);
+            for(int tileCol = 0; tileCol < getTileCols(); ++tileCol)
+            {
+                int firstCol = tileCol * TILE_SIZE;
+                std::copy(src + firstCol, src + std::min(_cols, firstCol + TILE_SIZE),
+                          tilePtr(tileRow, tileCol) + (row % TILE_SIZE) * TILE_SIZE);
+            }
+        }
+    });
+}
+
+Matrix TiledMatrix::toMatrix() const
+{
+    Matrix result(_rows, _cols);
+    ThreadPool::getInstance().parallelFor(getTileRows(), [&](int tileRow)
+    {
+        int endRow = std::min(_rows, (tileRow + 1) * TILE_SIZE);
+        for(int row = tileRow * TILE_SIZE; row < endRow; ++row)
+        {
+            float* dst = result.rowPtr(row);
+            for(int tileCol = 0; tileCol < getTileCols(); ++tileCol)
+            {
+                int firstCol = tileCol * TILE_SIZE;
+                const float* src = tilePtr(tileRow, tileCol) + (row % TILE_SIZE) * TILE_SIZE;
+                std::copy(src, src + std::min(TILE_SIZE, _cols - firstCol), dst + firstCol);
+            }
+        }
+    });
+    return result;
+}
+
+const float& TiledMatrix::operator()(int row, int col) const
+{
+    if(row < 0 || col < 0 || _rows <= row || _cols <= col)
+    {
+        exitWithError(INDEX_OUT_OF_RANGE_ERROR);
+    }
+    return tilePtr(row / TILE_SIZE, col / TILE_SIZE)[(row % TILE_SIZE) * TILE_SIZE +
+                                                     col % TILE_SIZE];
+}
+
+float& TiledMatrix::operator()(int row, int col)
+{
+    if(row < 0 || col < 0 || _rows <= row || _cols <= col)
+    {
+        exitWithError(INDEX_OUT_OF_RANGE_ERROR);
+    }
+    return tilePtr(row / TILE_SIZE, col / TILE_SIZE)[(row % TILE_SIZE) * TILE_SIZE +
+                                                     col % TILE_SIZE];
+}
+
+TiledMatrix TiledMatrix::transpose() const
+{
+    TiledMatrix result(_cols, _rows);
+    int tileCols = getTileCols();
+    ThreadPool::getInstance().parallelFor(getTileRows() * tileCols, [&](int tile)
+    {
+        const float* src = tilePtr(tile / tileCols, tile % tileCols);
+        float* dst = result.tilePtr(tile % tileCols, tile / tileCols);
+        for(int row = 0; row < TILE_SIZE; ++row)
+        {
+            for(int col = 0; col < TILE_SIZE; ++col)
+            {
+                dst[col * TILE_SIZE + row] = src[row * TILE_SIZE + col];
+            }
+        }
+    });
+    return result;
+}
+
+bool TiledMatrix::operator==(const TiledMatrix& rhs) const
+{
+    //the padding of both is 0.
+    return _rows == rhs._rows && _cols == rhs._cols && _tiles == rhs._tiles;
+}
@@ -0,0 +1,178 @@
+#ifndef SUMMER_EX4_TILEDMATRIX_H
+#define SUMMER_EX4_TILEDMATRIX_H
+
+/**
+ * @file TiledMatrix.h
+ * @author  Avi Kogan <avi.kogan@mail.huji.ac.il>
+ * @version 1.0
+ * @date 7 September 2020
+ *
+ * @brief header file of TiledMatrix.cpp, a float matrix in the tile major (blocked) layout: the
+ *        coordinates of every TILE_SIZE x TILE_SIZE block are contiguous, so a column walk or a
+ *        vertical neighborhood stays on the few memory pages of a tile instead of touching a new
+ *        page on every row of a wide matrix. the layout is opt in, a Matrix converts to it and
+ *        back, the multiplication and the transpose have tile kernels, and so does convolve of
+ *        Convolution.h.
+ *
+ */
+
+// ------------------------------ includes ------------------------------
+
+#include "Matrix.h"
+
+// -------------------------- const definitions -------------------------
+
+/**
+ * The number of rows and columns of a tile, a tile of floats is 16KB, in the L1 cache of most
+ * cpus together with a tile of the result.
+ */
+const int TILE_SIZE = 64;
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @class TiledMatrix
+ * @brief The class represents a float matrix stored tile after tile, the tiles in row major
+ *        order and the coordinates of a tile row after row. the tiles on the right and bottom
+ *        edges are padded to a whole tile with zeros, the kernels keep the padding 0.
+ */
+class TiledMatrix
+{
+
+public:
+    /**
+     * @brief The class constructor - Inits a new matrix with all coordinates 0. if rows or cols
+     * negative it will exit the program.
+     * @param rows: the matrix row number
+     * @param cols: the matrix column number.
+     */
+    TiledMatrix(int rows, int cols);
+
+    /**
+     * @brief converts a row major matrix to the tile layout, a band of tiles per task on the
+     *        threads of the pool.
+     * @param matrix: the matrix to convert.
+     */
+    explicit TiledMatrix(const Matrix& matrix);
+
+    /**
+     * @fn TiledMatrix::toMatrix()const;
+     * @return the matrix in the row major layout, converted like the constructor.
+     */
+    Matrix toMatrix() const;
+
+    /**
+    *@fn TiledMatrix::getRows()const
+    *@return the number of rows of the matrix.
+    */
+    int getRows() const { return _rows; }
+
+    /**
+    *@fn TiledMatrix::getCols()const
+    *@return the number of columns of the matrix.
+    */
+    int getCols() const { return _cols; }
+
+    /**
+    *@fn TiledMatrix::getTileRows()const
+    *@return the number of rows of tiles, the last one may be cut by the matrix edge.
+    */
+    int getTileRows() const { return (_rows + TILE_SIZE - 1) / TILE_SIZE; }
+
+    /**
+    *@fn TiledMatrix::getTileCols()const
+    *@return the number of columns of tiles, the last one may be cut by the matrix edge.
+    */
+    int getTileCols() const { return (_cols + TILE_SIZE - 1) / TILE_SIZE; }
+
+    /**
+    *@fn TiledMatrix::tilePtr(int tileRow, int tileCol);
+    *@return pointer to the TILE_SIZE x TILE_SIZE coordinates of the tile, row after row, aligned
+    *        to SIMD_ALIGNMENT bytes. checked only when MATRIX_CHECKED_ACCESS is defined.
+    */
+    float* tilePtr(int tileRow, int tileCol)
+    {
+        return _tiles.rowPtr(tileRow * getTileCols() + tileCol);
+    }
+
+    /**
+    *@fn TiledMatrix::tilePtr(int tileRow, int tileCol) const;
+    *@return const pointer to the coordinates of the tile, see the non const version.
+    */
+    const float* tilePtr(int tileRow, int tileCol) const
+    {
+        return _tiles.rowPtr(tileRow * getTileCols() + tileCol);
+    }
+
+    /**
+    *@fn TiledMatrix::operator()(int row, int col) const;
+    *@return the row col coordinate by const reference, exit the program if one of them not
+    *        valid.
+    */
+    const float& operator()(int row, int col) const;
+
+    /**
+    *@fn TiledMatrix::operator()(int row, int col);
+    *@return the row col coordinate by reference, exit the program if one of them not valid. the
+    *        padding is not a coordinate, so it stays 0.
+    */
+    float& operator()(int row, int col);
+
+    /**
+    *@fn TiledMatrix::operator*(const TiledMatrix &rhs) const;
+    *@brief the matrix multiplication, exit the program if the dimensions not valid. defined in
+    *       Matrix.cpp, the kernel of Matrix::operator* packs its blocks straight from the tiles
+    *       and writes the result tiles, with the same blocks and the same threads, so the
+    *       result is the one of Matrix::operator* on the row major matrices bit for bit.
+    *@param rhs: the matrix to multiply the lhs with.
+    *@return the new constructed matrix by value.
+    */
+    TiledMatrix operator*(const TiledMatrix& rhs) const;
+
+    /**
+    *@fn TiledMatrix::transpose() const;
+    *@return the transposed matrix, every tile is transposed in the cache on the threads of the
+    *        pool.
+    */
+    TiledMatrix transpose() const;
+
+    /**
+    *@fn TiledMatrix::operator==(const TiledMatrix& rhs) const;
+    *@return true if lhs and rhs have the same dimensions and values.
+    */
+    bool operator==(const TiledMatrix& rhs) const;
+
+    /**
+    *@fn TiledMatrix::operator!=(const TiledMatrix& rhs) const;
+    *@return false if lhs and rhs have the same dimensions and values.
+    */
+    bool operator!=(const TiledMatrix& rhs) const { return !(*this == rhs); }
+
+private:
+
+    /**
+    *@memberof TiledMatrix::_rows
+    *@brief represent the matrix number of rows.
+    */
+    int _rows;
+
+    /**
+    *@memberof TiledMatrix::_cols
+    *@brief represent the matrix number of column.
+    */
+    int _cols;
+
+    /**
+    *@memberof TiledMatrix::_tiles
+    *@brief a row of TILE_SIZE * TILE_SIZE coordinates per tile, the tiles in row major order.
+    */
+    Matrix _tiles;
+
+    /**
+     * @return the number of tiles of a rows x cols matrix, exit the program if one of them is
+     *         negative.
+     */
+    static int _numTiles(int rows, int cols);
+};
+
+#endif //SUMMER_EX4_TILEDMATRIX_H